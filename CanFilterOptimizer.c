@@ -0,0 +1,756 @@
+/**
+ * @file   CanFilterOptimizer.c
+ * @date   October, 2026
+ * @brief  Computes the ECAN acceptance filter configuration for a list of wanted identifiers.
+ *
+ * Unit testing has been completed on x86 by compiling with the UNIT_TEST_CAN_FILTER_OPTIMIZER macro.
+ * With gcc: `gcc CanFilterOptimizer.c -DUNIT_TEST_CAN_FILTER_OPTIMIZER -Wall`
+ */
+#include "CanFilterOptimizer.h"
+
+#include <stddef.h>
+#include <string.h>
+
+// The number of acceptance filters and masks in the module.
+#define FILTERS 16
+#define MASKS 3
+
+// Identifiers are handled as they're compared by the module: 29 bits with the standard identifier
+// in the same place as the SID bits of an extended one.
+#define ALL_BITS 0x1FFFFFFFUL
+#define SID_BITS 0x1FFC0000UL
+#define EID_BITS 0x0003FFFFUL
+
+// The number of words in a set of wanted identifiers.
+#define WORDS ((CFO_MAX_IDS + 31) / 32)
+
+/**
+ * A filter along with the mask it's compared through. Only the SID bits of a standard filter's
+ * mask matter, and the rest are kept set.
+ */
+typedef struct {
+	bool ext;
+	uint32_t value;
+	uint32_t mask;
+} Filter;
+
+/**
+ * A filter along with the set of wanted identifiers it accepts.
+ */
+typedef struct {
+	Filter filter;
+	uint32_t members[WORDS];
+} Cell;
+
+/**
+ * Returns the bits of an identifier that a filter of the given type compares.
+ */
+static uint32_t Compared(bool ext)
+{
+	return ext ? ALL_BITS : SID_BITS;
+}
+
+/**
+ * Returns an identifier in the form it's compared in.
+ */
+static uint32_t Position(uint32_t id)
+{
+	return (id & CFO_EXT) ? (id & ALL_BITS) : (id & 0x7FF) << 18;
+}
+
+/**
+ * Returns the number of identifiers a filter accepts.
+ */
+static uint32_t Size(const Filter *f)
+{
+	uint32_t free = Compared(f->ext) & ~f->mask;
+	uint32_t size = 1;
+
+	for (; free; free &= free - 1) {
+		size <<= 1;
+	}
+	return size;
+}
+
+/**
+ * Returns whether filter `big` accepts everything filter `small` does.
+ */
+static bool Contains(const Filter *big, const Filter *small)
+{
+	uint32_t compared = Compared(big->ext);
+
+	return big->ext == small->ext && (big->mask & ~small->mask & compared) == 0 &&
+	       ((big->value ^ small->value) & big->mask & compared) == 0;
+}
+
+/**
+ * Returns the narrowest filter accepting everything both filters do.
+ */
+static Filter Merge(const Filter *a, const Filter *b)
+{
+	Filter merged;
+
+	merged.ext = a->ext;
+	merged.mask = a->mask & b->mask & ~(a->value ^ b->value);
+	if (!merged.ext) {
+		merged.mask |= EID_BITS;
+	}
+	merged.value = a->value & merged.mask;
+	return merged;
+}
+
+/**
+ * Removes every filter that another filter already covers. Returns the new number of filters.
+ */
+static uint16_t RemoveCovered(Filter *filters, uint16_t n)
+{
+	uint16_t i, j;
+
+	for (i = 0; i < n; ++i) {
+		for (j = 0; j < n; ++j) {
+			if (i != j && Contains(&filters[j], &filters[i])) {
+				filters[i--] = filters[--n];
+				break;
+			}
+		}
+	}
+	return n;
+}
+
+/**
+ * Returns the total number of identifiers accepted by the filters, counting overlaps more than
+ * once.
+ */
+static uint64_t TotalSize(const Filter *filters, uint16_t n)
+{
+	uint64_t total = 0;
+	uint16_t i;
+
+	for (i = 0; i < n; ++i) {
+		total += Size(&filters[i]);
+	}
+	return total;
+}
+
+/**
+ * Returns the mask register a filter can use out of `masks`, or `count` if none fits.
+ */
+static uint8_t FindMask(const Filter *f, const uint32_t *masks, uint8_t count)
+{
+	uint32_t compared = Compared(f->ext);
+	uint8_t k;
+
+	for (k = 0; k < count; ++k) {
+		if (((masks[k] ^ f->mask) & compared) == 0) {
+			break;
+		}
+	}
+	return k;
+}
+
+/**
+ * Collects the mask registers the filters need into `masks`, placing the masks of extended filters
+ * first so that standard filters can share them. Returns the number of registers, which may be up
+ * to the number of filters.
+ */
+static uint8_t CollectMasks(const Filter *filters, uint16_t n, uint32_t *masks)
+{
+	uint8_t count = 0;
+	uint16_t i;
+	uint8_t pass;
+
+	for (pass = 0; pass < 2; ++pass) {
+		for (i = 0; i < n; ++i) {
+			if (filters[i].ext == (pass == 0) && FindMask(&filters[i], masks, count) == count) {
+				masks[count++] = filters[i].mask;
+			}
+		}
+	}
+	return count;
+}
+
+/**
+ * Moves every filter using mask register `from` onto `to`, widening them as needed.
+ */
+static void ReplaceMask(Filter *filters, uint16_t n, uint32_t from, uint32_t to)
+{
+	uint16_t i;
+
+	for (i = 0; i < n; ++i) {
+		if (((filters[i].mask ^ from) & Compared(filters[i].ext)) == 0) {
+			filters[i].mask = filters[i].ext ? to : (to | EID_BITS);
+			filters[i].value &= filters[i].mask;
+		}
+	}
+}
+
+/**
+ * Counts the identifiers in the union of filters `filters[next..n)` intersected with the filter
+ * given by `value` and `mask`, by inclusion-exclusion over the filters of type `ext`.
+ */
+static int64_t UnionSize(const Filter *filters, uint16_t n, uint16_t next, bool ext, uint32_t value,
+                         uint32_t mask)
+{
+	uint32_t compared = Compared(ext);
+	int64_t total = 0;
+	uint16_t i;
+
+	for (i = next; i < n; ++i) {
+		if (filters[i].ext != ext || ((filters[i].value ^ value) & filters[i].mask & mask & compared)) {
+			continue;
+		}
+
+		// The intersection with filter i, less its overlap with the filters after it.
+		Filter both;
+		both.ext = ext;
+		both.mask = (filters[i].mask | mask) & compared;
+		both.value = (filters[i].value | value) & both.mask;
+		total += Size(&both) - UnionSize(filters, n, i + 1, ext, both.value, both.mask);
+	}
+	return total;
+}
+
+/**
+ * Builds every filter through the given masks that accepts at least one wanted identifier. Returns
+ * the number of cells.
+ */
+static uint16_t BuildCells(const uint32_t *masks, const uint32_t *positions, uint16_t wanted, Cell *cells)
+{
+	uint16_t count = 0;
+	uint16_t first, c, j;
+	uint8_t k, other, pass;
+
+	for (pass = 0; pass < 2; ++pass) {
+		bool ext = (pass == 1);
+		uint32_t compared = Compared(ext);
+		for (k = 0; k < MASKS; ++k) {
+			// Masks that compare the same bits give the same cells.
+			for (other = 0; other < k && ((masks[other] ^ masks[k]) & compared); ++other);
+			if (other < k) {
+				continue;
+			}
+
+			first = count;
+			for (j = 0; j < wanted; ++j) {
+				if (((positions[j] & CFO_EXT) != 0) != ext) {
+					continue;
+				}
+				Filter cell;
+				cell.ext = ext;
+				cell.mask = ext ? masks[k] : (masks[k] | EID_BITS);
+				cell.value = Position(positions[j]) & cell.mask;
+				for (c = first; c < count && cells[c].filter.value != cell.value; ++c);
+				if (c == count) {
+					cells[count].filter = cell;
+					memset(cells[count].members, 0, sizeof(cells[count].members));
+					++count;
+				}
+				cells[c].members[j >> 5] |= 1UL << (j & 31);
+			}
+		}
+	}
+	return count;
+}
+
+/**
+ * Returns the number of set bits in a set of wanted identifiers.
+ */
+static uint16_t CountMembers(const uint32_t *members)
+{
+	uint16_t count = 0;
+	uint32_t word;
+	uint8_t w;
+
+	for (w = 0; w < WORDS; ++w) {
+		for (word = members[w]; word; word &= word - 1) {
+			++count;
+		}
+	}
+	return count;
+}
+
+/**
+ * Picks at most 16 cells that together accept every wanted identifier, greedily taking the one
+ * with the lowest cost per identifier it adds, where each costs its size plus `penalty`. Returns
+ * the total size of the picked cells, or UINT64_MAX if they didn't fit.
+ */
+static uint64_t Cover(const Cell *cells, uint16_t cellCount, uint16_t wanted, uint64_t penalty,
+                      Filter *out, uint16_t *n)
+{
+	uint32_t covered[WORDS] = {0};
+	uint32_t fresh[WORDS];
+	uint64_t total = 0;
+	uint16_t left = wanted;
+	uint16_t c;
+	uint8_t w;
+
+	for (*n = 0; left; ++*n) {
+		uint64_t bestSize = 0;
+		uint16_t bestNew = 0;
+		uint16_t best = cellCount;
+
+		if (*n == FILTERS) {
+			return UINT64_MAX;
+		}
+		for (c = 0; c < cellCount; ++c) {
+			uint64_t size = Size(&cells[c].filter);
+			for (w = 0; w < WORDS; ++w) {
+				fresh[w] = cells[c].members[w] & ~covered[w];
+			}
+			uint16_t added = CountMembers(fresh);
+			if (added && (best == cellCount || (size + penalty) * bestNew < (bestSize + penalty) * added ||
+			              ((size + penalty) * bestNew == (bestSize + penalty) * added && added > bestNew))) {
+				best = c;
+				bestSize = size;
+				bestNew = added;
+			}
+		}
+		for (w = 0; w < WORDS; ++w) {
+			covered[w] |= cells[best].members[w];
+		}
+		left -= bestNew;
+		total += bestSize;
+		out[*n] = cells[best].filter;
+	}
+	return total;
+}
+
+/**
+ * Picks the filters for a set of masks, trying a range of per-filter penalties in Cover() for the
+ * one that fits in 16 filters with the fewest identifiers accepted. Returns the total size of the
+ * filters, or UINT64_MAX if none fit.
+ */
+static uint64_t Solve(const uint32_t *masks, const uint32_t *positions, uint16_t wanted, Filter *out,
+                      uint16_t *n)
+{
+	Cell cells[MASKS * CFO_MAX_IDS];
+	Filter trial[FILTERS];
+	uint16_t cellCount = BuildCells(masks, positions, wanted, cells);
+	uint64_t best = UINT64_MAX;
+	uint16_t trialCount, i;
+	uint8_t low = 0, high = 31;
+
+	// Higher penalties favour fewer, wider filters, so search for the lowest one that still fits.
+	while (low <= high) {
+		uint8_t middle = (low + high) / 2;
+		uint64_t cost = Cover(cells, cellCount, wanted, (1ULL << middle) - 1, trial, &trialCount);
+		if (cost == UINT64_MAX) {
+			low = middle + 1;
+			continue;
+		}
+		if (cost < best) {
+			best = cost;
+			for (i = 0; i < trialCount; ++i) {
+				out[i] = trial[i];
+			}
+			*n = trialCount;
+		}
+		if (!middle) {
+			break;
+		}
+		high = middle - 1;
+	}
+	return best;
+}
+
+int CFO_Optimize(const uint32_t *ids, uint16_t count, uint8_t bufferPointer, uint16_t *parameters,
+                 uint32_t *unwanted)
+{
+	Filter filters[CFO_MAX_IDS];
+	uint32_t positions[CFO_MAX_IDS];
+	uint32_t masks[FILTERS];
+	uint8_t selects[FILTERS];
+	uint16_t n = 0;
+	uint16_t wanted;
+	uint16_t i, j;
+	uint8_t k, maskCount;
+
+	if (!ids || !parameters || count > CFO_MAX_IDS || bufferPointer > 15) {
+		return STANDARD_ERROR;
+	}
+
+	// Start with an exact filter for every distinct identifier.
+	for (i = 0; i < count; ++i) {
+		Filter exact;
+		exact.ext = (ids[i] & CFO_EXT) != 0;
+		exact.value = Position(ids[i]);
+		exact.mask = ALL_BITS;
+		for (j = 0; j < n && !(filters[j].ext == exact.ext && filters[j].value == exact.value); ++j);
+		if (j == n) {
+			positions[n] = ids[i];
+			filters[n++] = exact;
+		}
+	}
+	wanted = n;
+
+	// Merge the pair of filters that adds the fewest identifiers until there are few enough.
+	while (n > FILTERS) {
+		uint64_t bestCost = UINT64_MAX;
+		uint16_t bestI = 0, bestJ = 0;
+
+		for (i = 0; i < n; ++i) {
+			for (j = i + 1; j < n; ++j) {
+				if (filters[i].ext == filters[j].ext) {
+					Filter merged = Merge(&filters[i], &filters[j]);
+					uint64_t cost = (uint64_t) Size(&merged) - Size(&filters[i]) - Size(&filters[j]);
+					if (cost < bestCost) {
+						bestCost = cost;
+						bestI = i;
+						bestJ = j;
+					}
+				}
+			}
+		}
+		filters[bestI] = Merge(&filters[bestI], &filters[bestJ]);
+		filters[bestJ] = filters[--n];
+		n = RemoveCovered(filters, n);
+	}
+
+	// Keep the masks these filters need as candidates for later, along with every pair of them
+	// combined.
+	uint32_t candidates[FILTERS * (FILTERS + 1) / 2];
+	uint16_t candidateCount = CollectMasks(filters, n, candidates);
+	uint16_t needed = candidateCount;
+	for (i = 0; i < needed; ++i) {
+		for (j = i + 1; j < needed; ++j) {
+			candidates[candidateCount++] = candidates[i] & candidates[j];
+		}
+	}
+
+	// Then merge the pair of masks that adds the fewest identifiers until there are few enough.
+	while ((maskCount = CollectMasks(filters, n, masks)) > MASKS) {
+		Filter trial[FILTERS];
+		uint64_t bestCost = UINT64_MAX;
+		uint8_t bestA = 0, bestB = 0;
+		uint8_t a, b;
+
+		for (a = 0; a < maskCount; ++a) {
+			for (b = a + 1; b < maskCount; ++b) {
+				for (i = 0; i < n; ++i) {
+					trial[i] = filters[i];
+				}
+				ReplaceMask(trial, n, masks[a], masks[a] & masks[b]);
+				ReplaceMask(trial, n, masks[b], masks[a] & masks[b]);
+				uint64_t cost = TotalSize(trial, RemoveCovered(trial, n));
+				if (cost < bestCost) {
+					bestCost = cost;
+					bestA = a;
+					bestB = b;
+				}
+			}
+		}
+		ReplaceMask(filters, n, masks[bestA], masks[bestA] & masks[bestB]);
+		ReplaceMask(filters, n, masks[bestB], masks[bestA] & masks[bestB]);
+		n = RemoveCovered(filters, n);
+	}
+
+	// Merging masks can leave far wider filters than needed, so also try building the masks up one
+	// at a time out of the candidates, picking the filters for each set of masks afresh. Then refine
+	// whichever is better one bit at a time.
+	{
+		Filter trial[FILTERS];
+		uint32_t current[MASKS];
+		uint32_t chosen[MASKS];
+		uint32_t bits = SID_BITS;
+		uint64_t best = TotalSize(filters, n);
+		uint64_t cost = UINT64_MAX;
+		bool improved = true;
+		uint16_t trialCount = 0;
+		uint16_t c;
+		uint8_t bit, other;
+
+		maskCount = CollectMasks(filters, n, current);
+		for (k = maskCount; k < MASKS; ++k) {
+			current[k] = ALL_BITS;
+		}
+		for (k = 0; k < MASKS; ++k) {
+			uint32_t bestCandidate = 0;
+			cost = UINT64_MAX;
+			for (c = 0; c < candidateCount; ++c) {
+				for (other = k; other < MASKS; ++other) {
+					chosen[other] = candidates[c];
+				}
+				uint64_t candidateCost = Solve(chosen, positions, wanted, trial, &trialCount);
+				if (candidateCost < cost) {
+					cost = candidateCost;
+					bestCandidate = candidates[c];
+				}
+			}
+			chosen[k] = bestCandidate;
+		}
+		if (cost < best && Solve(chosen, positions, wanted, trial, &trialCount) == cost) {
+			best = cost;
+			for (i = 0; i < trialCount; ++i) {
+				filters[i] = trial[i];
+			}
+			n = trialCount;
+			for (k = 0; k < MASKS; ++k) {
+				current[k] = chosen[k];
+			}
+		}
+		for (j = 0; j < wanted; ++j) {
+			if (positions[j] & CFO_EXT) {
+				bits = ALL_BITS;
+			}
+		}
+		while (improved) {
+			improved = false;
+			for (k = 0; k < MASKS; ++k) {
+				for (bit = 0; bit < 29; ++bit) {
+					if (!(bits & (1UL << bit))) {
+						continue;
+					}
+					current[k] ^= 1UL << bit;
+					cost = Solve(current, positions, wanted, trial, &trialCount);
+					if (cost < best) {
+						best = cost;
+						for (i = 0; i < trialCount; ++i) {
+							filters[i] = trial[i];
+						}
+						n = trialCount;
+						improved = true;
+					} else {
+						current[k] ^= 1UL << bit;
+					}
+				}
+			}
+		}
+	}
+
+	// Pick each filter's mask register.
+	maskCount = CollectMasks(filters, n, masks);
+	for (i = 0; i < n; ++i) {
+		selects[i] = FindMask(&filters[i], masks, maskCount);
+	}
+
+	// And fill in the parameters.
+	parameters[4] = (uint16_t) ((1UL << n) - 1);
+	parameters[5] = 0;
+	parameters[6] = 0;
+	for (k = 0; k < MASKS; ++k) {
+		uint32_t mask = (k < maskCount) ? masks[k] : 0;
+		parameters[7 + 2 * k] = (uint16_t) (((mask >> 18) & 0x7FF) << 5 | ((k < maskCount) ? 0x0008 : 0) |
+		                                    ((mask >> 16) & 3));
+		parameters[8 + 2 * k] = (uint16_t) mask;
+	}
+	for (i = 0; i < 4; ++i) {
+		parameters[17 + i] = 0;
+	}
+	for (i = 0; i < FILTERS; ++i) {
+		if (i < n) {
+			parameters[5 + (i >> 3)] |= (uint16_t) selects[i] << ((i & 7) * 2);
+			parameters[17 + (i >> 2)] |= (uint16_t) bufferPointer << ((i & 3) * 4);
+			parameters[21 + 2 * i] = (uint16_t) (((filters[i].value >> 18) & 0x7FF) << 5);
+			if (filters[i].ext) {
+				parameters[21 + 2 * i] |= 0x0008 | ((filters[i].value >> 16) & 3);
+				parameters[22 + 2 * i] = (uint16_t) filters[i].value;
+			} else {
+				parameters[22 + 2 * i] = 0;
+			}
+		} else {
+			parameters[21 + 2 * i] = 0;
+			parameters[22 + 2 * i] = 0;
+		}
+	}
+
+	if (unwanted) {
+		*unwanted = (uint32_t) (UnionSize(filters, n, 0, false, 0, 0) +
+		                        UnionSize(filters, n, 0, true, 0, 0) - wanted);
+	}
+
+	return SUCCESS;
+}
+
+int CFO_Accepts(const uint16_t *parameters, uint32_t id)
+{
+	bool ext = (id & CFO_EXT) != 0;
+	uint32_t position = Position(id);
+	uint8_t n;
+
+	for (n = 0; n < FILTERS; ++n) {
+		uint8_t select = (parameters[5 + (n >> 3)] >> ((n & 7) * 2)) & 3;
+		uint16_t maskSid, filterSid;
+		uint32_t mask, value;
+
+		if (!(parameters[4] & (1 << n)) || select >= MASKS) {
+			continue;
+		}
+		maskSid = parameters[7 + 2 * select];
+		filterSid = parameters[21 + 2 * n];
+
+		// MIDE restricts the filter to frames whose type matches EXIDE.
+		if ((maskSid & 0x0008) && (((filterSid & 0x0008) != 0) != ext)) {
+			continue;
+		}
+		mask = ((uint32_t) (maskSid >> 5)) << 18 | ((uint32_t) (maskSid & 3)) << 16 | parameters[8 + 2 * select];
+		value = ((uint32_t) (filterSid >> 5)) << 18 | ((uint32_t) (filterSid & 3)) << 16 | parameters[22 + 2 * n];
+		if (((position ^ value) & mask & Compared(ext)) == 0) {
+			return n;
+		}
+	}
+
+	return -1;
+}
+
+/**
+ * This begins the unit testing code. Directions for compilation are at the top of the file.
+ */
+#ifdef UNIT_TEST_CAN_FILTER_OPTIMIZER
+
+#include <assert.h>
+#include <stdio.h>
+
+/**
+ * @brief Counts the unwanted standard identifiers a configuration accepts by trying them all.
+ */
+static uint32_t CountUnwantedStandard(const uint16_t *parameters, const uint32_t *ids, uint16_t count)
+{
+	uint32_t accepted = 0;
+	uint32_t id;
+	uint16_t i;
+
+	for (id = 0; id < 0x800; ++id) {
+		if (CFO_Accepts(parameters, id) >= 0) {
+			for (i = 0; i < count && ids[i] != id; ++i);
+			accepted += (i == count);
+		}
+	}
+	return accepted;
+}
+
+/**
+ * @brief Checks that a configuration accepts every wanted identifier.
+ */
+static void CheckWanted(const uint16_t *parameters, const uint32_t *ids, uint16_t count)
+{
+	uint16_t i;
+
+	for (i = 0; i < count; ++i) {
+		assert(CFO_Accepts(parameters, ids[i]) >= 0);
+	}
+}
+
+int main()
+{
+	printf("Running unit tests.\n");
+
+	// Check that invalid arguments are rejected and leave the parameters alone.
+	{
+		uint16_t parameters[53];
+		uint32_t id = 0x100;
+
+		memset(parameters, 0xAA, sizeof(parameters));
+		assert(CFO_Optimize(NULL, 0, 1, parameters, NULL) == STANDARD_ERROR);
+		assert(CFO_Optimize(&id, 1, 1, NULL, NULL) == STANDARD_ERROR);
+		assert(CFO_Optimize(&id, CFO_MAX_IDS + 1, 1, parameters, NULL) == STANDARD_ERROR);
+		assert(CFO_Optimize(&id, 1, 16, parameters, NULL) == STANDARD_ERROR);
+		assert(parameters[4] == 0xAAAA);
+	}
+
+	// No identifiers means no filters.
+	{
+		uint16_t parameters[53] = {0};
+		uint32_t unwanted = 1;
+		uint32_t id = 0;
+
+		assert(CFO_Optimize(&id, 0, 1, parameters, &unwanted));
+		assert(parameters[4] == 0 && unwanted == 0);
+		assert(CFO_Accepts(parameters, 0) == -1);
+	}
+
+	// Up to 16 identifiers of both types fit exactly, and only the filter registers are written.
+	{
+		uint16_t parameters[53];
+		uint32_t ids[16];
+		uint32_t unwanted;
+		uint16_t i;
+
+		for (i = 0; i < 12; ++i) {
+			ids[i] = 0x123 + 0x51 * i;
+		}
+		for (; i < 16; ++i) {
+			ids[i] = (0x18FEF000UL + i) | CFO_EXT;
+		}
+		memset(parameters, 0, sizeof(parameters));
+		parameters[1] = 10000;
+		parameters[13] = 0x0080;
+		assert(CFO_Optimize(ids, 16, 15, parameters, &unwanted));
+		assert(unwanted == 0);
+		assert(parameters[1] == 10000 && parameters[13] == 0x0080);
+		assert(parameters[4] == 0xFFFF);
+		assert(parameters[17] == 0xFFFF && parameters[20] == 0xFFFF);
+		CheckWanted(parameters, ids, 16);
+		assert(CountUnwantedStandard(parameters, ids, 16) == 0);
+
+		// An extended frame whose ID equals a wanted standard one is rejected, and vice versa.
+		assert(CFO_Accepts(parameters, 0x123 | CFO_EXT) == -1);
+		assert(CFO_Accepts(parameters, 0x18FEF00CUL & 0x7FF) == -1);
+		assert(CFO_Accepts(parameters, (0x18FEF00CUL ^ 0x10000) | CFO_EXT) == -1);
+	}
+
+	// A block of 64 consecutive identifiers takes one filter with the low 6 bits masked off.
+	{
+		uint16_t parameters[53] = {0};
+		uint32_t ids[64];
+		uint32_t unwanted;
+		uint16_t i;
+
+		for (i = 0; i < 64; ++i) {
+			ids[i] = 0x240 + i;
+		}
+		assert(CFO_Optimize(ids, 64, 1, parameters, &unwanted));
+		assert(unwanted == 0);
+		CheckWanted(parameters, ids, 64);
+		assert(CountUnwantedStandard(parameters, ids, 64) == 0);
+	}
+
+	// 48 scattered identifiers can't be matched exactly, but far fewer than all of them get through,
+	// and the reported count matches the real one.
+	{
+		uint16_t parameters[53] = {0};
+		uint32_t ids[48];
+		uint32_t unwanted;
+		uint32_t seed = 7;
+		uint16_t i;
+
+		for (i = 0; i < 48; ++i) {
+			seed = seed * 1103515245 + 12345;
+			ids[i] = (seed >> 16) & 0x7FF;
+		}
+		ids[47] = ids[3];
+		assert(CFO_Optimize(ids, 48, 1, parameters, &unwanted));
+		CheckWanted(parameters, ids, 48);
+		assert(unwanted == CountUnwantedStandard(parameters, ids, 48));
+		assert(unwanted < 0x800 / 2);
+		printf("48 scattered standard identifiers: %lu unwanted accepted.\n", (unsigned long) unwanted);
+	}
+
+	// Extended identifiers in a few groups, where overlapping filters must only be counted once.
+	{
+		uint16_t parameters[53] = {0};
+		uint32_t ids[40];
+		uint32_t unwanted;
+		uint16_t i;
+
+		for (i = 0; i < 40; ++i) {
+			ids[i] = (0x0CF00400UL + (i % 5) * 0x10000UL + (i / 5) * 3) | CFO_EXT;
+		}
+		assert(CFO_Optimize(ids, 40, 1, parameters, &unwanted));
+		CheckWanted(parameters, ids, 40);
+		assert(CountUnwantedStandard(parameters, ids, 40) == 0);
+
+		// Count the accepted extended identifiers in the neighbourhood of the wanted ones.
+		uint32_t accepted = 0;
+		uint32_t id;
+		for (id = 0x0CE00000UL; id < 0x0D000000UL; ++id) {
+			accepted += CFO_Accepts(parameters, id | CFO_EXT) >= 0;
+		}
+		assert(accepted - 40 == unwanted);
+		printf("40 grouped extended identifiers: %lu unwanted accepted.\n", (unsigned long) unwanted);
+	}
+
+	printf("All tests passed.\n");
+
+	return 0;
+}
+#endif // UNIT_TEST_CAN_FILTER_OPTIMIZER
@@ -0,0 +1,77 @@
+/**
+ * @file   CanFilterOptimizer.h
+ * @date   October, 2026
+ * @brief  Computes the ECAN acceptance filter configuration for a list of wanted identifiers.
+ *
+ * The ECAN module has 16 acceptance filters, each compared against a frame's identifier through
+ * one of 3 masks. A filter and its mask accept a set of identifiers that differ only in the bits
+ * left out of the mask, so covering more than 16 identifiers, or identifiers spread over the ID
+ * space, means accepting some unwanted ones too. CFO_Optimize() searches for the filters and masks
+ * that accept all of the wanted identifiers and as few others as possible, and writes them into
+ * the parameters array taken by ecan1_init().
+ *
+ * The search is greedy. Every wanted identifier starts out with its own exact filter. Filters are
+ * then merged in pairs, each time picking the merge that accepts the fewest extra identifiers, until
+ * 16 remain, and their masks are merged in pairs the same way until only 3 remain. The masks those
+ * 16 filters needed also seed a second attempt, which picks the 3 masks one at a time and covers
+ * the wanted identifiers with the filters they allow. Whichever accepts fewer identifiers is then
+ * refined by flipping one mask bit at a time. The result isn't guaranteed to be optimal, but up
+ * to 16 distinct identifiers always get exact filters.
+ *
+ * Identifiers are given in the same form as for ecan1_rx_filter_set(): standard identifiers as they
+ * are and extended ones with CFO_EXT set, so the same table can configure the hardware filters
+ * and the software filter behind them. Every filter only matches frames of its own type.
+ *
+ * The search uses a few tens of kilobytes of stack for CFO_MAX_IDS identifiers, so it's meant to be run on
+ * the host, for example with HostEmulator/ecanFilterTool.c, or once before ecan1_init().
+ *
+ * Unit testing has been completed on x86 by compiling with the UNIT_TEST_CAN_FILTER_OPTIMIZER macro.
+ * With gcc: `gcc CanFilterOptimizer.c -DUNIT_TEST_CAN_FILTER_OPTIMIZER -Wall`
+ */
+#ifndef _CAN_FILTER_OPTIMIZER_H_
+#define _CAN_FILTER_OPTIMIZER_H_
+
+#include "Common.h"
+
+// Marks an identifier as extended. The same bit as ECAN1_FILTER_EXT().
+#define CFO_EXT 0x20000000UL
+
+// The most identifiers CFO_Optimize() accepts. This can be overridden by user code.
+#ifndef CFO_MAX_IDS
+#define CFO_MAX_IDS 128
+#endif
+
+/**
+ * @brief CFO_Optimize computes the filter configuration accepting a list of identifiers.
+ *
+ * Fills in the filter enables, mask selections, masks, buffer pointers and filters of an
+ * ecan1_init() parameters array, that is parameters[4] to [12] and [17] to [52]. The rest of the
+ * array is left untouched. Every enabled filter points at `bufferPointer`. Duplicate identifiers
+ * are allowed.
+ *
+ * Returns STANDARD_ERROR, leaving `parameters` untouched, if `count` is above CFO_MAX_IDS or
+ * `bufferPointer` is above 15. Otherwise SUCCESS is returned.
+ *
+ * @param ids The wanted identifiers, with CFO_EXT set for extended ones.
+ * @param count The number of identifiers in `ids`.
+ * @param bufferPointer The receive buffer every filter points at, or 15 for the FIFO.
+ * @param parameters The 53-element ecan1_init() parameters array to fill in.
+ * @param unwanted Where the number of unwanted identifiers the filters accept is stored. May be
+ *                 NULL.
+ */
+int CFO_Optimize(const uint32_t *ids, uint16_t count, uint8_t bufferPointer, uint16_t *parameters,
+                 uint32_t *unwanted);
+
+/**
+ * @brief CFO_Accepts returns whether a filter configuration accepts an identifier.
+ *
+ * Mirrors the module's acceptance filtering for the filters and masks in an ecan1_init()
+ * parameters array.
+ *
+ * @param parameters The 53-element ecan1_init() parameters array.
+ * @param id The identifier, with CFO_EXT set for extended ones.
+ * @return The number of the first filter accepting the identifier, or -1 if none do.
+ */
+int CFO_Accepts(const uint16_t *parameters, uint32_t id);
+
+#endif /* _CAN_FILTER_OPTIMIZER_H_ */
@@ -0,0 +1,716 @@
+/**
+ * @file   CanMessageBuffer.c
+ * @date   October, 2026
+ * @brief  Provides a circular buffer of whole tCanMessage structs.
+ *
+ * Unit testing has been completed on x86 by compiling with the UNIT_TEST_CAN_MESSAGE_BUFFER macro.
+ * With gcc: `gcc CanMessageBuffer.c -DUNIT_TEST_CAN_MESSAGE_BUFFER -Wall`
+ * Add -DCMB_STATS to test the statistics as well.
+ */
+#include "CanMessageBuffer.h"
+
+#include <stddef.h>
+#include <string.h>
+
+// Returned by the slot lookups below when there is no slot to return.
+#define NO_SLOT 0xFFFF
+
+/**
+ * Records `count` messages written into the buffer, once writeCount has been advanced past them.
+ * Only called by the producer.
+ */
+static inline void RecordWrite(CanMessageBuffer *b, uint16_t count)
+{
+#ifdef CMB_STATS
+	uint16_t length = (uint16_t) (b->writeCount - b->readCount);
+
+	b->stats.messagesWritten += count;
+	if (length > b->stats.peakLength) {
+		b->stats.peakLength = length;
+	}
+#else
+	(void)b;
+	(void)count;
+#endif
+}
+
+/**
+ * Records `count` messages read or removed from the buffer. Only called by the consumer.
+ */
+static inline void RecordRead(CanMessageBuffer *b, uint16_t count)
+{
+#ifdef CMB_STATS
+	b->stats.messagesRead += count;
+#else
+	(void)b;
+	(void)count;
+#endif
+}
+
+/**
+ * Records `count` messages lost because the buffer was full. Only called by the producer.
+ */
+static inline void RecordOverflow(CanMessageBuffer *b, uint16_t count)
+{
+	b->overflowCount += count;
+#ifdef CMB_STATS
+	b->stats.messagesLost += count;
+#endif
+}
+
+/**
+ * Returns the index of the next free slot. If the buffer is full, counts an overflow and returns
+ * NO_SLOT.
+ */
+static uint16_t ReserveIndex(CanMessageBuffer *b)
+{
+	uint16_t writeCount = b->writeCount;
+
+	if ((uint16_t) (writeCount - b->readCount) > b->mask) {
+		RecordOverflow(b, 1);
+		return NO_SLOT;
+	}
+	return writeCount & b->mask;
+}
+
+/**
+ * Returns the index of the oldest message, or NO_SLOT if the buffer is empty. `count` is set as
+ * described for CMB_PeekContiguous().
+ */
+static uint16_t PeekIndex(const CanMessageBuffer *b, uint16_t *count)
+{
+	uint16_t readCount = b->readCount;
+	uint16_t length = (uint16_t) (b->writeCount - readCount);
+	uint16_t index = readCount & b->mask;
+
+	if (count) {
+		// Stop at the end of the array if the messages wrap around it.
+		*count = b->mask + 1 - index;
+		if (*count > length) {
+			*count = length;
+		}
+	}
+	if (!length) {
+		return NO_SLOT;
+	}
+
+	MEMORY_BARRIER();
+	return index;
+}
+
+int CMB_Init(CanMessageBuffer *b, tCanPackedMessage *data, const uint16_t size)
+{
+	if (!b || !data || !size || size > 0x8000 || (size & (size - 1))) {
+		return STANDARD_ERROR;
+	}
+
+	b->data = data;
+	b->readCount = 0;
+	b->writeCount = 0;
+	b->mask = size - 1;
+	b->overflowCount = 0;
+	CMB_ResetStats(b);
+
+	return SUCCESS;
+}
+
+void CMB_Pack(tCanPackedMessage *packed, const tCanMessage *msg)
+{
+	uint32_t header = msg->id & CMB_PACKED_ID;
+
+	if (msg->frame_type == CAN_FRAME_EXT) {
+		header |= CMB_PACKED_EXT;
+	}
+	if (msg->message_type == CAN_MSG_RTR) {
+		header |= CMB_PACKED_RTR;
+	}
+
+	memcpy(packed->payload, msg->payload, 8);
+	if (msg->validBytes >= 8) {
+		header |= CMB_PACKED_FULL;
+	} else {
+		// Whatever the unused bytes held, they're stored as zero.
+		memset(&packed->payload[msg->validBytes], 0, 7 - msg->validBytes);
+		packed->payload[7] = msg->validBytes;
+	}
+	packed->header = header;
+}
+
+void CMB_Unpack(tCanMessage *msg, const tCanPackedMessage *packed)
+{
+	uint32_t header = packed->header;
+
+	msg->id = header & CMB_PACKED_ID;
+	msg->buffer = 0;
+	msg->message_type = (header & CMB_PACKED_RTR) ? CAN_MSG_RTR : CAN_MSG_DATA;
+	msg->frame_type = (header & CMB_PACKED_EXT) ? CAN_FRAME_EXT : CAN_FRAME_STD;
+
+	memcpy(msg->payload, packed->payload, 8);
+	if (header & CMB_PACKED_FULL) {
+		msg->validBytes = 8;
+	} else {
+		msg->validBytes = packed->payload[7];
+		msg->payload[7] = 0;
+	}
+}
+
+int CMB_InitRaw(CanMessageBuffer *b, tCanRawMessage *data, const uint16_t size)
+{
+	return CMB_Init(b, (tCanPackedMessage *) data, size);
+}
+
+uint16_t CMB_GetLength(const CanMessageBuffer *b)
+{
+	return (uint16_t) (b->writeCount - b->readCount);
+}
+
+int CMB_Write(CanMessageBuffer *b, const tCanMessage *msg)
+{
+	if (b && msg) {
+		tCanPackedMessage *slot = CMB_Reserve(b);
+		if (slot) {
+			CMB_Pack(slot, msg);
+			return CMB_Commit(b);
+		}
+	}
+	return STANDARD_ERROR;
+}
+
+uint16_t CMB_WriteMany(CanMessageBuffer *b, const tCanMessage *msgs, uint16_t count)
+{
+	uint16_t writeCount = b->writeCount;
+	uint16_t space = b->mask + 1 - (uint16_t) (writeCount - b->readCount);
+	uint16_t i;
+
+	if (count > space) {
+		RecordOverflow(b, count - space);
+		count = space;
+	}
+	if (!count) {
+		return 0;
+	}
+
+	// Fill every slot before publishing them all to the consumer.
+	for (i = 0; i < count; ++i) {
+		CMB_Pack(&b->data[(writeCount + i) & b->mask], &msgs[i]);
+	}
+	MEMORY_BARRIER();
+	b->writeCount = writeCount + count;
+	RecordWrite(b, count);
+	return count;
+}
+
+int CMB_Read(CanMessageBuffer *b, tCanMessage *msg)
+{
+	if (b && msg) {
+		uint16_t readCount = b->readCount;
+		if (readCount == b->writeCount) {
+			return STANDARD_ERROR;
+		}
+
+		// Empty the slot before handing it back to the producer.
+		MEMORY_BARRIER();
+		CMB_Unpack(msg, &b->data[readCount & b->mask]);
+		MEMORY_BARRIER();
+		b->readCount = readCount + 1;
+		RecordRead(b, 1);
+		return SUCCESS;
+	}
+	return STANDARD_ERROR;
+}
+
+uint16_t CMB_ReadMany(CanMessageBuffer *b, tCanMessage *msgs, uint16_t max)
+{
+	uint16_t readCount = b->readCount;
+	uint16_t count = (uint16_t) (b->writeCount - readCount);
+	uint16_t i;
+
+	if (count > max) {
+		count = max;
+	}
+	if (!count) {
+		return 0;
+	}
+
+	// Empty every slot before handing them all back to the producer.
+	MEMORY_BARRIER();
+	for (i = 0; i < count; ++i) {
+		CMB_Unpack(&msgs[i], &b->data[(readCount + i) & b->mask]);
+	}
+	MEMORY_BARRIER();
+	b->readCount = readCount + count;
+	RecordRead(b, count);
+	return count;
+}
+
+int CMB_Peek(const CanMessageBuffer *b, tCanMessage *msg)
+{
+	if (b && msg) {
+		uint16_t readCount = b->readCount;
+		if (readCount == b->writeCount) {
+			return STANDARD_ERROR;
+		}
+
+		MEMORY_BARRIER();
+		CMB_Unpack(msg, &b->data[readCount & b->mask]);
+		return SUCCESS;
+	}
+	return STANDARD_ERROR;
+}
+
+int CMB_Remove(CanMessageBuffer *b, uint16_t count)
+{
+	uint16_t readCount = b->readCount;
+	uint16_t writeCount = b->writeCount;
+
+	MEMORY_BARRIER();
+	if ((uint16_t) (writeCount - readCount) < count) {
+		count = (uint16_t) (writeCount - readCount);
+	}
+	b->readCount = readCount + count;
+	RecordRead(b, count);
+	return SUCCESS;
+}
+
+tCanPackedMessage *CMB_Reserve(CanMessageBuffer *b)
+{
+	uint16_t index = ReserveIndex(b);
+
+	return (index == NO_SLOT) ? NULL : &b->data[index];
+}
+
+tCanRawMessage *CMB_ReserveRaw(CanMessageBuffer *b)
+{
+	uint16_t index = ReserveIndex(b);
+
+	return (index == NO_SLOT) ? NULL : &((tCanRawMessage *) b->data)[index];
+}
+
+int CMB_Commit(CanMessageBuffer *b)
+{
+	uint16_t writeCount = b->writeCount;
+
+	if ((uint16_t) (writeCount - b->readCount) > b->mask) {
+		return STANDARD_ERROR;
+	}
+
+	// Make sure the slot has been filled before publishing it to the consumer.
+	MEMORY_BARRIER();
+	b->writeCount = writeCount + 1;
+	RecordWrite(b, 1);
+	return SUCCESS;
+}
+
+const tCanPackedMessage *CMB_PeekContiguous(const CanMessageBuffer *b, uint16_t *count)
+{
+	uint16_t index = PeekIndex(b, count);
+
+	return (index == NO_SLOT) ? NULL : &b->data[index];
+}
+
+const tCanRawMessage *CMB_PeekContiguousRaw(const CanMessageBuffer *b, uint16_t *count)
+{
+	uint16_t index = PeekIndex(b, count);
+
+	return (index == NO_SLOT) ? NULL : &((const tCanRawMessage *) b->data)[index];
+}
+
+int CMB_Consume(CanMessageBuffer *b, uint16_t count)
+{
+	uint16_t readCount = b->readCount;
+
+	if ((uint16_t) (b->writeCount - readCount) < count) {
+		return STANDARD_ERROR;
+	}
+
+	// Finish reading the slots before handing them back to the producer.
+	MEMORY_BARRIER();
+	b->readCount = readCount + count;
+	RecordRead(b, count);
+	return SUCCESS;
+}
+
+int CMB_GetStats(const CanMessageBuffer *b, CanMessageBufferStats *stats)
+{
+#ifdef CMB_STATS
+	if (b && stats) {
+		*stats = b->stats;
+		return SUCCESS;
+	}
+#else
+	(void)b;
+	(void)stats;
+#endif
+	return STANDARD_ERROR;
+}
+
+void CMB_ResetStats(CanMessageBuffer *b)
+{
+#ifdef CMB_STATS
+	if (b) {
+		b->stats.messagesWritten = 0;
+		b->stats.messagesRead = 0;
+		b->stats.messagesLost = 0;
+		b->stats.peakLength = CMB_GetLength(b);
+	}
+#else
+	(void)b;
+#endif
+}
+
+/**
+ * This begins the unit testing code. Directions for compilation are at the top of the file.
+ */
+#ifdef UNIT_TEST_CAN_MESSAGE_BUFFER
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * @brief Fills in a message whose contents are derived from `i`.
+ */
+static void MakeMessage(tCanMessage *msg, uint8_t i)
+{
+	memset(msg, 0, sizeof(tCanMessage));
+	msg->id = 0x100 + i;
+	msg->frame_type = (i & 2) ? CAN_FRAME_EXT : CAN_FRAME_STD;
+	msg->message_type = (i & 4) ? CAN_MSG_RTR : CAN_MSG_DATA;
+	msg->validBytes = 8 - i % 9;
+	if (msg->validBytes) {
+		msg->payload[0] = i;
+	}
+	if (msg->validBytes == 8) {
+		msg->payload[7] = ~i;
+	}
+}
+
+int main()
+{
+	printf("Running unit tests.\n");
+
+	// Check that messages survive packing, and that they take up 12 bytes.
+	{
+		tCanPackedMessage packed;
+		tCanMessage in, out;
+		uint8_t i;
+
+		assert(sizeof(tCanPackedMessage) == 12);
+		for (i = 0; i < 9; ++i) {
+			MakeMessage(&in, i);
+			CMB_Pack(&packed, &in);
+			CMB_Unpack(&out, &packed);
+			assert(memcmp(&in, &out, sizeof(tCanMessage)) == 0);
+		}
+
+		// The largest extended ID, an RTR with all 8 bytes valid.
+		MakeMessage(&in, 0);
+		in.id = 0x1FFFFFFF;
+		in.frame_type = CAN_FRAME_EXT;
+		in.message_type = CAN_MSG_RTR;
+		memset(in.payload, 0xFF, 8);
+		CMB_Pack(&packed, &in);
+		assert(packed.header == 0xFFFFFFFF);
+		CMB_Unpack(&out, &packed);
+		assert(memcmp(&in, &out, sizeof(tCanMessage)) == 0);
+
+		// Bytes beyond validBytes and the buffer aren't kept, and validBytes is at most 8.
+		in.id = 0x7FF;
+		in.frame_type = CAN_FRAME_STD;
+		in.message_type = CAN_MSG_DATA;
+		in.buffer = 5;
+		in.validBytes = 3;
+		CMB_Pack(&packed, &in);
+		assert(packed.header == 0x7FF);
+		CMB_Unpack(&out, &packed);
+		assert(out.buffer == 0 && out.validBytes == 3);
+		assert(out.payload[2] == 0xFF && out.payload[3] == 0 && out.payload[6] == 0 && out.payload[7] == 0);
+		assert(packed.payload[3] == 0 && packed.payload[6] == 0);
+		in.validBytes = 12;
+		CMB_Pack(&packed, &in);
+		CMB_Unpack(&out, &packed);
+		assert(out.validBytes == 8 && out.payload[7] == 0xFF);
+	}
+
+	// Check that invalid arguments are rejected.
+	{
+		CanMessageBuffer b;
+		tCanPackedMessage slots[4];
+		assert(CMB_Init(&b, slots, 0) == STANDARD_ERROR);
+		assert(CMB_Init(&b, slots, 3) == STANDARD_ERROR);
+		assert(CMB_Init(&b, NULL, 4) == STANDARD_ERROR);
+		assert(CMB_Init(NULL, slots, 4) == STANDARD_ERROR);
+		assert(CMB_Init(&b, slots, 4) == SUCCESS);
+	}
+
+	// Fill the buffer, overflow it, and then read everything back across the wrap-around point.
+	{
+		CanMessageBuffer b;
+		tCanPackedMessage slots[8];
+		tCanMessage in, out;
+		uint8_t i;
+
+		CMB_Init(&b, slots, 8);
+		assert(!CMB_Read(&b, &out));
+		assert(!CMB_Peek(&b, &out));
+
+		// Offset the indices so the following writes wrap.
+		MakeMessage(&in, 0);
+		assert(CMB_Write(&b, &in));
+		assert(CMB_Write(&b, &in));
+		assert(CMB_Read(&b, &out));
+		assert(CMB_Remove(&b, 1));
+		assert(CMB_GetLength(&b) == 0);
+
+		for (i = 0; i < 8; ++i) {
+			MakeMessage(&in, i);
+			assert(CMB_Write(&b, &in));
+			assert(CMB_GetLength(&b) == i + 1);
+		}
+		assert(!CMB_Write(&b, &in));
+		assert(b.overflowCount == 1);
+		assert(CMB_GetLength(&b) == 8);
+
+		MakeMessage(&in, 0);
+		assert(CMB_Peek(&b, &out));
+		assert(memcmp(&in, &out, sizeof(tCanMessage)) == 0);
+		assert(CMB_GetLength(&b) == 8);
+
+		for (i = 0; i < 8; ++i) {
+			MakeMessage(&in, i);
+			assert(CMB_Read(&b, &out));
+			assert(memcmp(&in, &out, sizeof(tCanMessage)) == 0);
+		}
+		assert(CMB_GetLength(&b) == 0);
+		assert(b.readCount == b.writeCount);
+	}
+
+	// Check removing messages, including more than are stored.
+	{
+		CanMessageBuffer b;
+		tCanPackedMessage slots[4];
+		tCanMessage in, out;
+		uint8_t i;
+
+		CMB_Init(&b, slots, 4);
+		for (i = 0; i < 3; ++i) {
+			MakeMessage(&in, i);
+			CMB_Write(&b, &in);
+		}
+		assert(CMB_Remove(&b, 2));
+		assert(CMB_GetLength(&b) == 1);
+		assert(CMB_Read(&b, &out) && out.id == 0x102);
+
+		for (i = 0; i < 3; ++i) {
+			CMB_Write(&b, &in);
+		}
+		assert(CMB_Remove(&b, 10));
+		assert(CMB_GetLength(&b) == 0);
+		assert(b.readCount == b.writeCount);
+	}
+
+	// Check writing many messages at once across the wrap-around point and past the end.
+	{
+		CanMessageBuffer b;
+		tCanPackedMessage slots[8];
+		tCanMessage in[10], out;
+		uint8_t i;
+
+		CMB_Init(&b, slots, 8);
+		for (i = 0; i < 10; ++i) {
+			MakeMessage(&in[i], i);
+		}
+		assert(CMB_WriteMany(&b, in, 0) == 0);
+		assert(CMB_WriteMany(&b, in, 5) == 5);
+		assert(CMB_Remove(&b, 5));
+		assert(CMB_WriteMany(&b, in, 10) == 8);
+		assert(b.overflowCount == 2);
+		assert(CMB_WriteMany(&b, in, 1) == 0);
+		assert(b.overflowCount == 3);
+		for (i = 0; i < 8; ++i) {
+			assert(CMB_Read(&b, &out));
+			assert(memcmp(&in[i], &out, sizeof(tCanMessage)) == 0);
+		}
+		assert(CMB_GetLength(&b) == 0);
+	}
+
+	// Check reading many messages at once across the wrap-around point.
+	{
+		CanMessageBuffer b;
+		tCanPackedMessage slots[8];
+		tCanMessage in, out[8];
+		uint8_t i;
+
+		CMB_Init(&b, slots, 8);
+		assert(CMB_ReadMany(&b, out, 8) == 0);
+		for (i = 0; i < 5; ++i) {
+			MakeMessage(&in, i);
+			CMB_Write(&b, &in);
+		}
+		assert(CMB_ReadMany(&b, out, 3) == 3);
+		assert(out[2].id == 0x102);
+		for (i = 5; i < 11; ++i) {
+			MakeMessage(&in, i);
+			CMB_Write(&b, &in);
+		}
+		assert(CMB_GetLength(&b) == 8);
+		memset(out, 0, sizeof(out));
+		assert(CMB_ReadMany(&b, out, 10) == 8);
+		for (i = 0; i < 8; ++i) {
+			MakeMessage(&in, i + 3);
+			assert(memcmp(&in, &out[i], sizeof(tCanMessage)) == 0);
+		}
+		assert(CMB_GetLength(&b) == 0);
+	}
+
+	// Check filling and reading slots in place.
+	{
+		CanMessageBuffer b;
+		tCanPackedMessage slots[4];
+		tCanPackedMessage packed;
+		tCanMessage in, out;
+		tCanPackedMessage *slot;
+		const tCanPackedMessage *peeked;
+		uint16_t count;
+		uint8_t i;
+
+		CMB_Init(&b, slots, 4);
+		assert(!CMB_PeekContiguous(&b, &count));
+		assert(count == 0);
+		assert(CMB_Consume(&b, 1) == STANDARD_ERROR);
+
+		// A reservation isn't visible until it's committed.
+		for (i = 0; i < 4; ++i) {
+			slot = CMB_Reserve(&b);
+			assert(slot == &slots[i]);
+			MakeMessage(&in, i);
+			CMB_Pack(slot, &in);
+			assert(CMB_GetLength(&b) == i);
+			assert(CMB_Commit(&b));
+		}
+		assert(!CMB_Reserve(&b));
+		assert(b.overflowCount == 1);
+		assert(CMB_Commit(&b) == STANDARD_ERROR);
+
+		peeked = CMB_PeekContiguous(&b, &count);
+		assert(peeked == slots && count == 4);
+		for (i = 0; i < 4; ++i) {
+			MakeMessage(&in, i);
+			CMB_Pack(&packed, &in);
+			assert(memcmp(&peeked[i], &packed, sizeof(tCanPackedMessage)) == 0);
+			CMB_Unpack(&out, &peeked[i]);
+			assert(memcmp(&in, &out, sizeof(tCanMessage)) == 0);
+		}
+		assert(CMB_Consume(&b, 3));
+		assert(CMB_GetLength(&b) == 1);
+
+		// Wrap around the end of the array and read back in two parts.
+		for (i = 4; i < 6; ++i) {
+			MakeMessage(&in, i);
+			assert(CMB_Write(&b, &in));
+		}
+		peeked = CMB_PeekContiguous(&b, &count);
+		assert(peeked == &slots[3] && count == 1);
+		assert((peeked->header & CMB_PACKED_ID) == 0x103);
+		assert(CMB_Consume(&b, count));
+		peeked = CMB_PeekContiguous(&b, NULL);
+		assert(peeked == slots && (peeked->header & CMB_PACKED_ID) == 0x104);
+		assert(CMB_Consume(&b, 3) == STANDARD_ERROR);
+		assert(CMB_Consume(&b, 2));
+		assert(CMB_GetLength(&b) == 0);
+	}
+
+	// Check filling and reading raw slots in place across the wrap-around point.
+	{
+		CanMessageBuffer b;
+		tCanRawMessage slots[4];
+		tCanRawMessage *slot;
+		const tCanRawMessage *peeked;
+		uint16_t count;
+		uint16_t i;
+
+		assert(CMB_InitRaw(&b, NULL, 4) == STANDARD_ERROR);
+		assert(CMB_InitRaw(&b, slots, 4) == SUCCESS);
+		assert(!CMB_PeekContiguousRaw(&b, &count) && count == 0);
+
+		for (i = 0; i < 6; ++i) {
+			slot = CMB_ReserveRaw(&b);
+			assert(slot == &slots[i & 3]);
+			memset(slot->words, i, sizeof(slot->words));
+			assert(CMB_Commit(&b));
+			if (i == 3) {
+				assert(!CMB_ReserveRaw(&b));
+				assert(b.overflowCount == 1);
+				assert(CMB_Consume(&b, 2));
+			}
+		}
+
+		peeked = CMB_PeekContiguousRaw(&b, &count);
+		assert(peeked == &slots[2] && count == 2);
+		assert(peeked[0].words[0] == 0x0202 && peeked[1].words[7] == 0x0303);
+		assert(CMB_Consume(&b, count));
+		peeked = CMB_PeekContiguousRaw(&b, &count);
+		assert(peeked == slots && count == 2);
+		assert(peeked[1].words[7] == 0x0505);
+		assert(CMB_Consume(&b, count));
+		assert(CMB_GetLength(&b) == 0);
+	}
+
+	// Check the usage statistics.
+	{
+		CanMessageBuffer b;
+		tCanPackedMessage slots[4];
+		tCanMessage in[6], out[6];
+		CanMessageBufferStats stats;
+		uint8_t i;
+
+		CMB_Init(&b, slots, 4);
+		for (i = 0; i < 6; ++i) {
+			MakeMessage(&in[i], i);
+		}
+#ifdef CMB_STATS
+		assert(CMB_GetStats(&b, &stats));
+		assert(stats.messagesWritten == 0 && stats.messagesRead == 0 && stats.peakLength == 0);
+		assert(!CMB_GetStats(&b, NULL));
+
+		// Every write and read path is counted, but not an abandoned reservation.
+		assert(CMB_Write(&b, &in[0]));
+		assert(CMB_WriteMany(&b, in, 2) == 2);
+		assert(CMB_Reserve(&b));
+		assert(CMB_Reserve(&b));
+		assert(CMB_Commit(&b));
+		assert(CMB_Read(&b, &out[0]));
+		assert(CMB_ReadMany(&b, out, 2) == 2);
+		assert(CMB_Remove(&b, 3));
+		assert(CMB_GetStats(&b, &stats));
+		assert(stats.messagesWritten == 4);
+		assert(stats.messagesRead == 4);
+		assert(stats.peakLength == 4);
+		assert(stats.messagesLost == 0);
+
+		// Every message added to overflowCount is lost.
+		assert(CMB_WriteMany(&b, in, 6) == 4);
+		assert(!CMB_Write(&b, &in[0]));
+		assert(!CMB_Reserve(&b));
+		assert(CMB_PeekContiguous(&b, NULL));
+		assert(CMB_Consume(&b, 1));
+		assert(CMB_GetStats(&b, &stats));
+		assert(stats.messagesWritten == 8 && stats.messagesRead == 5);
+		assert(stats.messagesLost == 4 && b.overflowCount == 4);
+
+		// Resetting keeps the peak at what the buffer holds now.
+		CMB_ResetStats(&b);
+		assert(CMB_GetStats(&b, &stats));
+		assert(stats.messagesWritten == 0 && stats.messagesRead == 0 && stats.messagesLost == 0);
+		assert(stats.peakLength == 3);
+#else
+		assert(!CMB_GetStats(&b, &stats));
+		(void)out;
+#endif
+	}
+
+	printf("All tests passed.\n");
+
+	return 0;
+}
+#endif // UNIT_TEST_CAN_MESSAGE_BUFFER
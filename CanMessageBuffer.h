@@ -0,0 +1,307 @@
+/**
+ * @file   CanMessageBuffer.h
+ * @date   October, 2026
+ * @brief  Provides a circular buffer of whole tCanMessage structs.
+ *
+ * This buffer is the message-oriented counterpart to CircularBuffer. Where CircularBuffer moves
+ * structs through a byte array one byte at a time, checking for wrap-around on every byte, a
+ * CanMessageBuffer stores messages in fixed slots, and all counts are in messages rather than bytes.
+ *
+ * Slots hold messages in the 12-byte tCanPackedMessage form rather than as 16-byte tCanMessages,
+ * so a third more messages fit into the same memory. CMB_Write() and the reading functions pack
+ * and unpack messages on the way through, while CMB_Reserve() and CMB_PeekContiguous() hand out
+ * the packed slots themselves for code that can fill or read them directly.
+ *
+ * A buffer can instead be set up with CMB_InitRaw() to hold the 8 words of ECAN message buffers
+ * exactly as the module left them in DMA RAM, so that an interrupt handler can queue a message
+ * with a single block copy and leave the decoding to the consumer. Such a buffer is only filled
+ * and read in place, through CMB_ReserveRaw() and CMB_PeekContiguousRaw().
+ *
+ * Like MaskedBuffer, the number of slots must be a power of two. Slots are indexed by masking
+ * free-running read and write counters, and the number of stored messages is their difference.
+ *
+ * The buffer is safe for a single producer and a single consumer running concurrently, such as an
+ * interrupt handler and the main loop, without masking interrupts. CMB_Write() only ever modifies
+ * writeCount and the reading functions only ever modify readCount, and each counter is published
+ * with a single 16-bit store after the slot it covers has been filled or emptied.
+ *
+ * Like CB_STATS for CircularBuffer, defining CMB_STATS adds 32-bit usage statistics to every
+ * buffer, read with CMB_GetStats(). As it changes the size of the CanMessageBuffer struct, it must
+ * be defined for every file that includes this header, so it's best passed on the compiler command
+ * line. The producer only updates the counts of written and lost messages and the peak, and the
+ * consumer only the count of read messages, so the statistics are as safe to share as the buffer.
+ *
+ * Unit testing has been completed on x86 by compiling with the UNIT_TEST_CAN_MESSAGE_BUFFER macro.
+ * With gcc: `gcc CanMessageBuffer.c -DUNIT_TEST_CAN_MESSAGE_BUFFER -Wall`
+ * Add -DCMB_STATS to test the statistics as well.
+ */
+#ifndef _CAN_MESSAGE_BUFFER_H_
+#define _CAN_MESSAGE_BUFFER_H_
+
+#include "Common.h"
+#include "ecanDefinitions.h"
+
+// The fields of tCanPackedMessage.header.
+#define CMB_PACKED_ID   0x1FFFFFFFUL //!< The 11-bit or 29-bit message ID.
+#define CMB_PACKED_EXT  0x20000000UL //!< Set for extended frames.
+#define CMB_PACKED_RTR  0x40000000UL //!< Set for remote transmit requests.
+#define CMB_PACKED_FULL 0x80000000UL //!< Set if all 8 payload bytes are valid.
+
+/**
+ * @brief The form messages are stored in within a CanMessageBuffer.
+ *
+ * A message's ID and flags are packed into a single word. There's no room left there for the
+ * number of valid bytes, so a message with fewer than 8 stores it in the last payload byte
+ * instead, which it doesn't use, and the payload bytes between are zero. The `buffer` field of
+ * tCanMessage isn't stored: an extended frame with 8 data bytes leaves no bits to spare for it.
+ */
+typedef struct {
+	uint32_t header;    //!< The message ID along with the CMB_PACKED_* flags.
+	uint8_t payload[8]; //!< The message payload. Without CMB_PACKED_FULL, payload[7] holds validBytes.
+} tCanPackedMessage;
+
+/**
+ * @brief The form messages are stored in within a buffer set up by CMB_InitRaw().
+ */
+typedef struct {
+	uint16_t words[8]; //!< An ECAN message buffer, in the module's DMA layout.
+} tCanRawMessage;
+
+/**
+ * @brief Usage statistics kept for a buffer when CMB_STATS is defined.
+ *
+ * Unlike overflowCount these don't wrap around until 2^32.
+ */
+typedef struct {
+	uint32_t messagesWritten; //!< The number of messages written into the buffer.
+	uint32_t messagesRead;    //!< The number of messages read or removed from the buffer.
+	uint32_t messagesLost;    //!< The number of messages that couldn't be written because the buffer was full.
+	uint16_t peakLength;      //!< The most unread messages the buffer has held at once.
+} CanMessageBufferStats;
+
+/**
+ * @brief A structure which holds information about the message buffer.
+ *
+ * The useful property is overflowCount. Use CMB_GetLength() for the number of stored messages.
+ */
+typedef struct {
+	volatile uint16_t readCount;  //!< The total number of messages ever read. Only the bits under `mask` index into `data`. Owned by the consumer.
+	volatile uint16_t writeCount; //!< The total number of messages ever written. Only the bits under `mask` index into `data`. Owned by the producer.
+	uint16_t mask;                //!< The number of slots in the buffer minus one.
+	uint8_t overflowCount;        //!< Tracks how many messages have been attempted to be written while the buffer was full.
+	tCanPackedMessage *data;      //!< A pointer to the slots managed by this buffer. Points to tCanRawMessage slots after CMB_InitRaw().
+#ifdef CMB_STATS
+	CanMessageBufferStats stats;  //!< Usage statistics. Read them with CMB_GetStats().
+#endif
+} CanMessageBuffer;
+
+/**
+ * @brief CMB_Init initializes the buffer.
+ *
+ * Initializes the passed CanMessageBuffer to use `size` slots starting at `data`. If either pointer
+ * is NULL or size isn't a power of two no larger than 32768 this function returns STANDARD_ERROR,
+ * otherwise SUCCESS is returned. Like CB_Init() this function can also be used to empty an existing
+ * buffer, but not while the producer or consumer may be running.
+ *
+ * @param b A pointer to a message buffer struct.
+ * @param data A pointer to an array of `size` messages.
+ * @param size The number of messages the buffer can hold.
+ */
+int CMB_Init(CanMessageBuffer *b, tCanPackedMessage *data, const uint16_t size);
+
+/**
+ * @brief CMB_InitRaw initializes the buffer to hold raw ECAN message buffers.
+ *
+ * Behaves like CMB_Init(). The buffer may then only be filled with CMB_ReserveRaw() and read with
+ * CMB_PeekContiguousRaw(), along with the functions that don't touch the slots themselves:
+ * CMB_GetLength(), CMB_Remove(), CMB_Commit() and CMB_Consume().
+ *
+ * @param b A pointer to a message buffer struct.
+ * @param data A pointer to an array of `size` raw messages.
+ * @param size The number of messages the buffer can hold.
+ */
+int CMB_InitRaw(CanMessageBuffer *b, tCanRawMessage *data, const uint16_t size);
+
+/**
+ * @brief CMB_Pack converts a message into the form it's stored in.
+ *
+ * A `validBytes` above 8 is stored as 8, and payload bytes beyond `validBytes` are stored as zero.
+ *
+ * @param packed Where the packed message will be written.
+ * @param msg The message to be packed.
+ */
+void CMB_Pack(tCanPackedMessage *packed, const tCanMessage *msg);
+
+/**
+ * @brief CMB_Unpack converts a stored message back into a tCanMessage.
+ *
+ * Payload bytes beyond `validBytes` come out as zero, as they were packed, and the `buffer` field is
+ * set to zero.
+ *
+ * @param msg Where the message will be written.
+ * @param packed The packed message.
+ */
+void CMB_Unpack(tCanMessage *msg, const tCanPackedMessage *packed);
+
+/**
+ * @brief CMB_GetLength returns the number of unread messages in the buffer.
+ */
+uint16_t CMB_GetLength(const CanMessageBuffer *b);
+
+/**
+ * @brief CMB_Write appends a message to the buffer.
+ *
+ * Returns SUCCESS if the message was stored. If the buffer is full nothing is written,
+ * overflowCount is incremented, and STANDARD_ERROR is returned.
+ *
+ * @param b A pointer to the CanMessageBuffer struct.
+ * @param msg The message to be copied into the buffer.
+ */
+int CMB_Write(CanMessageBuffer *b, const tCanMessage *msg);
+
+/**
+ * @brief CMB_WriteMany appends up to `count` messages to the buffer.
+ *
+ * As many messages as fit are packed into consecutive slots and published to the consumer together.
+ * The rest are added to overflowCount.
+ *
+ * @param b A pointer to the CanMessageBuffer struct.
+ * @param msgs The messages to be copied into the buffer, oldest first.
+ * @param count The number of messages in `msgs`.
+ * @return The number of messages written.
+ */
+uint16_t CMB_WriteMany(CanMessageBuffer *b, const tCanMessage *msgs, uint16_t count);
+
+/**
+ * @brief CMB_Read removes the oldest message from the buffer.
+ *
+ * Returns STANDARD_ERROR if the buffer is empty, in which case `msg` is left untouched.
+ *
+ * @param b A pointer to the CanMessageBuffer struct.
+ * @param msg Where the message will be copied to.
+ */
+int CMB_Read(CanMessageBuffer *b, tCanMessage *msg);
+
+/**
+ * @brief CMB_ReadMany removes up to `max` of the oldest messages from the buffer.
+ *
+ * The messages are unpacked out of consecutive slots and handed back to the producer together,
+ * rather than one at a time.
+ *
+ * @param b A pointer to the CanMessageBuffer struct.
+ * @param msgs Where the messages will be copied to. Must have room for `max` messages.
+ * @param max The most messages to read.
+ * @return The number of messages read.
+ */
+uint16_t CMB_ReadMany(CanMessageBuffer *b, tCanMessage *msgs, uint16_t max);
+
+/**
+ * @brief CMB_Peek copies the oldest message from the buffer without removing it.
+ *
+ * Returns STANDARD_ERROR if the buffer is empty.
+ *
+ * @param b A pointer to the CanMessageBuffer struct.
+ * @param msg Where the message will be copied to.
+ */
+int CMB_Peek(const CanMessageBuffer *b, tCanMessage *msg);
+
+/**
+ * @brief CMB_Remove discards messages from the front of the buffer.
+ *
+ * Removes `count` messages, or empties the buffer if it holds fewer than that. Always returns
+ * SUCCESS. This pairs with CMB_Peek() in the same way CB_Remove() pairs with CB_PeekMany().
+ *
+ * @param b A pointer to the CanMessageBuffer struct.
+ * @param count The number of messages to remove.
+ */
+int CMB_Remove(CanMessageBuffer *b, uint16_t count);
+
+/**
+ * @brief CMB_Reserve returns the next free slot for the producer to fill in place.
+ *
+ * This is the slot counterpart to CB_Reserve(). The message is only added to the buffer once
+ * CMB_Commit() is called, so a reservation can be abandoned. The slot is filled in packed form,
+ * for example with CMB_Pack(). If the buffer is full NULL is
+ * returned and overflowCount is incremented, just like a failed CMB_Write().
+ *
+ * @param b A pointer to the CanMessageBuffer struct.
+ */
+tCanPackedMessage *CMB_Reserve(CanMessageBuffer *b);
+
+/**
+ * @brief CMB_ReserveRaw is the CMB_Reserve() counterpart for buffers set up with CMB_InitRaw().
+ *
+ * @param b A pointer to the CanMessageBuffer struct.
+ */
+tCanRawMessage *CMB_ReserveRaw(CanMessageBuffer *b);
+
+/**
+ * @brief CMB_Commit adds the slot returned by CMB_Reserve() or CMB_ReserveRaw() to the buffer.
+ *
+ * Returns STANDARD_ERROR, adding nothing, if the buffer is full.
+ *
+ * @param b A pointer to the CanMessageBuffer struct.
+ */
+int CMB_Commit(CanMessageBuffer *b);
+
+/**
+ * @brief CMB_PeekContiguous returns a pointer to the oldest message for reading in place.
+ *
+ * This is the slot counterpart to CB_PeekContiguous(). `count` is set to the number of messages
+ * stored in consecutive slots from the returned pointer, which is less than CMB_GetLength() when
+ * the stored messages wrap around the end of the array. Returns NULL and sets `count` to 0 if the
+ * buffer is empty.
+ *
+ * @param b A pointer to the CanMessageBuffer struct.
+ * @param count Where the number of consecutive messages is stored. May be NULL.
+ */
+const tCanPackedMessage *CMB_PeekContiguous(const CanMessageBuffer *b, uint16_t *count);
+
+/**
+ * @brief CMB_PeekContiguousRaw is the CMB_PeekContiguous() counterpart for buffers set up with
+ * CMB_InitRaw().
+ *
+ * @param b A pointer to the CanMessageBuffer struct.
+ * @param count Where the number of consecutive messages is stored. May be NULL.
+ */
+const tCanRawMessage *CMB_PeekContiguousRaw(const CanMessageBuffer *b, uint16_t *count);
+
+/**
+ * @brief CMB_Consume releases messages read in place with CMB_PeekContiguous() or
+ * CMB_PeekContiguousRaw().
+ *
+ * Unlike CMB_Remove(), nothing is removed and STANDARD_ERROR is returned if the buffer holds fewer
+ * than `count` messages.
+ *
+ * @param b A pointer to the CanMessageBuffer struct.
+ * @param count The number of messages to release.
+ */
+int CMB_Consume(CanMessageBuffer *b, uint16_t count);
+
+/**
+ * @brief CMB_GetStats copies the buffer's usage statistics.
+ *
+ * The statistics cover everything since CMB_Init() or CMB_ResetStats(). A message only counts as
+ * written once it's been committed, so an abandoned reservation isn't counted, and every message
+ * added to overflowCount is also counted as lost.
+ *
+ * Returns STANDARD_ERROR, leaving `stats` unchanged, if either pointer is NULL or CMB_STATS isn't
+ * defined. Otherwise SUCCESS is returned.
+ *
+ * @param b A pointer to the CanMessageBuffer struct.
+ * @param stats Where the statistics are stored.
+ */
+int CMB_GetStats(const CanMessageBuffer *b, CanMessageBufferStats *stats);
+
+/**
+ * @brief CMB_ResetStats starts the buffer's usage statistics over.
+ *
+ * The peak starts again from the number of messages currently in the buffer. Like CMB_Init() this
+ * must not be called while the producer or consumer may be running. Does nothing if b is NULL or
+ * CMB_STATS isn't defined.
+ *
+ * @param b A pointer to the CanMessageBuffer struct.
+ */
+void CMB_ResetStats(CanMessageBuffer *b);
+
+#endif /* _CAN_MESSAGE_BUFFER_H_ */
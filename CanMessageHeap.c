@@ -0,0 +1,304 @@
+/**
+ * @file   CanMessageHeap.c
+ * @date   October, 2026
+ * @brief  Provides a queue of tCanMessage structs ordered by CAN arbitration priority.
+ *
+ * Unit testing has been completed on x86 by compiling with the UNIT_TEST_CAN_MESSAGE_HEAP macro.
+ * With gcc: `gcc CanMessageHeap.c CanMessageBuffer.c -DUNIT_TEST_CAN_MESSAGE_HEAP -Wall`
+ */
+#include "CanMessageHeap.h"
+
+#include <stddef.h>
+
+/**
+ * Returns true if slot `a` should be sent before slot `b`.
+ */
+static bool Before(const CanMessageHeap *h, uint8_t a, uint8_t b)
+{
+	const CanMessageHeapSlot *slotA = &h->data[a];
+	const CanMessageHeapSlot *slotB = &h->data[b];
+
+	if (slotA->priority != slotB->priority) {
+		return slotA->priority < slotB->priority;
+	}
+	return (int32_t) (slotA->sequence - slotB->sequence) < 0;
+}
+
+int CMH_Init(CanMessageHeap *h, CanMessageHeapSlot *data, uint8_t *order, const uint8_t size)
+{
+	uint8_t i;
+
+	if (!h || !data || !order || !size) {
+		return STANDARD_ERROR;
+	}
+
+	h->data = data;
+	h->order = order;
+	h->size = size;
+	h->length = 0;
+	h->sequence = 0;
+	h->overflowCount = 0;
+	for (i = 0; i < size; ++i) {
+		order[i] = i;
+	}
+
+	return SUCCESS;
+}
+
+uint8_t CMH_GetLength(const CanMessageHeap *h)
+{
+	return h->length;
+}
+
+uint32_t CMH_Priority(const tCanMessage *msg)
+{
+	uint32_t rtr = (msg->message_type == CAN_MSG_RTR);
+
+	if (msg->frame_type == CAN_FRAME_EXT) {
+		// SRR and IDE are both recessive.
+		return ((msg->id >> 18) & 0x7FF) << 21 | 3UL << 19 | (msg->id & 0x3FFFF) << 1 | rtr;
+	}
+	return (msg->id & 0x7FF) << 21 | rtr << 20;
+}
+
+int CMH_Push(CanMessageHeap *h, const tCanMessage *msg)
+{
+	uint8_t position, parent, slot;
+
+	if (h->length >= h->size) {
+		++h->overflowCount;
+		return STANDARD_ERROR;
+	}
+
+	// Fill the first free slot.
+	position = h->length++;
+	slot = h->order[position];
+	CMB_Pack(&h->data[slot].message, msg);
+	h->data[slot].priority = CMH_Priority(msg);
+	h->data[slot].sequence = h->sequence++;
+
+	// And sift it up towards the root.
+	while (position) {
+		parent = (position - 1) >> 1;
+		if (!Before(h, slot, h->order[parent])) {
+			break;
+		}
+		h->order[position] = h->order[parent];
+		position = parent;
+	}
+	h->order[position] = slot;
+
+	return SUCCESS;
+}
+
+const tCanPackedMessage *CMH_Peek(const CanMessageHeap *h)
+{
+	if (!h->length) {
+		return NULL;
+	}
+	return &h->data[h->order[0]].message;
+}
+
+int CMH_Remove(CanMessageHeap *h)
+{
+	uint8_t position, slot, removed;
+	uint16_t child; // 2 * position + 1 overflows a byte in heaps of more than 128 slots.
+
+	if (!h->length) {
+		return STANDARD_ERROR;
+	}
+
+	// The removed slot becomes the first free one, and the last message in the heap is sifted
+	// down from the root to take its place.
+	removed = h->order[0];
+	slot = h->order[--h->length];
+	h->order[h->length] = removed;
+
+	position = 0;
+	while ((child = 2 * position + 1) < h->length) {
+		if (child + 1 < h->length && Before(h, h->order[child + 1], h->order[child])) {
+			++child;
+		}
+		if (!Before(h, h->order[child], slot)) {
+			break;
+		}
+		h->order[position] = h->order[child];
+		position = (uint8_t) child;
+	}
+	if (h->length) {
+		h->order[position] = slot;
+	}
+
+	return SUCCESS;
+}
+
+/**
+ * This begins the unit testing code. Directions for compilation are at the top of the file.
+ */
+#ifdef UNIT_TEST_CAN_MESSAGE_HEAP
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * @brief Fills in a message with the given identifier whose payload records `i`.
+ */
+static void MakeMessage(tCanMessage *msg, uint32_t id, uint8_t frameType, uint8_t i)
+{
+	memset(msg, 0, sizeof(tCanMessage));
+	msg->id = id;
+	msg->frame_type = frameType;
+	msg->message_type = CAN_MSG_DATA;
+	msg->validBytes = 1;
+	msg->payload[0] = i;
+}
+
+int main()
+{
+	printf("Running unit tests.\n");
+
+	// Check that invalid arguments are rejected.
+	{
+		CanMessageHeap h;
+		CanMessageHeapSlot data[4];
+		uint8_t order[4];
+		assert(CMH_Init(&h, NULL, order, 4) == STANDARD_ERROR);
+		assert(CMH_Init(&h, data, NULL, 4) == STANDARD_ERROR);
+		assert(CMH_Init(&h, data, order, 0) == STANDARD_ERROR);
+		assert(CMH_Init(&h, data, order, 4) == SUCCESS);
+		assert(CMH_GetLength(&h) == 0);
+		assert(CMH_Peek(&h) == NULL);
+		assert(CMH_Remove(&h) == STANDARD_ERROR);
+	}
+
+	// Check the arbitration order between frame types.
+	{
+		tCanMessage a, b;
+
+		// Lower identifiers win.
+		MakeMessage(&a, 0x100, CAN_FRAME_STD, 0);
+		MakeMessage(&b, 0x101, CAN_FRAME_STD, 0);
+		assert(CMH_Priority(&a) < CMH_Priority(&b));
+
+		// A data frame beats a remote frame with the same identifier.
+		b = a;
+		b.message_type = CAN_MSG_RTR;
+		assert(CMH_Priority(&a) < CMH_Priority(&b));
+
+		// A standard frame, even a remote one, beats an extended frame with the same base identifier.
+		MakeMessage(&a, 0x100 << 18, CAN_FRAME_EXT, 0);
+		assert(CMH_Priority(&b) < CMH_Priority(&a));
+
+		// But loses to an extended frame with a lower base identifier.
+		MakeMessage(&a, (0x0FF << 18) | 0x3FFFF, CAN_FRAME_EXT, 0);
+		assert(CMH_Priority(&a) < CMH_Priority(&b));
+
+		// Extended frames are ordered by the rest of their identifier, then RTR.
+		MakeMessage(&a, (0x100 << 18) | 5, CAN_FRAME_EXT, 0);
+		MakeMessage(&b, (0x100 << 18) | 6, CAN_FRAME_EXT, 0);
+		assert(CMH_Priority(&a) < CMH_Priority(&b));
+		b = a;
+		b.message_type = CAN_MSG_RTR;
+		assert(CMH_Priority(&a) < CMH_Priority(&b));
+	}
+
+	// Fill the heap in a scrambled order, overflow it, and check that messages come out by
+	// priority, with equal priorities in the order they were pushed.
+	{
+		CanMessageHeap h;
+		CanMessageHeapSlot data[16];
+		uint8_t order[16];
+		tCanMessage msg;
+		const tCanPackedMessage *out;
+		uint8_t i;
+
+		CMH_Init(&h, data, order, 16);
+		for (i = 0; i < 16; ++i) {
+			MakeMessage(&msg, 0x200 + (i * 7) % 4, CAN_FRAME_STD, i);
+			assert(CMH_Push(&h, &msg));
+			assert(CMH_GetLength(&h) == i + 1);
+		}
+		assert(!CMH_Push(&h, &msg));
+		assert(h.overflowCount == 1);
+
+		uint32_t lastId = 0;
+		int lastIndex = -1;
+		for (i = 0; i < 16; ++i) {
+			out = CMH_Peek(&h);
+			assert(out);
+			assert((out->header & CMB_PACKED_ID) >= lastId);
+			if ((out->header & CMB_PACKED_ID) == lastId) {
+				assert(out->payload[0] > lastIndex);
+			}
+			lastId = out->header & CMB_PACKED_ID;
+			lastIndex = out->payload[0];
+			assert(CMH_Remove(&h));
+		}
+		assert(CMH_GetLength(&h) == 0);
+		assert(CMH_Peek(&h) == NULL);
+	}
+
+	// Fill and drain the largest heap with random identifiers, whose positions deep in the heap
+	// have children beyond index 255.
+	{
+		static CanMessageHeapSlot data[255];
+		static uint8_t order[255];
+		CanMessageHeap h;
+		tCanMessage msg;
+		const tCanPackedMessage *out;
+		uint32_t seed = 7;
+		uint32_t lastId = 0;
+		uint16_t i;
+
+		CMH_Init(&h, data, order, 255);
+		for (i = 0; i < 255; ++i) {
+			seed = seed * 1103515245 + 12345;
+			MakeMessage(&msg, (seed >> 16) & 0x7FF, CAN_FRAME_STD, (uint8_t) i);
+			assert(CMH_Push(&h, &msg));
+		}
+		assert(CMH_GetLength(&h) == 255);
+		assert(!CMH_Push(&h, &msg));
+		for (i = 0; i < 255; ++i) {
+			out = CMH_Peek(&h);
+			assert(out);
+			assert((out->header & CMB_PACKED_ID) >= lastId);
+			lastId = out->header & CMB_PACKED_ID;
+			assert(CMH_Remove(&h));
+			assert(CMH_GetLength(&h) == 254 - i);
+		}
+		assert(CMH_Peek(&h) == NULL);
+	}
+
+	// Interleave pushes and removals over many passes and check against a sorted reference.
+	{
+		CanMessageHeap h;
+		CanMessageHeapSlot data[7];
+		uint8_t order[7];
+		tCanMessage msg;
+		uint32_t seed = 1;
+		uint32_t i;
+		uint8_t j;
+
+		CMH_Init(&h, data, order, 7);
+		for (i = 0; i < 20000; ++i) {
+			seed = seed * 1103515245 + 12345;
+			if ((seed >> 16) % 3 && CMH_GetLength(&h) < 7) {
+				MakeMessage(&msg, (seed >> 8) & 0x1F, CAN_FRAME_STD, (uint8_t) i);
+				assert(CMH_Push(&h, &msg));
+			} else if (CMH_GetLength(&h)) {
+				// The root must not be beaten by any other stored message.
+				const tCanPackedMessage *top = CMH_Peek(&h);
+				for (j = 1; j < CMH_GetLength(&h); ++j) {
+					assert(top->header <= data[order[j]].message.header);
+				}
+				assert(CMH_Remove(&h));
+			}
+		}
+	}
+
+	printf("All tests passed.\n");
+
+	return 0;
+}
+#endif // UNIT_TEST_CAN_MESSAGE_HEAP
@@ -0,0 +1,116 @@
+/**
+ * @file   CanMessageHeap.h
+ * @date   October, 2026
+ * @brief  Provides a queue of tCanMessage structs ordered by CAN arbitration priority.
+ *
+ * Where CanMessageBuffer hands messages out in the order they were written, a CanMessageHeap hands
+ * out the message that would win arbitration on the bus first. Messages with the same priority
+ * come out in the order they were pushed, as CAN requires for frames with the same identifier.
+ *
+ * The queue is a binary heap over message slots. Messages are never moved once pushed; only a
+ * byte-sized slot index is moved around while sifting, so a push or a removal costs at most
+ * log2(size) index swaps. The `order` array doubles as the free list: its first CMH_GetLength()
+ * entries are the heap and the rest are the free slots.
+ *
+ * Messages are stored in the same packed form as in a CanMessageBuffer, so this module is built
+ * along with CanMessageBuffer.c.
+ *
+ * Unlike CanMessageBuffer, a heap is not safe to share between the main loop and an interrupt
+ * handler. Only one context may use it at a time.
+ *
+ * Unit testing has been completed on x86 by compiling with the UNIT_TEST_CAN_MESSAGE_HEAP macro.
+ * With gcc: `gcc CanMessageHeap.c CanMessageBuffer.c -DUNIT_TEST_CAN_MESSAGE_HEAP -Wall`
+ */
+#ifndef _CAN_MESSAGE_HEAP_H_
+#define _CAN_MESSAGE_HEAP_H_
+
+#include "Common.h"
+#include "ecanDefinitions.h"
+#include "CanMessageBuffer.h"
+
+/**
+ * @brief A message slot along with the keys it's ordered by.
+ */
+typedef struct {
+	tCanPackedMessage message; //!< The queued message.
+	uint32_t priority;         //!< The result of CMH_Priority() for the message. Lower values are sent first.
+	uint32_t sequence;         //!< When the message was pushed, for ordering messages of equal priority.
+} CanMessageHeapSlot;
+
+/**
+ * @brief A structure which holds information about the message heap.
+ *
+ * The useful property is overflowCount. Use CMH_GetLength() for the number of stored messages.
+ */
+typedef struct {
+	uint8_t length;           //!< The number of messages in the heap.
+	uint8_t size;             //!< The number of slots.
+	uint8_t overflowCount;    //!< Tracks how many messages have been attempted to be pushed while the heap was full.
+	uint32_t sequence;        //!< The sequence number given to the next pushed message.
+	uint8_t *order;           //!< Slot indices, in heap order for the first `length` entries.
+	CanMessageHeapSlot *data; //!< A pointer to the slots managed by this heap.
+} CanMessageHeap;
+
+/**
+ * @brief CMH_Init initializes the heap.
+ *
+ * Initializes the passed CanMessageHeap to use `size` slots starting at `data`, with `order`
+ * pointing at an array of `size` indices. If any pointer is NULL or `size` isn't between 1 and 255
+ * this function returns STANDARD_ERROR, otherwise SUCCESS is returned. This function can also be
+ * used to empty an existing heap.
+ *
+ * @param h A pointer to a message heap struct.
+ * @param data A pointer to an array of `size` slots.
+ * @param order A pointer to an array of `size` bytes.
+ * @param size The number of messages the heap can hold.
+ */
+int CMH_Init(CanMessageHeap *h, CanMessageHeapSlot *data, uint8_t *order, const uint8_t size);
+
+/**
+ * @brief CMH_GetLength returns the number of messages in the heap.
+ */
+uint8_t CMH_GetLength(const CanMessageHeap *h);
+
+/**
+ * @brief CMH_Priority returns the arbitration priority of a message. Lower values win.
+ *
+ * The value holds the frame's bits in the order they're sent during arbitration: the base
+ * identifier, then RTR or SRR, IDE, the extended identifier and finally the extended frame's RTR.
+ * So a standard frame beats an extended frame sharing its base identifier, and a data frame beats
+ * a remote frame with the same identifier, just as on the bus.
+ */
+uint32_t CMH_Priority(const tCanMessage *msg);
+
+/**
+ * @brief CMH_Push adds a message to the heap.
+ *
+ * Returns SUCCESS if the message was stored. If the heap is full nothing is written,
+ * overflowCount is incremented, and STANDARD_ERROR is returned.
+ *
+ * @param h A pointer to the CanMessageHeap struct.
+ * @param msg The message to be copied into the heap.
+ */
+int CMH_Push(CanMessageHeap *h, const tCanMessage *msg);
+
+/**
+ * @brief CMH_Peek returns a pointer to the highest-priority message for reading in place.
+ *
+ * The message is in the packed form described by tCanPackedMessage.
+ *
+ * Returns NULL if the heap is empty. The pointer is valid until the next CMH_Push() or
+ * CMH_Remove().
+ *
+ * @param h A pointer to the CanMessageHeap struct.
+ */
+const tCanPackedMessage *CMH_Peek(const CanMessageHeap *h);
+
+/**
+ * @brief CMH_Remove discards the highest-priority message.
+ *
+ * Returns STANDARD_ERROR if the heap is empty.
+ *
+ * @param h A pointer to the CanMessageHeap struct.
+ */
+int CMH_Remove(CanMessageHeap *h);
+
+#endif /* _CAN_MESSAGE_HEAP_H_ */
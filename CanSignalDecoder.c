@@ -0,0 +1,392 @@
+/**
+ * @file   CanSignalDecoder.c
+ * @date   October, 2026
+ * @brief  Decodes the signals packed into CAN payloads from a table of DBC-style descriptors.
+ *
+ * Unit testing has been completed on x86 by compiling with the UNIT_TEST_CAN_SIGNAL_DECODER macro.
+ * With gcc: `gcc CanSignalDecoder.c -DUNIT_TEST_CAN_SIGNAL_DECODER -Wall`
+ */
+#include "CanSignalDecoder.h"
+
+#include <stddef.h>
+
+// The current database, and where each message's signals start in the output vector.
+static const tCanSignalMessage *database;
+static uint8_t databaseCount;
+static uint16_t databaseOffsets[CSD_MAX_MESSAGES];
+static uint16_t signalCount;
+
+bool CSD_Check(const tCanSignal *signals, uint8_t count)
+{
+	uint8_t i;
+
+	if (!signals && count) {
+		return false;
+	}
+	for (i = 0; i < count; ++i) {
+		if (signals[i].length < 1 || signals[i].length > 64 || signals[i].shift > 64 - signals[i].length) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Decodes every signal from a payload read as a little-endian 64-bit number into `values`, or into
+ * `doubles` if `values` is NULL. Either way the arithmetic is done in single precision.
+ */
+static void DecodeLittle(const tCanSignal *signals, uint8_t count, uint64_t little, float *values,
+                         double *doubles)
+{
+	uint64_t big = 0;
+	uint8_t i;
+
+	// Read the payload in the other byte order once for all of the signals.
+	for (i = 0; i < 8; ++i) {
+		big = big << 8 | (uint8_t) (little >> (8 * i));
+	}
+
+	for (i = 0; i < count; ++i) {
+		const tCanSignal *s = &signals[i];
+		uint64_t raw = ((s->flags & CSD_BIG) ? big : little) >> s->shift;
+		float value;
+
+		// Most signals fit in 32 bits, which is much cheaper to convert.
+		if (s->length <= 32) {
+			uint32_t raw32 = (uint32_t) raw;
+			if (s->length < 32) {
+				raw32 &= (1UL << s->length) - 1;
+				if ((s->flags & CSD_SIGNED) && (raw32 >> (s->length - 1))) {
+					raw32 |= ~0UL << s->length;
+				}
+			}
+			value = (s->flags & CSD_SIGNED) ? (float) (int32_t) raw32 : (float) raw32;
+		} else {
+			if (s->length < 64) {
+				raw &= (1ULL << s->length) - 1;
+				if ((s->flags & CSD_SIGNED) && (raw >> (s->length - 1))) {
+					raw |= ~0ULL << s->length;
+				}
+			}
+			value = (s->flags & CSD_SIGNED) ? (float) (int64_t) raw : (float) raw;
+		}
+		value = value * s->scale + s->offset;
+		if (values) {
+			values[i] = value;
+		} else {
+			doubles[i] = value;
+		}
+	}
+}
+
+void CSD_Decode(const tCanSignal *signals, uint8_t count, const uint8_t *payload, float *values)
+{
+	uint64_t little = 0;
+	uint8_t i;
+
+	for (i = 0; i < 8; ++i) {
+		little |= (uint64_t) payload[i] << (8 * i);
+	}
+	DecodeLittle(signals, count, little, values, NULL);
+}
+
+int CSD_SetDatabase(const tCanSignalMessage *messages, uint8_t count)
+{
+	uint16_t offset = 0;
+	uint8_t i;
+
+	if (!messages) {
+		count = 0;
+	}
+	if (count > CSD_MAX_MESSAGES) {
+		return STANDARD_ERROR;
+	}
+	for (i = 0; i < count; ++i) {
+		if ((i && messages[i].id <= messages[i - 1].id) ||
+		    !CSD_Check(messages[i].signals, messages[i].count)) {
+			return STANDARD_ERROR;
+		}
+	}
+
+	for (i = 0; i < count; ++i) {
+		databaseOffsets[i] = offset;
+		offset += messages[i].count;
+	}
+	database = messages;
+	databaseCount = count;
+	signalCount = offset;
+
+	return SUCCESS;
+}
+
+uint16_t CSD_GetSignalCount(void)
+{
+	return signalCount;
+}
+
+/**
+ * Returns the index of the database message with the given identifier, or databaseCount if there's
+ * none.
+ */
+static uint8_t Find(uint32_t id)
+{
+	uint8_t low = 0;
+	uint8_t high = databaseCount;
+	uint8_t middle;
+
+	while (low < high) {
+		middle = (low + high) >> 1;
+		if (database[middle].id < id) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+	return (low < databaseCount && database[low].id == id) ? low : databaseCount;
+}
+
+int CSD_DecodeMessage(const tCanMessage *msg, float *values)
+{
+	uint8_t index = Find(msg->id);
+	uint64_t little = 0;
+	uint8_t i;
+
+	if (index == databaseCount || msg->message_type == CAN_MSG_RTR) {
+		return STANDARD_ERROR;
+	}
+
+	// Only the valid bytes are loaded, so signals past them decode as zero.
+	for (i = 0; i < msg->validBytes && i < 8; ++i) {
+		little |= (uint64_t) msg->payload[i] << (8 * i);
+	}
+	DecodeLittle(database[index].signals, database[index].count, little, &values[databaseOffsets[index]], NULL);
+	return SUCCESS;
+}
+
+int CSD_DecodeMatlab(const uint32_t *message, double *values)
+{
+	uint8_t index = Find(message[0]);
+	uint8_t length = (uint8_t) message[3];
+	uint64_t little;
+
+	// Nothing is written unless every signal of the database fits into the output vector.
+	if (signalCount > message[4]) {
+		return STANDARD_ERROR;
+	}
+
+	// The upper half of the fourth word counts this message among those left, so it's only zero
+	// when there's no message.
+	if (index == databaseCount || !(message[3] >> 16) || (message[3] & 0x00000100)) {
+		return STANDARD_ERROR;
+	}
+
+	// The payload words are already in little-endian order. Bytes past the valid ones are masked
+	// off as in CSD_DecodeMessage().
+	little = (uint64_t) message[2] << 32 | message[1];
+	if (length < 8) {
+		little &= ((uint64_t) 1 << (8 * length)) - 1;
+	}
+	DecodeLittle(database[index].signals, database[index].count, little, NULL, &values[databaseOffsets[index]]);
+	return SUCCESS;
+}
+
+/**
+ * This begins the unit testing code. Directions for compilation are at the top of the file.
+ */
+#ifdef UNIT_TEST_CAN_SIGNAL_DECODER
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * @brief Returns whether two values are equal to within float precision.
+ */
+static bool Near(float a, float b)
+{
+	return fabsf(a - b) <= 1e-6f * (fabsf(a) + fabsf(b)) + 1e-6f;
+}
+
+int main()
+{
+	printf("Running unit tests.\n");
+
+	// Check that invalid descriptors are rejected.
+	{
+		const tCanSignal good[] = {
+			CSD_LITTLE_ENDIAN(0, 64, 0, 1, 0),
+			CSD_LITTLE_ENDIAN(63, 1, 0, 1, 0),
+			CSD_BIG_ENDIAN(7, 64, 0, 1, 0),
+			CSD_BIG_ENDIAN(56, 1, 0, 1, 0)
+		};
+		const tCanSignal tooLong[] = {CSD_LITTLE_ENDIAN(1, 64, 0, 1, 0)};
+		const tCanSignal empty[] = {CSD_LITTLE_ENDIAN(0, 0, 0, 1, 0)};
+		const tCanSignal pastEnd[] = {CSD_BIG_ENDIAN(60, 8, 0, 1, 0)};
+		const tCanSignal beforeStart[] = {CSD_BIG_ENDIAN(3, 8, 0, 1, 0)};
+
+		assert(CSD_Check(good, 4));
+		assert(!CSD_Check(tooLong, 1));
+		assert(!CSD_Check(empty, 1));
+		assert(!CSD_Check(pastEnd, 1));
+		assert(CSD_Check(beforeStart, 1));
+		assert(CSD_Check(NULL, 0));
+		assert(!CSD_Check(NULL, 1));
+	}
+
+	// Decode little-endian signals, including signed ones, across byte boundaries.
+	{
+		const uint8_t payload[8] = {0x34, 0x12, 0xF6, 0x5A, 0xFF, 0x7F, 0x00, 0x80};
+		const tCanSignal signals[] = {
+			CSD_LITTLE_ENDIAN(0, 16, 0, 1, 0),               // 0x1234
+			CSD_LITTLE_ENDIAN(16, 8, CSD_SIGNED, 0.5f, -40), // -10 * 0.5 - 40
+			CSD_LITTLE_ENDIAN(28, 4, 0, 1, 0),               // 0x5
+			CSD_LITTLE_ENDIAN(20, 8, 0, 1, 0),               // 0xAF
+			CSD_LITTLE_ENDIAN(32, 16, CSD_SIGNED, 1, 0),     // 0x7FFF
+			CSD_LITTLE_ENDIAN(63, 1, 0, 1, 0),               // 1
+			CSD_LITTLE_ENDIAN(48, 16, CSD_SIGNED, 1, 0),     // -32768
+			CSD_LITTLE_ENDIAN(0, 32, CSD_SIGNED, 1, 0),      // 0x5AF61234
+			CSD_LITTLE_ENDIAN(8, 40, 0, 1, 0)                // 0x7FFF5AF612
+		};
+		float values[9];
+
+		CSD_Decode(signals, 9, payload, values);
+		assert(values[0] == 0x1234);
+		assert(values[1] == -45);
+		assert(values[2] == 0x5);
+		assert(values[3] == 0xAF);
+		assert(values[4] == 0x7FFF);
+		assert(values[5] == 1);
+		assert(values[6] == -32768);
+		assert(Near(values[7], 0x5AF61234));
+		assert(Near(values[8], 0x7FFF5AF612ULL));
+	}
+
+	// Decode big-endian signals, which start at their highest bit.
+	{
+		const uint8_t payload[8] = {0x12, 0x34, 0x56, 0x78, 0x9A, 0xBC, 0xDE, 0xF0};
+		const tCanSignal signals[] = {
+			CSD_BIG_ENDIAN(7, 16, 0, 1, 0),           // 0x1234
+			CSD_BIG_ENDIAN(23, 8, 0, 1, 0),           // 0x56
+			CSD_BIG_ENDIAN(27, 8, 0, 1, 0),           // 0x89
+			CSD_BIG_ENDIAN(35, 12, CSD_SIGNED, 1, 0), // 0xABC
+			CSD_BIG_ENDIAN(7, 64, 0, 1, 0),           // The whole payload.
+			CSD_BIG_ENDIAN(47, 16, CSD_SIGNED, 0.01f, 2) // 0xBCDE
+		};
+		float values[6];
+
+		CSD_Decode(signals, 6, payload, values);
+		assert(values[0] == 0x1234);
+		assert(values[1] == 0x56);
+		assert(values[2] == 0x89);
+		assert(values[3] == (float) (0xABC - 0x1000));
+		assert(Near(values[4], (float) 0x123456789ABCDEF0ULL));
+		assert(Near(values[5], (0xBCDE - 0x10000) * 0.01f + 2));
+	}
+
+	// Decode through a database, both from messages and from the MATLAB format.
+	{
+		const tCanSignal status[] = {
+			CSD_LITTLE_ENDIAN(0, 8, 0, 1, 0),
+			CSD_LITTLE_ENDIAN(8, 8, 0, 1, 0)
+		};
+		const tCanSignal power[] = {
+			CSD_LITTLE_ENDIAN(0, 16, 0, 0.1f, 0),
+			CSD_LITTLE_ENDIAN(16, 16, CSD_SIGNED, 0.1f, 0),
+			CSD_LITTLE_ENDIAN(56, 8, 0, 1, 0)
+		};
+		const tCanSignal bad[] = {CSD_LITTLE_ENDIAN(60, 8, 0, 1, 0)};
+		const tCanSignalMessage messages[] = {
+			{0x100, status, 2},
+			{0x18FF0100, power, 3}
+		};
+		const tCanSignalMessage unsorted[] = {
+			{0x200, status, 2},
+			{0x100, status, 2}
+		};
+		const tCanSignalMessage invalid[] = {{0x100, bad, 1}};
+		tCanMessage msg;
+		float values[5] = {-1, -1, -1, -1, -1};
+		double wide[5] = {-1, -1, -1, -1, -1};
+		uint32_t matlab[5];
+
+		assert(CSD_SetDatabase(messages, 2));
+		assert(CSD_GetSignalCount() == 5);
+		assert(!CSD_SetDatabase(unsorted, 2));
+		assert(!CSD_SetDatabase(invalid, 1));
+		assert(CSD_GetSignalCount() == 5);
+
+		// A message only updates its own signals.
+		memset(&msg, 0, sizeof(msg));
+		msg.id = 0x100;
+		msg.frame_type = CAN_FRAME_STD;
+		msg.message_type = CAN_MSG_DATA;
+		msg.validBytes = 2;
+		msg.payload[0] = 7;
+		msg.payload[1] = 9;
+		assert(CSD_DecodeMessage(&msg, values));
+		assert(values[0] == 7 && values[1] == 9 && values[2] == -1);
+
+		// Bytes past the valid ones decode as zero, whatever they hold.
+		msg.validBytes = 1;
+		assert(CSD_DecodeMessage(&msg, values));
+		assert(values[0] == 7 && values[1] == 0);
+		msg.validBytes = 2;
+
+		// Unknown identifiers and remote frames are ignored.
+		msg.id = 0x101;
+		assert(!CSD_DecodeMessage(&msg, values));
+		msg.id = 0x100;
+		msg.message_type = CAN_MSG_RTR;
+		msg.payload[0] = 1;
+		assert(!CSD_DecodeMessage(&msg, values));
+		assert(values[0] == 7);
+
+		// A full frame in the MATLAB format, with the last byte in the top of the third word. Only the
+		// message's own doubles are written.
+		matlab[0] = 0x18FF0100;
+		matlab[1] = 0xFFF603E8;
+		matlab[2] = 0x2A000000;
+		matlab[3] = 8 | (3UL << 16);
+		matlab[4] = 5;
+		assert(CSD_DecodeMatlab(matlab, wide));
+		assert(wide[0] == -1);
+		assert(Near((float) wide[2], 100) && Near((float) wide[3], -1) && wide[4] == 42);
+
+		// A short frame, with junk past its valid bytes.
+		matlab[3] = 5 | (3UL << 16);
+		assert(CSD_DecodeMatlab(matlab, wide));
+		assert(Near((float) wide[2], 100) && Near((float) wide[3], -1) && wide[4] == 0);
+
+		// No message, or a remote one.
+		wide[4] = -1;
+		matlab[3] = 8;
+		assert(!CSD_DecodeMatlab(matlab, wide));
+		matlab[3] = 8 | 0x100 | (1UL << 16);
+		assert(!CSD_DecodeMatlab(matlab, wide));
+		assert(wide[4] == -1);
+
+		// An output vector narrower than the database is never written, even for a message whose
+		// signals would fit.
+		matlab[0] = 0x100;
+		matlab[1] = 0x0907;
+		matlab[3] = 2 | (1UL << 16);
+		matlab[4] = 4;
+		wide[0] = -1;
+		assert(!CSD_DecodeMatlab(matlab, wide));
+		assert(wide[0] == -1);
+		matlab[4] = 5;
+		assert(CSD_DecodeMatlab(matlab, wide));
+		assert(wide[0] == 7 && wide[1] == 9);
+
+		assert(CSD_SetDatabase(NULL, 0));
+		assert(CSD_GetSignalCount() == 0);
+		matlab[3] = 8 | (1UL << 16);
+		assert(!CSD_DecodeMatlab(matlab, wide));
+	}
+
+	printf("All tests passed.\n");
+
+	return 0;
+}
+#endif // UNIT_TEST_CAN_SIGNAL_DECODER
@@ -0,0 +1,143 @@
+/**
+ * @file   CanSignalDecoder.h
+ * @date   October, 2026
+ * @brief  Decodes the signals packed into CAN payloads from a table of DBC-style descriptors.
+ *
+ * Each signal is described by where it sits in the payload, its length, byte order and signedness,
+ * and the scale and offset that turn its raw value into a physical one, as in a DBC file. The
+ * descriptors are written with CSD_LITTLE_ENDIAN() and CSD_BIG_ENDIAN(), which take the DBC start
+ * bit and work out at compile time how far the signal has to be shifted down. Decoding a frame then
+ * loads its payload as a 64-bit number once in each byte order, and each signal costs one shift,
+ * one mask, an optional sign extension and a multiply-add.
+ *
+ * A database lists the decoded messages by identifier along with their signals. CSD_SetDatabase()
+ * lays all of the signals out in one output vector, message by message, so that a single
+ * CSD_DecodeMatlab() block can take the output of the reception blocks and update the signals of
+ * whichever message was received. This replaces a chain of Extract Bits, Shift Arithmetic and Data
+ * Type Conversion blocks for every signal.
+ *
+ * Unit testing has been completed on x86 by compiling with the UNIT_TEST_CAN_SIGNAL_DECODER macro.
+ * With gcc: `gcc CanSignalDecoder.c -DUNIT_TEST_CAN_SIGNAL_DECODER -Wall`
+ */
+#ifndef _CAN_SIGNAL_DECODER_H_
+#define _CAN_SIGNAL_DECODER_H_
+
+#include "Common.h"
+#include "ecanDefinitions.h"
+
+// The most messages a database may hold. This can be overridden by user code.
+#ifndef CSD_MAX_MESSAGES
+#define CSD_MAX_MESSAGES 32
+#endif
+
+// Signal flags.
+#define CSD_SIGNED 0x01 //!< The raw value is two's complement.
+#define CSD_BIG    0x02 //!< The signal is big-endian (Motorola). Set by CSD_BIG_ENDIAN().
+
+/**
+ * @brief Describes a signal, from CSD_LITTLE_ENDIAN() or CSD_BIG_ENDIAN().
+ */
+typedef struct {
+	uint8_t shift;  //!< The position of the signal's lowest bit in the payload read as a 64-bit number, little-endian or, with CSD_BIG, big-endian.
+	uint8_t length; //!< The number of bits, from 1 to 64.
+	uint8_t flags;  //!< CSD_SIGNED and CSD_BIG.
+	float scale;    //!< The physical value is the raw value times `scale`...
+	float offset;   //!< ...plus `offset`.
+} tCanSignal;
+
+/**
+ * @brief Describes a little-endian (Intel) signal starting at the given DBC start bit, which is its
+ * lowest bit.
+ */
+#define CSD_LITTLE_ENDIAN(start, length, flags, scale, offset) \
+	{(start), (length), (flags) & CSD_SIGNED, (scale), (offset)}
+
+/**
+ * @brief Describes a big-endian (Motorola) signal starting at the given DBC start bit, which is its
+ * highest bit. DBC bits are numbered from the lowest bit of byte 0 upwards.
+ */
+#define CSD_BIG_ENDIAN(start, length, flags, scale, offset) \
+	{56 - 8 * ((start) / 8) + (start) % 8 + 1 - (length), (length), ((flags) & CSD_SIGNED) | CSD_BIG, \
+	 (scale), (offset)}
+
+/**
+ * @brief A message in a database: the signals to decode from frames with the given identifier.
+ */
+typedef struct {
+	uint32_t id;               //!< The 11-bit or 29-bit message ID.
+	const tCanSignal *signals; //!< The message's signals.
+	uint8_t count;             //!< The number of signals.
+} tCanSignalMessage;
+
+/**
+ * @brief CSD_Check returns whether the descriptors are valid.
+ *
+ * Every signal must have a length of 1 to 64 bits and lie within the 8-byte payload. CSD_Decode()
+ * doesn't check, so tables that aren't known to be valid should be passed through here first.
+ */
+bool CSD_Check(const tCanSignal *signals, uint8_t count);
+
+/**
+ * @brief CSD_Decode decodes every signal of a payload.
+ *
+ * All 8 bytes are decoded, so signals past the frame's valid bytes take whatever those bytes hold.
+ * CSD_DecodeMessage() and CSD_DecodeMatlab() decode them as zero instead.
+ *
+ * @param signals The descriptors, which must pass CSD_Check().
+ * @param count The number of descriptors.
+ * @param payload The 8-byte payload.
+ * @param values Where the `count` physical values are stored, in the order of the descriptors.
+ */
+void CSD_Decode(const tCanSignal *signals, uint8_t count, const uint8_t *payload, float *values);
+
+/**
+ * @brief CSD_SetDatabase sets the messages decoded by CSD_DecodeMessage() and CSD_DecodeMatlab().
+ *
+ * The output vector holds the signals of every message in the order they're listed. The database
+ * is used in place, so it should be a const array, and must stay valid while in use.
+ *
+ * Returns STANDARD_ERROR, leaving the database unchanged, if there are more than CSD_MAX_MESSAGES
+ * messages, their identifiers aren't in ascending order, or any signal fails CSD_Check(). Otherwise
+ * SUCCESS is returned.
+ *
+ * @param messages The messages, in ascending order of identifier, or NULL for none.
+ * @param count The number of messages.
+ */
+int CSD_SetDatabase(const tCanSignalMessage *messages, uint8_t count);
+
+/**
+ * @brief CSD_GetSignalCount returns the length of the output vector for the current database.
+ */
+uint16_t CSD_GetSignalCount(void);
+
+/**
+ * @brief CSD_DecodeMessage decodes a received message's signals into the output vector.
+ *
+ * Returns STANDARD_ERROR, leaving `values` unchanged, if the message isn't in the database or is a
+ * remote transmit request. Otherwise only that message's part of `values` is updated and SUCCESS
+ * is returned. Only the identifier is compared, not the frame type. Payload bytes past `validBytes`
+ * are taken as zero.
+ *
+ * @param msg The message, as returned by ecan1_receive().
+ * @param values The output vector, CSD_GetSignalCount() floats long.
+ */
+int CSD_DecodeMessage(const tCanMessage *msg, float *values);
+
+/**
+ * @brief CSD_DecodeMatlab decodes a received message in the MATLAB format.
+ *
+ * Takes the 4 uint32s output by ecan1_receive_matlab() or ecan1_mailbox_read_matlab(), followed
+ * by the length of the output vector, and otherwise works like CSD_DecodeMessage(). Outputs
+ * without a message are ignored. The output vector holds doubles, Simulink's default type, though
+ * the values are only computed in single precision. With XC16's default 32-bit doubles they take
+ * no more room than floats.
+ *
+ * Returns STANDARD_ERROR, writing nothing, if CSD_GetSignalCount() is larger than the output
+ * vector, so that a database that outgrew the block's signal count can't write past its output.
+ *
+ * @param message The 4-element message, then the number of doubles in `values`.
+ * @param values The output vector, at least CSD_GetSignalCount() doubles long.
+ */
+int CSD_DecodeMatlab(const uint32_t *message, double *values);
+
+#endif /* _CAN_SIGNAL_DECODER_H_ */
@@ -27,6 +27,7 @@
  *
  * Unit testing has been completed on x86 by compiling with the UNIT_TEST_CIRCULAR_BUFFER macro.
  * With gcc: `gcc CircularBuffer.c -DUNIT_TEST_CIRCULAR_BUFFER -Wall`
+ * Add -DCB_STATS to test the statistics as well.
  */
 #include "CircularBuffer.h"
 #include "Common.h"
@@ -36,6 +37,49 @@
 #include <stdlib.h>
 #include <stdio.h>
 
+/**
+ * Records `size` bytes written into the buffer, once they've been added to dataSize.
+ */
+static inline void RecordWrite(CircularBuffer *b, uint16_t size)
+{
+#ifdef CB_STATS
+	b->stats.bytesWritten += size;
+	if (b->dataSize > b->stats.peakSize) {
+		b->stats.peakSize = b->dataSize;
+	}
+#else
+	(void)b;
+	(void)size;
+#endif
+}
+
+/**
+ * Records `size` bytes read or removed from the buffer.
+ */
+static inline void RecordRead(CircularBuffer *b, uint16_t size)
+{
+#ifdef CB_STATS
+	b->stats.bytesRead += size;
+#else
+	(void)b;
+	(void)size;
+#endif
+}
+
+/**
+ * Records a write that lost `lost` bytes because the buffer was full.
+ */
+static inline void RecordOverflow(CircularBuffer *b, uint16_t lost)
+{
+#ifdef CB_STATS
+	++b->stats.overflows;
+	b->stats.bytesLost += lost;
+#else
+	(void)b;
+	(void)lost;
+#endif
+}
+
 int CB_Init(CircularBuffer *b, uint8_t *buffer, const uint16_t size)
 {
 	// Check the validity of pointers.
@@ -62,6 +106,7 @@ int CB_Init(CircularBuffer *b, uint8_t *buffer, const uint16_t size)
 	b->staticSize = size;
 	b->dataSize = 0;
 	b->overflowCount = 0;
+	CB_ResetStats(b);
 
 	return SUCCESS;
 }
@@ -81,6 +126,7 @@ int CB_ReadByte(CircularBuffer *b, uint8_t *outData)
 				b->readIndex = b->readIndex < (b->staticSize - 1)?b->readIndex + 1:0;
 			}
 			--b->dataSize;
+			RecordRead(b, 1);
 			return SUCCESS;
 		}
 	}
@@ -108,6 +154,7 @@ int CB_ReadMany(CircularBuffer *b, void *outData, uint16_t size)
 				}
 			}
 			b->dataSize -= size;
+			RecordRead(b, size);
 			return SUCCESS;
 		}
 	}
@@ -120,6 +167,7 @@ int CB_WriteByte(CircularBuffer *b, uint8_t inData)
 		// If the buffer is full the overflow count is incremented and no data is written.
 		if (b->dataSize == b->staticSize) {
 			++b->overflowCount;
+			RecordOverflow(b, 1);
 			return STANDARD_ERROR;
 		} else {
 			b->data[b->writeIndex] = inData;
@@ -130,6 +178,7 @@ int CB_WriteByte(CircularBuffer *b, uint8_t inData)
 				b->writeIndex = b->writeIndex < (b->staticSize - 1) ? b->writeIndex + 1: 0;
 			}
 			++b->dataSize;
+			RecordWrite(b, 1);
 			return SUCCESS;
 		}
 	}
@@ -156,6 +205,7 @@ int CB_WriteMany(CircularBuffer *b, const void *inData, uint16_t size, bool fail
 					b->writeIndex = b->writeIndex < (b->staticSize - 1) ? b->writeIndex + 1: 0;
 				}
 				b->dataSize += i;
+				RecordWrite(b, i);
 				return SUCCESS;
 			}
 		}
@@ -166,6 +216,8 @@ int CB_WriteMany(CircularBuffer *b, const void *inData, uint16_t size, bool fail
 				//if the buffer is full the overflow count is increased and STANDARD_ERROR is returned
 				if (b->dataSize == b->staticSize) {
 					b->overflowCount += (size - i);
+					RecordWrite(b, i);
+					RecordOverflow(b, size - i);
 					return STANDARD_ERROR;
 				}
 				//reads an element from the buffer to data
@@ -175,6 +227,7 @@ int CB_WriteMany(CircularBuffer *b, const void *inData, uint16_t size, bool fail
 				//move the indicies and check for wrap around
 				b->writeIndex = (b->writeIndex < (b->staticSize - 1)) ? b->writeIndex + 1: 0;
 			}
+			RecordWrite(b, size);
 			return SUCCESS;
 		}
 	}
@@ -229,16 +282,110 @@ int CB_Remove(CircularBuffer *b, uint16_t size){
 			b->readIndex = b->readIndex + size;
 		}
 		b->dataSize -= size;
+		RecordRead(b, size);
 		return SUCCESS;
 	}
 	// If one is trying to remove more elements than are in the buffer, the buffer is made empty.
 	else {
+		RecordRead(b, b->dataSize);
 		b->readIndex = b->writeIndex;
 		b->dataSize = 0;
 		return SUCCESS;
 	}
 }
 
+void *CB_Reserve(CircularBuffer *b, uint16_t size)
+{
+	if (b && size) {
+		// There must be enough free space, and it must not wrap around the end of the buffer.
+		if (b->staticSize - b->dataSize >= size && b->staticSize - b->writeIndex >= size) {
+			return &b->data[b->writeIndex];
+		}
+	}
+	return NULL;
+}
+
+int CB_Commit(CircularBuffer *b, uint16_t size)
+{
+	if (b) {
+		if (b->staticSize - b->dataSize >= size) {
+			// Move the writeIndex forward taking into account wrap-around.
+			b->writeIndex += size;
+			if (b->writeIndex >= b->staticSize) {
+				b->writeIndex -= b->staticSize;
+			}
+			b->dataSize += size;
+			RecordWrite(b, size);
+			return SUCCESS;
+		}
+	}
+	return STANDARD_ERROR;
+}
+
+const void *CB_PeekContiguous(const CircularBuffer *b, uint16_t *size)
+{
+	if (b && b->dataSize) {
+		// The readable data runs until either the end of the data or the end of the buffer.
+		if (size) {
+			*size = b->staticSize - b->readIndex;
+			if (*size > b->dataSize) {
+				*size = b->dataSize;
+			}
+		}
+		return &b->data[b->readIndex];
+	}
+	if (size) {
+		*size = 0;
+	}
+	return NULL;
+}
+
+int CB_Consume(CircularBuffer *b, uint16_t size)
+{
+	if (b) {
+		if (b->dataSize >= size) {
+			// Move the readIndex forward taking into account wrap-around.
+			b->readIndex += size;
+			if (b->readIndex >= b->staticSize) {
+				b->readIndex -= b->staticSize;
+			}
+			b->dataSize -= size;
+			RecordRead(b, size);
+			return SUCCESS;
+		}
+	}
+	return STANDARD_ERROR;
+}
+
+int CB_GetStats(const CircularBuffer *b, CircularBufferStats *stats)
+{
+#ifdef CB_STATS
+	if (b && stats) {
+		*stats = b->stats;
+		return SUCCESS;
+	}
+#else
+	(void)b;
+	(void)stats;
+#endif
+	return STANDARD_ERROR;
+}
+
+void CB_ResetStats(CircularBuffer *b)
+{
+#ifdef CB_STATS
+	if (b) {
+		b->stats.bytesWritten = 0;
+		b->stats.bytesRead = 0;
+		b->stats.overflows = 0;
+		b->stats.bytesLost = 0;
+		b->stats.peakSize = b->dataSize;
+	}
+#else
+	(void)b;
+#endif
+}
+
 /**
  * This begins the unit testing code. Directions for compilation are at the top of the header file.
  */
@@ -823,6 +970,129 @@ int main()
 		assert(TestStructEqual(&t1, &peekTest));
 	}
 
+	// Test writing and reading in place with CB_Reserve()/CB_Commit() and
+	// CB_PeekContiguous()/CB_Consume().
+	{
+		CircularBuffer b;
+		uint8_t data[4 * sizeof(TestStruct)];
+		TestStruct t1 = {1, 2, 3.0};
+		TestStruct *slot;
+		const TestStruct *peeked;
+		uint16_t size;
+		int i;
+
+		CB_Init(&b, data, sizeof(data));
+		assert(!CB_PeekContiguous(&b, &size));
+		assert(size == 0);
+		assert(CB_Consume(&b, 1) == STANDARD_ERROR);
+
+		// Fill the buffer in place. Nothing is added until it's committed.
+		for (i = 0; i < 4; ++i) {
+			slot = CB_Reserve(&b, sizeof(TestStruct));
+			assert(slot == (TestStruct*)&data[i * sizeof(TestStruct)]);
+			assert(b.dataSize == i * sizeof(TestStruct));
+			*slot = t1;
+			slot->hey = i;
+			assert(CB_Commit(&b, sizeof(TestStruct)));
+		}
+		assert(!CB_Reserve(&b, 1));
+		assert(CB_Commit(&b, 1) == STANDARD_ERROR);
+		assert(b.writeIndex == 0);
+
+		// Read it back in place. All of it is contiguous.
+		peeked = CB_PeekContiguous(&b, &size);
+		assert(peeked == (const TestStruct*)data);
+		assert(size == sizeof(data));
+		for (i = 0; i < 4; ++i) {
+			assert(peeked[i].hey == i && peeked[i].foo == 2);
+		}
+		assert(CB_Consume(&b, 3 * sizeof(TestStruct)));
+		assert(b.dataSize == sizeof(TestStruct));
+
+		// Now write data that wraps around the end and read it back in two parts.
+		CB_WriteMany(&b, "abcdefgh", 8, true);
+		peeked = CB_PeekContiguous(&b, &size);
+		assert(size == sizeof(TestStruct));
+		assert(peeked->hey == 3);
+		assert(CB_Consume(&b, size));
+		assert(CB_PeekContiguous(&b, &size) == data);
+		assert(size == 8);
+		assert(memcmp(data, "abcdefgh", 8) == 0);
+		assert(CB_Consume(&b, 9) == STANDARD_ERROR);
+		assert(CB_Consume(&b, 8));
+		assert(b.dataSize == 0);
+		assert(b.readIndex == b.writeIndex);
+
+		// A reservation that would wrap fails even though there is enough free space.
+		assert(!CB_Reserve(&b, sizeof(data) - 4));
+		assert(CB_Reserve(&b, sizeof(data) - 8));
+	}
+
+	// Test the usage statistics.
+	{
+		CircularBuffer b;
+		uint8_t data[16];
+		CircularBufferStats stats;
+
+		CB_Init(&b, data, sizeof(data));
+#ifdef CB_STATS
+		uint8_t out[16];
+		int i;
+
+		assert(CB_GetStats(&b, &stats));
+		assert(stats.bytesWritten == 0 && stats.bytesRead == 0 && stats.peakSize == 0);
+
+		// Every write and read path is counted.
+		assert(CB_WriteByte(&b, 1));
+		assert(CB_WriteMany(&b, "abcdefghij", 10, true));
+		assert(CB_ReadByte(&b, out));
+		assert(CB_ReadMany(&b, out, 4));
+		assert(CB_Remove(&b, 2));
+		assert(CB_Commit(&b, 3));
+		assert(CB_Consume(&b, 1));
+		assert(CB_GetStats(&b, &stats));
+		assert(stats.bytesWritten == 14);
+		assert(stats.bytesRead == 8);
+		assert(stats.peakSize == 11);
+		assert(stats.overflows == 0 && stats.bytesLost == 0);
+
+		// Fill it up. A partial write only loses the rest. A failed early write isn't an overflow,
+		// just as it isn't counted in overflowCount.
+		assert(b.dataSize == 6);
+		assert(!CB_WriteMany(&b, out, 11, true));
+		assert(!CB_WriteMany(&b, out, 12, false));
+		assert(!CB_WriteByte(&b, 0));
+		assert(CB_GetStats(&b, &stats));
+		assert(stats.bytesWritten == 24);
+		assert(stats.peakSize == 16);
+		assert(stats.overflows == 2);
+		assert(stats.bytesLost == 2 + 1);
+		assert(b.overflowCount == 2 + 1);
+
+		// Removing more than is stored only counts what was there.
+		assert(CB_Remove(&b, 20));
+		assert(CB_GetStats(&b, &stats));
+		assert(stats.bytesRead == 24);
+
+		// Resetting keeps the peak at what the buffer holds now.
+		assert(CB_WriteMany(&b, "abc", 3, true));
+		CB_ResetStats(&b);
+		assert(CB_GetStats(&b, &stats));
+		assert(stats.bytesWritten == 0 && stats.bytesRead == 0 && stats.overflows == 0 && stats.bytesLost == 0);
+		assert(stats.peakSize == 3);
+
+		// Overflows don't wrap around like overflowCount does.
+		for (i = 0; i < 300; ++i) {
+			CB_WriteMany(&b, out, 16, false);
+		}
+		assert(CB_GetStats(&b, &stats));
+		assert(stats.bytesLost == 300 * 16 - 13);
+		assert(b.overflowCount == (uint8_t)(2 + 1 + 300 * 16 - 13));
+#else
+		assert(!CB_GetStats(&b, &stats));
+#endif
+	}
+
 	printf("All tests passed.\n");
 
 	return 0;
@@ -25,14 +25,33 @@
  * This circular buffer provides a single buffer interface for almost any situation necessary. It
  * has been written for use with the dsPIC33f, but has been tested on x86.
  *
+ * Defining CB_STATS adds 32-bit usage statistics to every buffer, read with CB_GetStats(). As it
+ * changes the size of the CircularBuffer struct, it must be defined for every file that includes
+ * this header, so it's best passed on the compiler command line.
+ *
  * Unit testing has been completed on x86 by compiling with the UNIT_TEST_CIRCULAR_BUFFER macro.
  * With gcc: `gcc CircularBuffer.c -DUNIT_TEST_CIRCULAR_BUFFER`
+ * Add -DCB_STATS to test the statistics as well.
  */
 #ifndef _CIRCULAR_BUFFER_H_
 #define _CIRCULAR_BUFFER_H_
 
 #include "Common.h"
 
+/**
+ * @brief Usage statistics kept for a buffer when CB_STATS is defined.
+ *
+ * Unlike overflowCount these don't wrap around until 2^32, so they can be left running for long
+ * enough to see how close a buffer really comes to overflowing.
+ */
+typedef struct {
+	uint32_t bytesWritten; //!< The number of bytes written into the buffer.
+	uint32_t bytesRead;    //!< The number of bytes read or removed from the buffer.
+	uint32_t overflows;    //!< The number of writes that lost data because the buffer was full.
+	uint32_t bytesLost;    //!< The number of bytes those writes lost.
+	uint16_t peakSize;     //!< The most unread bytes the buffer has held at once.
+} CircularBufferStats;
+
 /**
  * @brief A structure which holds information about the circular buffer.
  *
@@ -49,6 +68,9 @@ typedef struct {
 	uint16_t dataSize;     //!< The actual number of unread bytes in the buffer.
 	uint8_t overflowCount; //!< Tracks how many bytes have been attempted to be written while the buffer was full.
 	uint8_t *data;         //!< A pointer to the actual data managed by this buffer.
+#ifdef CB_STATS
+	CircularBufferStats stats; //!< Usage statistics. Read them with CB_GetStats().
+#endif
 } CircularBuffer;
 
 /**
@@ -217,5 +239,102 @@ int CB_PeekMany(const CircularBuffer *b, void *outData, uint16_t size);
  */
 int CB_Remove(CircularBuffer *b, uint16_t size); 
 
+/**
+ * @brief CB_Reserve() returns a pointer to free space in the buffer for writing in place.
+ *
+ * Together with CB_Commit() this lets a producer build data directly inside the buffer instead of
+ * building it elsewhere and copying it in with CB_WriteMany(). The returned space starts at the
+ * current write position and is `size` contiguous bytes long. Nothing is added to the buffer until
+ * CB_Commit() is called, so the reservation can simply be abandoned.
+ *
+ * NULL is returned if b is NULL, if there isn't `size` bytes of free space, or if the free space
+ * wraps around the end of the buffer before `size` bytes. When the buffer only ever holds records
+ * of one size and its size is a multiple of that, a reservation never wraps.
+ *
+ * Example use with a struct:
+ * ```
+ * TestStruct *t = CB_Reserve(&b, sizeof(TestStruct));
+ * if (t) {
+ *   t->foo = 7;
+ *   CB_Commit(&b, sizeof(TestStruct));
+ * }
+ * ```
+ *
+ * @see CB_Commit()
+ *
+ * @param b A pointer to the CircularBuffer struct.
+ * @param size The number of bytes to reserve.
+ */
+void *CB_Reserve(CircularBuffer *b, uint16_t size);
+
+/**
+ * @brief CB_Commit() adds data written in place after CB_Reserve() to the buffer.
+ *
+ * Returns STANDARD_ERROR, adding nothing, if there isn't `size` bytes of free space.
+ *
+ * @see CB_Reserve()
+ *
+ * @param b A pointer to the CircularBuffer struct.
+ * @param size The number of bytes to add. This should match the preceding CB_Reserve().
+ */
+int CB_Commit(CircularBuffer *b, uint16_t size);
+
+/**
+ * @brief CB_PeekContiguous() returns a pointer to the oldest data in the buffer for reading in place.
+ *
+ * This is the consumer-side counterpart to CB_Reserve(). Rather than copying data out like
+ * CB_PeekMany(), the data is read where it sits and released with CB_Consume() afterwards. Since
+ * the stored data may wrap around the end of the buffer, `size` is set to the number of bytes that
+ * can be read contiguously from the returned pointer. Once those have been consumed, another call
+ * returns the rest.
+ *
+ * Returns NULL and sets `size` to 0 if b is NULL or empty.
+ *
+ * @see CB_Consume()
+ *
+ * @param b A pointer to the CircularBuffer struct.
+ * @param size Where the number of contiguous bytes is stored. May be NULL.
+ */
+const void *CB_PeekContiguous(const CircularBuffer *b, uint16_t *size);
+
+/**
+ * @brief CB_Consume() removes data that was read in place with CB_PeekContiguous().
+ *
+ * Unlike CB_Remove() this doesn't empty the buffer when asked to remove more data than it holds.
+ * Instead nothing is removed and STANDARD_ERROR is returned.
+ *
+ * @see CB_PeekContiguous()
+ *
+ * @param b A pointer to the CircularBuffer struct.
+ * @param size The number of bytes to remove.
+ */
+int CB_Consume(CircularBuffer *b, uint16_t size);
+
+/**
+ * @brief CB_GetStats() copies the buffer's usage statistics.
+ *
+ * The statistics cover everything since CB_Init() or CB_ResetStats(). A write that runs into a
+ * full buffer counts as an overflow, and the bytes it didn't write are lost, as in overflowCount.
+ * A CB_WriteMany() with `failEarly` set that's refused for lack of room writes nothing and isn't
+ * counted.
+ *
+ * Returns STANDARD_ERROR, leaving `stats` unchanged, if b is NULL or CB_STATS isn't defined.
+ * Otherwise SUCCESS is returned.
+ *
+ * @param b A pointer to the CircularBuffer struct.
+ * @param stats Where the statistics are stored.
+ */
+int CB_GetStats(const CircularBuffer *b, CircularBufferStats *stats);
+
+/**
+ * @brief CB_ResetStats() starts the buffer's usage statistics over.
+ *
+ * The peak size starts again from the number of bytes currently in the buffer. Does nothing if b is
+ * NULL or CB_STATS isn't defined.
+ *
+ * @param b A pointer to the CircularBuffer struct.
+ */
+void CB_ResetStats(CircularBuffer *b);
+
 
 #endif /* _CIRCULAR_BUFFER_H_ */
@@ -30,6 +30,10 @@
 // The standard boolean values of 'true' and 'false' are included through the stdbool.h library.
 #include <stdbool.h>
 
+// Prevents the compiler from moving memory accesses across this point. Used by the buffers to make
+// sure data is in place before it is published to an interrupt handler or the main loop.
+#define MEMORY_BARRIER() __asm__ __volatile__("" ::: "memory")
+
 // Error codes for use as fucntion return values.
 enum {
     SIZE_ERROR = -1,        // Return value for an error when used with an output that is normally >= 0.
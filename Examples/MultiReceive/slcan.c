@@ -0,0 +1,283 @@
+#include "slcan.h"
+#include "uart2.h"
+#include "ecanFunctions.h"
+
+// The longest reply to a command, "V0100\r".
+#define SLCAN_MAX_REPLY 6
+
+// The states of the channel.
+enum {
+    SLCAN_CLOSED = 0,
+    SLCAN_OPEN,
+    SLCAN_LISTEN
+};
+
+static const char hexDigits[] = "0123456789ABCDEF";
+
+static unsigned char channel;
+
+// The command being received. Once a command overruns the line it's discarded
+// up to its carriage return.
+static char rxLine[SLCAN_MAX_LINE];
+static unsigned char rxLength;
+static bool rxOverrun;
+
+/**
+ * Returns how many more bytes uart2TxBuffer can take.
+ */
+static uint16_t slcanTxSpace(void)
+{
+    return uart2TxBuffer.mask + 1 - MB_GetLength(&uart2TxBuffer);
+}
+
+/**
+ * Queues a reply or line for transmission. The caller must have checked that
+ * it fits, so that lines are never cut short.
+ */
+static void slcanSend(const char *text, unsigned char length)
+{
+    uart2EnqueueData((unsigned char *) text, length);
+}
+
+/**
+ * Writes `digits` hexadecimal digits of `value`, most significant first.
+ */
+static void slcanPutHex(char *text, uint32_t value, unsigned char digits)
+{
+    while (digits--) {
+        text[digits] = hexDigits[value & 0xF];
+        value >>= 4;
+    }
+}
+
+/**
+ * Reads `digits` hexadecimal digits. Returns false if any isn't one.
+ */
+static bool slcanGetHex(const char *text, unsigned char digits, uint32_t *value)
+{
+    uint32_t result = 0;
+    char c;
+
+    while (digits--) {
+        c = *text++;
+        if (c >= '0' && c <= '9') {
+            c -= '0';
+        } else if (c >= 'A' && c <= 'F') {
+            c -= 'A' - 10;
+        } else if (c >= 'a' && c <= 'f') {
+            c -= 'a' - 10;
+        } else {
+            return false;
+        }
+        result = (result << 4) | (uint8_t) c;
+    }
+    *value = result;
+    return true;
+}
+
+unsigned char slcanEncode(const tCanMessage *msg, char *line)
+{
+    bool extended = (msg->frame_type == CAN_FRAME_EXT);
+    bool remote = (msg->message_type == CAN_MSG_RTR);
+    unsigned char bytes = msg->validBytes > 8 ? 8 : msg->validBytes;
+    unsigned char length;
+    unsigned char i;
+
+    if (extended) {
+        line[0] = remote ? 'R' : 'T';
+        slcanPutHex(&line[1], msg->id, 8);
+        length = 9;
+    } else {
+        line[0] = remote ? 'r' : 't';
+        slcanPutHex(&line[1], msg->id, 3);
+        length = 4;
+    }
+    line[length++] = '0' + bytes;
+    if (!remote) {
+        for (i = 0; i < bytes; ++i) {
+            line[length++] = hexDigits[msg->payload[i] >> 4];
+            line[length++] = hexDigits[msg->payload[i] & 0xF];
+        }
+    }
+    line[length++] = '\r';
+    return length;
+}
+
+int slcanDecode(const char *line, unsigned char length, tCanMessage *msg)
+{
+    unsigned char idDigits;
+    uint32_t value;
+    unsigned char i;
+
+    switch (line[0]) {
+    case 't':
+    case 'r':
+        msg->frame_type = CAN_FRAME_STD;
+        idDigits = 3;
+        break;
+    case 'T':
+    case 'R':
+        msg->frame_type = CAN_FRAME_EXT;
+        idDigits = 8;
+        break;
+    default:
+        return STANDARD_ERROR;
+    }
+    msg->message_type = (line[0] == 'r' || line[0] == 'R') ? CAN_MSG_RTR : CAN_MSG_DATA;
+    msg->buffer = 0;
+
+    // The identifier and the length must be there before the length can be
+    // checked against the data.
+    if (length < 2 + idDigits || !slcanGetHex(&line[1], idDigits, &msg->id) ||
+        msg->id > (idDigits == 3 ? 0x7FFUL : 0x1FFFFFFFUL)) {
+        return STANDARD_ERROR;
+    }
+    if (!slcanGetHex(&line[1 + idDigits], 1, &value) || value > 8) {
+        return STANDARD_ERROR;
+    }
+    msg->validBytes = (uint8_t) value;
+    if (length != 2 + idDigits + (msg->message_type == CAN_MSG_RTR ? 0 : 2 * msg->validBytes)) {
+        return STANDARD_ERROR;
+    }
+
+    for (i = 0; i < 8; ++i) {
+        msg->payload[i] = 0;
+    }
+    if (msg->message_type == CAN_MSG_DATA) {
+        for (i = 0; i < msg->validBytes; ++i) {
+            if (!slcanGetHex(&line[2 + idDigits + 2 * i], 2, &value)) {
+                return STANDARD_ERROR;
+            }
+            msg->payload[i] = (uint8_t) value;
+        }
+    }
+    return SUCCESS;
+}
+
+/**
+ * Executes a command, without its carriage return, and queues the reply.
+ */
+static void slcanExecute(const char *line, unsigned char length)
+{
+    char reply[SLCAN_MAX_REPLY];
+    uint8_t errors[2];
+    uint8_t state;
+    tCanMessage msg;
+
+    if (!length) {
+        slcanSend("\r", 1);
+        return;
+    }
+
+    switch (line[0]) {
+    case 'O':
+    case 'L':
+        if (length == 1 && channel == SLCAN_CLOSED) {
+            channel = (line[0] == 'O') ? SLCAN_OPEN : SLCAN_LISTEN;
+            slcanSend("\r", 1);
+            return;
+        }
+        break;
+    case 'C':
+        if (length == 1) {
+            channel = SLCAN_CLOSED;
+            slcanSend("\r", 1);
+            return;
+        }
+        break;
+    case 'S':
+        if (length == 2 && line[1] >= '0' && line[1] <= '8' && channel == SLCAN_CLOSED) {
+            slcanSend("\r", 1);
+            return;
+        }
+        break;
+    case 'V':
+        if (length == 1) {
+            slcanSend("V0100\r", 6);
+            return;
+        }
+        break;
+    case 'N':
+        if (length == 1) {
+            slcanSend("N0000\r", 6);
+            return;
+        }
+        break;
+    case 'F':
+        if (length == 1) {
+            ecan1_error_status_matlab(errors);
+            state = errors[0] > errors[1] ? errors[0] : errors[1];
+            reply[0] = 'F';
+            slcanPutHex(&reply[1], (state >= 1 ? 0x04 : 0) | (state >= 2 ? 0x20 : 0), 2);
+            reply[3] = '\r';
+            slcanSend(reply, 4);
+            return;
+        }
+        break;
+    case 't':
+    case 'T':
+    case 'r':
+    case 'R':
+        if (channel == SLCAN_OPEN && slcanDecode(line, length, &msg) &&
+            ecan1_buffered_transmit_many(&msg, 1)) {
+            slcanSend(msg.frame_type == CAN_FRAME_EXT ? "Z\r" : "z\r", 2);
+            return;
+        }
+        break;
+    }
+    slcanSend("\a", 1);
+}
+
+void slcanInit(void)
+{
+    channel = SLCAN_CLOSED;
+    rxLength = 0;
+    rxOverrun = false;
+}
+
+void slcanStep(void)
+{
+    char lines[4 * SLCAN_MAX_LINE];
+    unsigned char length;
+    uint16_t space;
+    tCanMessage msg;
+    unsigned char messagesLeft;
+    unsigned char c;
+
+    // Execute the commands that have arrived, as long as there's room for
+    // their replies.
+    while (slcanTxSpace() >= SLCAN_MAX_REPLY && MB_ReadByte(&uart2RxBuffer, &c)) {
+        if (c == '\r') {
+            if (rxOverrun) {
+                slcanSend("\a", 1);
+            } else {
+                slcanExecute(rxLine, rxLength);
+            }
+            rxLength = 0;
+            rxOverrun = false;
+        } else if (c == '\n') {
+            // Some hosts end their commands with CR LF.
+        } else if (rxLength < SLCAN_MAX_LINE) {
+            rxLine[rxLength++] = c;
+        } else {
+            rxOverrun = true;
+        }
+    }
+
+    // Then forward every received frame that fits, queueing the lines a
+    // batch at a time.
+    if (channel == SLCAN_CLOSED) {
+        return;
+    }
+    do {
+        length = 0;
+        space = slcanTxSpace();
+        while (length + SLCAN_MAX_LINE <= space && length + SLCAN_MAX_LINE <= (int) sizeof(lines) &&
+               ecan1_receive(&msg, &messagesLeft)) {
+            length += slcanEncode(&msg, &lines[length]);
+        }
+        if (length) {
+            slcanSend(lines, length);
+        }
+    } while (length + SLCAN_MAX_LINE > (int) sizeof(lines));
+}
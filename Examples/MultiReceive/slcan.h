@@ -0,0 +1,70 @@
+#ifndef _SLCAN_H_
+#define _SLCAN_H_
+
+// USAGE:
+// Call initUart2() and then slcanInit() once on startup, after ecan1_init().
+// Call slcanStep() periodically, every millisecond or so at 115200 baud.
+//
+// This turns the board into an SLCAN (Lawicel) adapter, so that slcand,
+// python-can and the like can use it as a CAN interface over UART2. While the
+// channel is open every frame received by ECAN1 is sent as a t, T, r or R
+// line, and frames sent by the host are queued with
+// ecan1_buffered_transmit_many(). The bridge takes every received frame, so
+// the model's own reception blocks will no longer see them.
+//
+// MultiReceive.mdl doesn't build or call this file, as the bridge would take
+// the frames its blocks display. To use it, add slcan.c to CustomSource in
+// the model's code generation settings and call slcanInit() and slcanStep()
+// from C function blocks, in place of the reception blocks. The bridge is
+// tested on the host by HostEmulator/ecanSlcanTest.c.
+//
+// Supported commands, each ended by a carriage return:
+//  O             Open the channel.
+//  L             Open the channel in listen-only mode, where frames can't be sent.
+//  C             Close the channel.
+//  S0-S8         Accepted for compatibility. The bit rate is set by ecan1_init().
+//  V, N          Report the version and serial number.
+//  F             Report the status flags: error warning (0x04) and error
+//                passive (0x20).
+//  tiiildd...    Send a standard data frame. Replies z.
+//  Tiiiiiiiildd  Send an extended data frame. Replies Z.
+//  riiil         Send a standard remote frame. Replies z.
+//  Riiiiiiiil    Send an extended remote frame. Replies Z.
+// Anything else, a malformed frame, or a full transmission queue, is answered
+// with a BEL (0x07) character.
+
+#include "Common.h"
+#include "ecanDefinitions.h"
+
+// The longest line in either direction: an extended data frame with 8 bytes,
+// including its carriage return.
+#define SLCAN_MAX_LINE 27
+
+/**
+ * Closes the channel and empties the command parser.
+ */
+void slcanInit(void);
+
+/**
+ * Executes every complete command waiting in uart2RxBuffer, then sends each
+ * received frame as a line while the channel is open. Neither step ever
+ * waits: a partial command is kept until the rest of it arrives, and when
+ * uart2TxBuffer can't take another line the rest are left for the next call.
+ */
+void slcanStep(void);
+
+/**
+ * Writes a frame as an SLCAN line ending in a carriage return, which is at
+ * most SLCAN_MAX_LINE characters long.
+ * @return The length of the line.
+ */
+unsigned char slcanEncode(const tCanMessage *msg, char *line);
+
+/**
+ * Parses a t, T, r or R line, without its carriage return, into a frame.
+ * Hexadecimal digits may be in either case.
+ * @return SUCCESS, or STANDARD_ERROR if the line is malformed.
+ */
+int slcanDecode(const char *line, unsigned char length, tCanMessage *msg);
+
+#endif /* _SLCAN_H_ */
@@ -0,0 +1,168 @@
+#include <string.h>
+#include "telemetry.h"
+#include "uart2.h"
+#include "ecanFunctions.h"
+
+#ifndef ECAN1_TRACE
+#error "The telemetry stream is read from the trace, so ECAN1_TRACE must be defined."
+#endif
+
+// CRC-16/CCITT-FALSE, four bits at a time.
+static const uint16_t crcTable[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+// The header bytes and IDs in the dictionary, each ID along with
+// CMB_PACKED_EXT.
+static unsigned char dictionaryHeader[TELEMETRY_DICTIONARY];
+static uint32_t dictionaryId[TELEMETRY_DICTIONARY];
+static unsigned char dictionaryUsed;
+static unsigned char dictionaryNext;
+
+static unsigned char sequence;
+static uint32_t lastStamp;
+
+// A record read from the trace that didn't fit into the last packet.
+static tEcan1TraceRecord pending;
+static bool hasPending;
+
+static uint16_t telemetryCrc(uint16_t crc, const unsigned char *data, unsigned char length)
+{
+    while (length--) {
+        crc ^= (uint16_t) *data++ << 8;
+        crc = (crc << 4) ^ crcTable[crc >> 12];
+        crc = (crc << 4) ^ crcTable[crc >> 12];
+    }
+    return crc;
+}
+
+/**
+ * Writes a record, returning its length. The dictionary and the last
+ * timestamp are left alone, and `slot` is set to the index in the dictionary
+ * of the record's header byte and ID, or TELEMETRY_DICTIONARY if they're not
+ * there.
+ */
+static unsigned char telemetryPutRecord(const tEcan1TraceRecord *record, unsigned char *out,
+                                        unsigned char *slot)
+{
+    uint32_t header = record->frame.header;
+    uint32_t id = header & (CMB_PACKED_ID | CMB_PACKED_EXT);
+    uint32_t delta = (record->stamp - lastStamp) & ECAN1_TRACE_TIME_MASK;
+    unsigned char bytes = (header & CMB_PACKED_FULL) ? 8 : record->frame.payload[7];
+    unsigned char length = 1;
+    unsigned char i;
+
+    if (bytes > 8) {
+        bytes = 8;
+    }
+    out[0] = bytes;
+    if (record->stamp & ECAN1_TRACE_TX) {
+        out[0] |= TELEMETRY_TX;
+    }
+    if (header & CMB_PACKED_RTR) {
+        out[0] |= TELEMETRY_RTR;
+    }
+    if (header & CMB_PACKED_EXT) {
+        out[0] |= TELEMETRY_EXT;
+    }
+
+    for (*slot = 0; *slot < dictionaryUsed; ++*slot) {
+        if (dictionaryHeader[*slot] == out[0] && dictionaryId[*slot] == id) {
+            break;
+        }
+    }
+    if (*slot < dictionaryUsed) {
+        out[0] = TELEMETRY_INDEX | *slot;
+    } else {
+        *slot = TELEMETRY_DICTIONARY;
+    }
+
+    while (delta >= 0x80) {
+        out[length++] = (unsigned char) delta | 0x80;
+        delta >>= 7;
+    }
+    out[length++] = (unsigned char) delta;
+
+    if (*slot == TELEMETRY_DICTIONARY) {
+        out[length++] = (unsigned char) header;
+        out[length++] = (unsigned char) (header >> 8);
+        if (header & CMB_PACKED_EXT) {
+            out[length++] = (unsigned char) (header >> 16);
+            out[length++] = (unsigned char) (header >> 24) & 0x1F;
+        }
+    }
+
+    if (!(header & CMB_PACKED_RTR)) {
+        for (i = 0; i < bytes; ++i) {
+            out[length++] = record->frame.payload[i];
+        }
+    }
+    return length;
+}
+
+void telemetryInit(void)
+{
+    sequence = 0;
+    dictionaryUsed = 0;
+    dictionaryNext = 0;
+    hasPending = false;
+}
+
+void telemetryStep(void)
+{
+    unsigned char packet[TELEMETRY_MAX_PACKET];
+    unsigned char record[TELEMETRY_MAX_RECORD];
+    unsigned char length;
+    unsigned char recordLength;
+    unsigned char slot;
+    uint16_t crc;
+
+    while (uart2TxBuffer.mask + 1 - MB_GetLength(&uart2TxBuffer) >= TELEMETRY_MAX_PACKET) {
+        if (!hasPending) {
+            if (!ecan1_trace_read(&pending, 1)) {
+                return;
+            }
+            hasPending = true;
+        }
+
+        // A key packet starts from an empty dictionary and a zero timestamp.
+        packet[0] = TELEMETRY_SYNC0;
+        packet[1] = TELEMETRY_SYNC1;
+        packet[3] = sequence;
+        if (!(sequence % TELEMETRY_KEY_INTERVAL)) {
+            packet[3] |= TELEMETRY_KEY;
+            dictionaryUsed = 0;
+            dictionaryNext = 0;
+            lastStamp = 0;
+        }
+        sequence = (sequence + 1) & TELEMETRY_SEQUENCE;
+
+        // Fill the body, holding back the first record that doesn't fit.
+        length = 4;
+        while (hasPending) {
+            recordLength = telemetryPutRecord(&pending, record, &slot);
+            if (length - 4 + recordLength > TELEMETRY_MAX_BODY) {
+                break;
+            }
+            memcpy(&packet[length], record, recordLength);
+            length += recordLength;
+            lastStamp = pending.stamp;
+            if (slot == TELEMETRY_DICTIONARY) {
+                dictionaryHeader[dictionaryNext] = record[0];
+                dictionaryId[dictionaryNext] = pending.frame.header & (CMB_PACKED_ID | CMB_PACKED_EXT);
+                dictionaryNext = (dictionaryNext + 1) % TELEMETRY_DICTIONARY;
+                if (dictionaryUsed < TELEMETRY_DICTIONARY) {
+                    ++dictionaryUsed;
+                }
+            }
+            hasPending = ecan1_trace_read(&pending, 1) != 0;
+        }
+
+        packet[2] = length - 4;
+        crc = telemetryCrc(0xFFFF, &packet[2], length - 2);
+        packet[length++] = (unsigned char) crc;
+        packet[length++] = (unsigned char) (crc >> 8);
+        uart2EnqueueData(packet, length);
+    }
+}
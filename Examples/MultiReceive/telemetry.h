@@ -0,0 +1,88 @@
+#ifndef _TELEMETRY_H_
+#define _TELEMETRY_H_
+
+// USAGE:
+// Build with ECAN1_TRACE defined. Call initUart2() and then telemetryInit()
+// once on startup, after ecan1_init(). Call telemetryStep() periodically,
+// every millisecond or so.
+//
+// This mirrors the bus to a PC over UART2 in a compact binary form, decoded by
+// HostEmulator/ecanTelemetryDecode.c. Frames are taken from the trace, so both
+// received and transmitted frames are sent with their timestamps, and the
+// model's own reception blocks still see every frame. When the link can't
+// keep up, the trace overwrites its oldest records and those frames are lost.
+//
+// MultiReceive.mdl doesn't build or call this file, as it would need
+// ECAN1_TRACE and the UART2 is already used for the model's own text output.
+// To use it, add telemetry.c to CustomSource and -DECAN1_TRACE to the compiler
+// options in the model's code generation settings, and call telemetryInit()
+// and telemetryStep() from C function blocks in place of the blocks that
+// write to UART2. The stream is tested on the host by
+// HostEmulator/ecanTelemetryTest.c.
+//
+// The stream is a series of packets:
+//  0xA5 0x5A      Sync bytes.
+//  length         The number of body bytes, at most TELEMETRY_MAX_BODY.
+//  sequence       A 7-bit packet counter, with TELEMETRY_KEY set on key packets.
+//  body           One or more records.
+//  crc            CRC-16/CCITT-FALSE of the length, sequence and body, low byte first.
+// Each record is:
+//  header         TELEMETRY_TX, TELEMETRY_RTR, TELEMETRY_EXT and the number of
+//                 data bytes, or TELEMETRY_INDEX and an index into the
+//                 dictionary.
+//  delta          The ticks since the previous record as a varint: 7 bits per
+//                 byte, least significant first, with bit 7 set on every byte
+//                 but the last. The first record of a key packet holds the
+//                 timestamp itself instead.
+//  id             Only without TELEMETRY_INDEX: the ID, 2 bytes for standard
+//                 frames and 4 for extended ones, little-endian. The header
+//                 byte and ID are then stored into the next dictionary slot in
+//                 turn, and later records with the same ones just give its
+//                 index.
+//  data           The data bytes, except for remote frames.
+// Key packets empty the dictionary first, so a decoder that loses a packet
+// can start again from the next one. They're sent every
+// TELEMETRY_KEY_INTERVAL packets.
+
+#include "Common.h"
+
+// The sync bytes starting every packet.
+#define TELEMETRY_SYNC0 0xA5
+#define TELEMETRY_SYNC1 0x5A
+
+// The fields of a packet's sequence byte.
+#define TELEMETRY_KEY      0x80
+#define TELEMETRY_SEQUENCE 0x7F
+
+// The fields of a record's header byte.
+#define TELEMETRY_INDEX  0x80 // The rest of the byte is a dictionary index.
+#define TELEMETRY_TX     0x40 // The frame was transmitted rather than received.
+#define TELEMETRY_RTR    0x20 // The frame is a remote transmit request.
+#define TELEMETRY_EXT    0x10 // The frame is extended.
+#define TELEMETRY_LENGTH 0x0F // The number of data bytes, 0 to 8.
+
+// The number of entries in the dictionary, at most 128.
+#define TELEMETRY_DICTIONARY 32
+
+// Every this many packets is a key packet. Must divide 128.
+#define TELEMETRY_KEY_INTERVAL 16
+
+// The sizes of the parts of the stream. A body holds at least one record and
+// a packet fits into uart2TxBuffer with room to spare.
+#define TELEMETRY_MAX_RECORD 18
+#define TELEMETRY_MAX_BODY   58
+#define TELEMETRY_OVERHEAD   6
+#define TELEMETRY_MAX_PACKET (TELEMETRY_MAX_BODY + TELEMETRY_OVERHEAD)
+
+/**
+ * Empties the dictionary, so the next packet is a key packet.
+ */
+void telemetryInit(void);
+
+/**
+ * Sends the frames waiting in the trace, a packet at a time, as long as
+ * uart2TxBuffer has room for another whole packet. Never waits.
+ */
+void telemetryStep(void);
+
+#endif /* _TELEMETRY_H_ */
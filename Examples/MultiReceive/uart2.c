@@ -1,14 +1,25 @@
-#include "CircularBuffer.h"
+#include "MaskedBuffer.h"
 #include "uart2.h"
-#include <p33Fxxxx.h>
+#include "ecanFunctions.h"
+#include <p33fxxxx.h>
 
-//Number of 8-byte CAN messages buffer supports
-#define ARRAYSIZE 8 * 12
+// Number of bytes each buffer holds. Must be a power of two.
+#define ARRAYSIZE 128
 
-CircularBuffer uart2RxBuffer;
+// The DMA channel that feeds U2TXREG, which the DMA1 registers and interrupt
+// below must match. The ECAN blocks in this example use channels 0 and 2.
+#define UART2_TX_DMA_CHANNEL 1
+
+// The UART2 transmitter IRQ, which requests each DMA transfer.
+#define UART2_TX_IRQ 0x1F
+
+MaskedBuffer uart2RxBuffer;
 uint8_t rxDataArray[ARRAYSIZE];
-CircularBuffer uart2TxBuffer;
-uint8_t txDataArray[ARRAYSIZE];
+MaskedBuffer uart2TxBuffer;
+uint8_t txDataArray[ARRAYSIZE] __attribute__((space(dma)));
+
+// The number of bytes the DMA channel is sending, or 0 if it's idle.
+static volatile uint16_t txSegment;
 
 /*
  * Private functions.
@@ -25,10 +36,10 @@ void startUart2Transmission();
 void initUart2(unsigned int brgRegister)
 {
     // Initialize our circular buffers. If this fails, we crash and burn.
-    if (!CB_Init(&uart2RxBuffer, rxDataArray, ARRAYSIZE)) {
+    if (!MB_INIT(&uart2RxBuffer, rxDataArray)) {
         while (1);
     }
-    if (!CB_Init(&uart2TxBuffer, txDataArray, ARRAYSIZE)) {
+    if (!MB_INIT(&uart2TxBuffer, txDataArray)) {
         while (1);
     }
 
@@ -58,8 +69,12 @@ void initUart2(unsigned int brgRegister)
     // Finally setup interrupts for proper UART communication.
     IPC7bits.U2TXIP = 6; // Interrupt priority 6
     IPC7bits.U2RXIP = 6; // Interrupt priority 6
-    IEC1bits.U2TXIE = 1; // Enable transmission interrupt
+    IEC1bits.U2TXIE = 0; // Transmission is fed by DMA, which interrupts instead
     IEC1bits.U2RXIE = 1; // Enable reception interrupt
+    IPC3bits.DMA1IP = 6; // Interrupt priority 6
+    IFS0bits.DMA1IF = 0;
+    IEC0bits.DMA1IE = 1; // Interrupt at the end of every segment
+    txSegment = 0;
 
     // Enable the port;
     U2MODEbits.UARTEN = 1; // Enable the port
@@ -84,22 +99,63 @@ void changeUart2BaudRate(unsigned short brgRegister)
 }
 
 /**
- * This function actually initiates transmission. It
- * attempts to start transmission with the first element
- * in the queue if transmission isn't already proceeding.
- * Once transmission starts the interrupt handler will
- * keep things moving from there. The buffer is checked
- * for new data and the transmission buffer is checked that
- * it has room for new data before attempting to transmit.
+ * Hands the oldest contiguous run of queued bytes to the DMA channel, which
+ * writes them to U2TXREG one at a time as the transmitter asks for them. The
+ * bytes stay in the queue until the DMA interrupt handler removes them at the
+ * end of the segment, and then starts the next one. Must only be called while
+ * the DMA channel is idle and its interrupt can't run.
+ */
+static void startUart2Segment(void)
+{
+    uint16_t size;
+    const uint8_t *segment = MB_PeekContiguous(&uart2TxBuffer, &size);
+    uint16_t dmaParameters[6];
+    bool fifoFull;
+
+    if (!segment) {
+        return;
+    }
+    txSegment = size;
+
+    // Whether the transmitter will ask for another byte is decided before the
+    // channel is enabled: a byte it asks for after that is transferred by the
+    // channel, so it mustn't be forced in as well.
+    fifoFull = U2STAbits.UTXBF;
+
+    // Bytes from DPSRAM to the peripheral, incrementing through the
+    // segment, in one-shot mode so the channel stops at its end.
+    dmaParameters[0] = (UART2_TX_IRQ << 8) | 0x00C1;
+    dmaParameters[1] = (uint16_t) & U2TXREG;
+    dmaParameters[2] = size - 1;
+    dmaParameters[3] = __builtin_dmaoffset(txDataArray) + (uint16_t) (segment - txDataArray);
+    dmaParameters[4] = UART2_TX_DMA_CHANNEL;
+    dmaParameters[5] = 0;
+    dma_init(dmaParameters);
+
+    // The transmitter only requests a byte as one moves out of its FIFO. While
+    // the FIFO is full that's still to come, but otherwise the transmitter may
+    // already be idle, so the first transfer is forced. Forcing it into a full
+    // FIFO would lose the byte.
+    if (!fifoFull) {
+        DMA1REQbits.FORCE = 1;
+    }
+}
+
+/**
+ * This function actually initiates transmission. It starts a DMA segment with
+ * the queued data if transmission isn't already proceeding. Once transmission
+ * starts the DMA interrupt handler will keep things moving from there.
  */
 void startUart2Transmission()
 {
-    if (uart2TxBuffer.dataSize > 0 && !U2STAbits.UTXBF) {
-        // A temporary variable is used here because writing directly into U2TXREG causes some weird issues.
-        unsigned char c;
-        CB_ReadByte(&uart2TxBuffer, &c);
-        U2TXREG = c;
+    // Hold off the DMA interrupt so it can't start a segment at the same time.
+    uint16_t interruptEnabled = IEC0bits.DMA1IE;
+
+    IEC0bits.DMA1IE = 0;
+    if (!txSegment) {
+        startUart2Segment();
     }
+    IEC0bits.DMA1IE = interruptEnabled;
 }
 
 /**
@@ -108,7 +164,7 @@ void startUart2Transmission()
  */
 void uart2EnqueueByte(unsigned char datum)
 {
-    CB_WriteByte(&uart2TxBuffer, datum);
+    MB_WriteByte(&uart2TxBuffer, datum);
     startUart2Transmission();
 }
 
@@ -118,11 +174,8 @@ void uart2EnqueueByte(unsigned char datum)
  */
 void uart2EnqueueData(unsigned char *data, unsigned char length)
 {
-    unsigned char g;
-
-    for (g = 0; g < length; g++) {
-        CB_WriteByte(&uart2TxBuffer, data[g]);
-    }
+    // As much as fits is queued in one go.
+    MB_WriteMany(&uart2TxBuffer, data, length, false);
 
     startUart2Transmission();
 }
@@ -132,7 +185,7 @@ void __attribute__((__interrupt__, no_auto_psv)) _U2RXInterrupt(void)
 
     // Keep receiving new bytes while the buffer has data.
     while (U2STAbits.URXDA == 1) {
-        CB_WriteByte(&uart2RxBuffer, (unsigned char) U2RXREG);
+        MB_WriteByte(&uart2RxBuffer, (unsigned char) U2RXREG);
     }
 
     // Clear buffer overflow bit if triggered
@@ -145,16 +198,17 @@ void __attribute__((__interrupt__, no_auto_psv)) _U2RXInterrupt(void)
 }
 
 /**
- * This is the interrupt handler for UART2 transmission.
- * It is called after at least one byte is transmitted (
- * depends on UTXISEL<1:0> as to specifics). This function
- * therefore keeps adding bytes to transmit if there're more
- * in the queue.
+ * This is the interrupt handler for the UART2 transmission DMA channel.
+ * It is called once the last byte of a segment has been handed to the
+ * transmitter. This function therefore removes the segment from the queue
+ * and starts the next one if there're more bytes in the queue.
  */
-void __attribute__((__interrupt__, no_auto_psv)) _U2TXInterrupt(void)
+void __attribute__((__interrupt__, no_auto_psv)) _DMA1Interrupt(void)
 {
-    startUart2Transmission();
-
     // Clear the interrupt flag
-    IFS1bits.U2TXIF = 0;
+    IFS0bits.DMA1IF = 0;
+
+    MB_Consume(&uart2TxBuffer, txSegment);
+    txSegment = 0;
+    startUart2Segment();
 }
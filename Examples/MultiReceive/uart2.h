@@ -4,11 +4,12 @@
 // USAGE:
 // Add initUart2() to an initialization sequence called once on startup.
 // Use uart2Enqueue*Data() to push appropriately-sized data chunks into the queue and begin transmission.
+// Queued bytes are sent by DMA channel 1, which must not be used for anything else.
 
-#include "CircularBuffer.h"
+#include "MaskedBuffer.h"
 
-extern CircularBuffer uart2RxBuffer;
-extern CircularBuffer uart2TxBuffer;
+extern MaskedBuffer uart2RxBuffer;
+extern MaskedBuffer uart2TxBuffer;
 
 void initUart2(unsigned int brgRegister);
 void changeUart2BaudRate(unsigned short brgRegister);
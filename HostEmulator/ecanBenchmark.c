@@ -0,0 +1,1131 @@
+/**
+ * @file   ecanBenchmark.c
+ * @date   October, 2026
+ * @brief  Cycle and throughput benchmark of the ECAN1 driver running on the host emulator.
+ *
+ * Results are printed and also written to bench_output.txt in the current directory as one
+ * `name value unit` triple per line so that runs can be diffed against a baseline.
+ *
+ * To run from the repository root:
+ * ```
+ * $ gcc -O2 -I. -IHostEmulator -Wno-pointer-to-int-cast ecanFunctions.c CanMessageBuffer.c \
+ *       CanMessageHeap.c CanSignalDecoder.c CircularBuffer.c MaskedBuffer.c \
+ *       HostEmulator/ecanEmulator.c HostEmulator/ecanBenchmark.c -o ecanBenchmark
+ * $ ./ecanBenchmark
+ * ```
+ *
+ * Add -DECAN1_TX_PRIORITY to benchmark the driver with its transmission queue in priority order, or
+ * for example -DECAN1_DMA_BUFFERS=32 -DECAN1_FIFO_START=8 to receive through a 24-buffer FIFO. Add
+ * -DECAN1_RX_RAW to move decoding received frames out of the interrupt handler, -DECAN1_RX_FILTER
+ * to measure the software acceptance filter, and -DECAN1_MAILBOXES=8 to keep periodic frames out of
+ * the reception queue.
+ *
+ * The buffer suite at the end times every CircularBuffer, MaskedBuffer and CanMessageBuffer
+ * transfer path in nanoseconds per operation and bytes per second, so that buffer changes can be
+ * compared against a baseline on their own. An operation is one write and the read that takes the
+ * same data back out. Add -DCB_STATS to measure the cost of the buffer statistics.
+ */
+#include "ecanEmulator.h"
+#include "CanSignalDecoder.h"
+#include "CircularBuffer.h"
+#include "MaskedBuffer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// How many frames are pushed through each benchmark.
+#define BENCHMARK_FRAMES 1000000UL
+
+// How many frames are queued for transmission at once.
+#define BENCHMARK_TX_BURST 8
+
+// How many background frames are sent between each urgent frame in the latency benchmark.
+#define BENCHMARK_URGENT_PERIOD 37
+
+// How many frames are received at each interrupt latency in the overrun benchmark.
+#define BENCHMARK_OVERRUN_FRAMES 100000UL
+
+// How many frames arrive between each visit of the main loop in the reception queue benchmark.
+#define BENCHMARK_QUEUE_PERIOD 12
+
+// How many identifiers are wanted in the software filter benchmark.
+#define BENCHMARK_FILTER_IDS 48
+
+// How many times the software filter benchmark is repeated, keeping the fastest run, so that the
+// small difference it measures isn't lost in noise.
+#define BENCHMARK_FILTER_RUNS 5
+
+// How many periodic identifiers there are in the mailbox benchmark, and how many frames arrive
+// between each visit of the main loop.
+#define BENCHMARK_MAILBOX_IDS 8
+#define BENCHMARK_MAILBOX_PERIOD 32
+
+// How many signals the signal decoding benchmark decodes from each frame.
+#define BENCHMARK_SIGNALS 6
+
+// How many bytes are pushed through each byte buffer benchmark.
+#define BENCHMARK_BYTES 16000000UL
+
+// The size of the byte buffers being compared. A power of two so that both can use it.
+#define BENCHMARK_BUFFER_SIZE 128
+
+// An odd transfer size so that multi-byte transfers regularly straddle the end of the buffer.
+#define BENCHMARK_CHUNK 13
+
+// How many bytes are pushed through each benchmark of the buffer suite.
+#define BENCHMARK_SUITE_BYTES 8000000UL
+
+// How many messages are pushed through each message buffer benchmark of the buffer suite, and the
+// size of that buffer.
+#define BENCHMARK_SUITE_MESSAGES 1000000UL
+#define BENCHMARK_SUITE_SLOTS 16
+
+// Filter 0 points at buffer 1, or at the FIFO when there is one.
+#ifdef ECAN1_FIFO_START
+#define BENCHMARK_RX_POINTER 0x000F
+#else
+#define BENCHMARK_RX_POINTER 0x0001
+#endif
+
+/**
+ * ecan1_init() parameters for a 1Mbit/s bus at 40MIPS. Buffer 0 transmits and filter 0 accepts
+ * every frame into buffer 1 or the FIFO.
+ */
+static const uint16_t benchmarkParameters[53] = {
+    [0] = 0x0101,                   // Standard frames, normal mode, TX on DMA0, RX on DMA1
+    [1] = 10000,                    // 1Mbit/s
+    [2] = 40000,                    // 40MHz
+    [3] = 7 | (4 << 3) | (5 << 6),  // 20 time quanta per bit
+    [4] = 0x0001,                   // Only filter 0 is enabled
+    [13] = 0x0080,                  // Buffer 0 is a TX buffer
+    [17] = BENCHMARK_RX_POINTER     // Filter 0 points at buffer 1 or the FIFO
+};
+
+/**
+ * The same bus with buffers 2 and 3 also transmitting.
+ */
+static const uint16_t pipelineParameters[53] = {
+    [0] = 0x0101,
+    [1] = 10000,
+    [2] = 40000,
+    [3] = 7 | (4 << 3) | (5 << 6),
+    [4] = 0x0001,
+    [13] = 0x0080,                  // Buffer 0 is a TX buffer
+    [14] = 0x8080,                  // So are buffers 2 and 3
+    [17] = BENCHMARK_RX_POINTER
+};
+
+/**
+ * The same bus receiving into three buffers, picked by the lowest two bits of the identifier:
+ * filters 0 to 2 accept identifiers ending in 1, 2 and 3 into buffers 1, 2 and 3, or all into
+ * the FIFO.
+ */
+static const uint16_t burstParameters[53] = {
+    [0] = 0x0101,
+    [1] = 10000,
+    [2] = 40000,
+    [3] = 7 | (4 << 3) | (5 << 6),
+    [4] = 0x0007,                   // Filters 0 to 2 are enabled
+    [7] = 0x0003 << 5,              // Mask 0 only compares the lowest two bits of the identifier
+    [13] = 0x0080,
+#ifdef ECAN1_FIFO_START
+    [17] = 0x0FFF,
+#else
+    [17] = 0x0321,
+#endif
+    [21] = 1 << 5,
+    [23] = 2 << 5,
+    [25] = 3 << 5
+};
+
+static FILE *output;
+
+/**
+ * Records a single benchmark result.
+ */
+static void report(const char *name, double value, const char *unit)
+{
+    printf("%-40s %14.2f %s\n", name, value, unit);
+    if (output) {
+        fprintf(output, "%s %.2f %s\n", name, value, unit);
+    }
+}
+
+/**
+ * Fills in a test frame, alternating between standard and extended identifiers.
+ */
+static void makeFrame(tCanMessage *msg, uint32_t i)
+{
+    uint8_t j;
+
+    msg->buffer = 0;
+    msg->message_type = CAN_MSG_DATA;
+    if (i & 1) {
+        msg->frame_type = CAN_FRAME_EXT;
+        msg->id = (i * 2654435761UL) & 0x1FFFFFFF;
+    } else {
+        msg->frame_type = CAN_FRAME_STD;
+        msg->id = i & 0x7FF;
+    }
+    msg->validBytes = 8;
+    for (j = 0; j < 8; ++j) {
+        msg->payload[j] = (uint8_t) (i + j);
+    }
+}
+
+/**
+ * Delivers frames one at a time and pulls each back out with ecan1_receive().
+ */
+static void benchmarkReceive(void)
+{
+    tCanMessage in, out;
+    uint8_t messagesLeft;
+    uint64_t isrCycles = 0;
+    uint32_t received = 0;
+    uint32_t i;
+
+    Emu_Reset();
+    ecan1_init(benchmarkParameters);
+
+    uint64_t start = Emu_ReadNanoseconds();
+    for (i = 0; i < BENCHMARK_FRAMES; ++i) {
+        makeFrame(&in, i);
+        Emu_InjectFrame(&in);
+
+        uint64_t t0 = Emu_ReadCycles();
+        Emu_Interrupt();
+        isrCycles += Emu_ReadCycles() - t0;
+
+        received += ecan1_receive(&out, &messagesLeft);
+    }
+    uint64_t elapsed = Emu_ReadNanoseconds() - start;
+
+    if (received != BENCHMARK_FRAMES) {
+        fprintf(stderr, "Receive benchmark lost %lu frames.\n", BENCHMARK_FRAMES - received);
+    }
+    report("rx_isr_cycles_per_frame", (double) isrCycles / BENCHMARK_FRAMES, "cycles");
+    report("rx_ns_per_frame", (double) elapsed / BENCHMARK_FRAMES, "ns");
+    report("rx_frames_per_second", BENCHMARK_FRAMES * 1e9 / elapsed, "frames/s");
+}
+
+/**
+ * Delivers frames one at a time and pulls each back out with ecan1_receive_matlab(), timing only
+ * the receive call.
+ */
+static void benchmarkReceiveMatlab(void)
+{
+    tCanMessage in;
+    uint32_t output[4];
+    uint64_t receiveCycles = 0;
+    uint32_t received = 0;
+    uint32_t i;
+
+    Emu_Reset();
+    ecan1_init(benchmarkParameters);
+
+    for (i = 0; i < BENCHMARK_FRAMES; ++i) {
+        makeFrame(&in, i);
+        Emu_InjectFrame(&in);
+        Emu_Interrupt();
+
+        uint64_t t0 = Emu_ReadCycles();
+        received += ecan1_receive_matlab(output);
+        receiveCycles += Emu_ReadCycles() - t0;
+    }
+
+    if (received != BENCHMARK_FRAMES) {
+        fprintf(stderr, "MATLAB receive benchmark lost %lu frames.\n", BENCHMARK_FRAMES - received);
+    }
+    report("rx_matlab_cycles_per_frame", (double) receiveCycles / BENCHMARK_FRAMES, "cycles");
+}
+
+/**
+ * Delivers bursts of ECAN1_RECEIVE_MANY_SIZE frames and pulls each burst back out with a single
+ * ecan1_receive_many_matlab() call, timing only the receive call.
+ */
+static void benchmarkReceiveManyMatlab(void)
+{
+    tCanMessage in;
+    uint32_t output[4 * ECAN1_RECEIVE_MANY_SIZE + 1];
+    uint64_t receiveCycles = 0;
+    uint32_t received = 0;
+    uint32_t i;
+    uint8_t j;
+
+    Emu_Reset();
+    ecan1_init(benchmarkParameters);
+
+    for (i = 0; i < BENCHMARK_FRAMES; i += ECAN1_RECEIVE_MANY_SIZE) {
+        for (j = 0; j < ECAN1_RECEIVE_MANY_SIZE; ++j) {
+            makeFrame(&in, i + j);
+            Emu_InjectFrame(&in);
+            Emu_Interrupt();
+        }
+
+        uint64_t t0 = Emu_ReadCycles();
+        ecan1_receive_many_matlab(output);
+        receiveCycles += Emu_ReadCycles() - t0;
+        received += output[4 * ECAN1_RECEIVE_MANY_SIZE];
+    }
+
+    if (received != i) {
+        fprintf(stderr, "MATLAB batch receive benchmark lost %lu frames.\n", (unsigned long) (i - received));
+    }
+    report("rx_matlab_many_cycles_per_frame", (double) receiveCycles / received, "cycles");
+}
+
+/**
+ * Delivers bursts of three frames, one into each receive buffer, before the interrupt handler gets
+ * to run, and counts the interrupts and cycles spent on each frame read out. Frames left in their
+ * buffers by the interrupt handler are overrun by the next burst.
+ */
+static void benchmarkReceiveBurst(void)
+{
+    tCanMessage msgs[BENCHMARK_TX_BURST];
+    tCanMessage msg;
+    uint64_t isrCycles = 0;
+    uint32_t entries = 0;
+    uint32_t received = 0;
+    uint32_t i;
+    uint8_t j;
+
+    Emu_Reset();
+    ecan1_init(burstParameters);
+
+    for (i = 0; i < BENCHMARK_FRAMES; i += 3) {
+        for (j = 1; j <= 3; ++j) {
+            makeFrame(&msg, i + j);
+            msg.frame_type = CAN_FRAME_STD;
+            msg.id = ((i << 2) | j) & 0x7FF;
+            Emu_InjectFrame(&msg);
+        }
+
+        uint64_t t0 = Emu_ReadCycles();
+        while (Emu_Interrupt()) {
+            ++entries;
+        }
+        isrCycles += Emu_ReadCycles() - t0;
+
+        uint8_t count;
+        while ((count = ecan1_receive_many(msgs, BENCHMARK_TX_BURST))) {
+            received += count;
+        }
+    }
+
+    report("rx_burst_isr_entries_per_frame", (double) entries / received, "entries");
+    report("rx_burst_isr_cycles_per_frame", (double) isrCycles / received, "cycles");
+    report("rx_burst_lost_frames", 100.0 * (i - received) / i, "%");
+}
+
+/**
+ * Measures how many frames of a back-to-back burst are lost because the interrupt handler only
+ * gets to run every `latency` frames. A single receive buffer overruns as soon as the latency
+ * exceeds one frame, while the FIFO absorbs bursts up to its length.
+ */
+static void benchmarkReceiveOverrun(void)
+{
+    static const uint8_t latencies[] = {1, 2, 4, 8, 16, 24, 32};
+    tCanMessage msgs[BENCHMARK_TX_BURST];
+    tCanMessage msg;
+    char label[64];
+    uint32_t i;
+    uint8_t n;
+
+    for (n = 0; n < sizeof(latencies); ++n) {
+        uint32_t overruns = 0;
+
+        Emu_Reset();
+        ecan1_init(benchmarkParameters);
+
+        for (i = 0; i < BENCHMARK_OVERRUN_FRAMES; ++i) {
+            makeFrame(&msg, i);
+            if (Emu_InjectFrame(&msg) == EMU_RX_OVERRUN) {
+                ++overruns;
+            }
+            if ((i + 1) % latencies[n] == 0) {
+                Emu_Interrupt();
+                while (ecan1_receive_many(msgs, BENCHMARK_TX_BURST));
+            }
+        }
+
+#ifdef ECAN1_FIFO_START
+        snprintf(label, sizeof(label), "rx_fifo%d_overrun_latency_%u", ECAN1_DMA_BUFFERS - ECAN1_FIFO_START, latencies[n]);
+#else
+        snprintf(label, sizeof(label), "rx_buffer_overrun_latency_%u", latencies[n]);
+#endif
+        report(label, 100.0 * overruns / BENCHMARK_OVERRUN_FRAMES, "%");
+    }
+}
+
+/**
+ * Measures how many frames are lost because the reception queue fills up while the main loop only
+ * gets to empty it every BENCHMARK_QUEUE_PERIOD frames. The interrupt handler runs after every
+ * frame, so only the queue's capacity matters.
+ */
+static void benchmarkReceiveQueue(void)
+{
+    tCanMessage msgs[BENCHMARK_TX_BURST];
+    tCanMessage msg;
+    uint32_t received = 0;
+    uint32_t i;
+    uint8_t count;
+
+    Emu_Reset();
+    ecan1_init(benchmarkParameters);
+
+    for (i = 0; i < BENCHMARK_OVERRUN_FRAMES; ++i) {
+        makeFrame(&msg, i);
+        Emu_InjectFrame(&msg);
+        Emu_Interrupt();
+        if ((i + 1) % BENCHMARK_QUEUE_PERIOD == 0) {
+            while ((count = ecan1_receive_many(msgs, BENCHMARK_TX_BURST))) {
+                received += count;
+            }
+        }
+    }
+
+    report("rx_queue_lost_frames", 100.0 * (i - received) / i, "%");
+}
+
+/**
+ * Builds the software filter benchmark's traffic: standard frames spread over 1024 identifiers,
+ * with every eighth frame extended.
+ */
+static void makeFilterFrame(tCanMessage *msg, uint32_t i)
+{
+    makeFrame(msg, i);
+    if (i % 8 == 0) {
+        msg->frame_type = CAN_FRAME_EXT;
+        msg->id = 0x18FF0000 + ((i / 8) % 64) * 0x100;
+    } else {
+        msg->frame_type = CAN_FRAME_STD;
+        msg->id = (i * 37) & 0x3FF;
+    }
+}
+
+/**
+ * Receives the software filter benchmark's traffic with the given table of wanted identifiers,
+ * or none, and returns the interrupt handler's cycles per frame. `queued` is set to the number of
+ * frames that made it into the reception queue.
+ */
+static double filterIsrCycles(const uint32_t *ids, uint16_t count, uint32_t *queued)
+{
+    tCanMessage msgs[BENCHMARK_TX_BURST];
+    tCanMessage msg;
+    uint64_t isrCycles = 0;
+    uint32_t i;
+    uint8_t n;
+
+    Emu_Reset();
+    ecan1_init(benchmarkParameters);
+    ecan1_rx_filter_set(ids, count);
+
+    *queued = 0;
+    for (i = 0; i < BENCHMARK_FRAMES; ++i) {
+        makeFilterFrame(&msg, i);
+        Emu_InjectFrame(&msg);
+
+        uint64_t t0 = Emu_ReadCycles();
+        Emu_Interrupt();
+        isrCycles += Emu_ReadCycles() - t0;
+
+        while ((n = ecan1_receive_many(msgs, BENCHMARK_TX_BURST))) {
+            *queued += n;
+        }
+    }
+    ecan1_rx_filter_set(NULL, 0);
+
+    return (double) isrCycles / BENCHMARK_FRAMES;
+}
+
+/**
+ * Receives traffic of which few frames are wanted through the software filter enabled with
+ * ECAN1_RX_FILTER. The net cost is the interrupt handler's time per frame over that without a
+ * table: the lookup, less the time saved by not queueing rejected frames. Without
+ * ECAN1_RX_FILTER every frame is queued.
+ */
+static void benchmarkReceiveFilter(void)
+{
+    uint32_t ids[BENCHMARK_FILTER_IDS];
+    uint32_t expected = 0;
+    uint32_t queued;
+    uint16_t j;
+    double unfiltered = 1e9, filtered = 1e9, cycles;
+
+    // 40 standard identifiers and 8 extended ones, in ascending order.
+    for (j = 0; j < 40; ++j) {
+        ids[j] = 0x100 + 7 * j;
+    }
+    for (; j < BENCHMARK_FILTER_IDS; ++j) {
+        ids[j] = ECAN1_FILTER_EXT(0x18FF0000 + (j - 40) * 0x800);
+    }
+
+    // Alternate between the two so that both see the same conditions.
+    for (j = 0; j < BENCHMARK_FILTER_RUNS; ++j) {
+        cycles = filterIsrCycles(NULL, 0, &queued);
+        if (cycles < unfiltered) {
+            unfiltered = cycles;
+        }
+        cycles = filterIsrCycles(ids, BENCHMARK_FILTER_IDS, &queued);
+        if (cycles < filtered) {
+            filtered = cycles;
+        }
+    }
+
+#ifdef ECAN1_RX_FILTER
+    uint32_t i;
+
+    for (i = 0; i < BENCHMARK_FRAMES; ++i) {
+        tCanMessage msg;
+        uint32_t id;
+
+        makeFilterFrame(&msg, i);
+        id = (msg.frame_type == CAN_FRAME_EXT) ? ECAN1_FILTER_EXT(msg.id) : msg.id;
+        for (j = 0; j < BENCHMARK_FILTER_IDS; ++j) {
+            if (ids[j] == id) {
+                ++expected;
+            }
+        }
+    }
+#else
+    expected = BENCHMARK_FRAMES;
+#endif
+    if (queued != expected) {
+        fprintf(stderr, "Filter benchmark queued %lu frames instead of %lu.\n",
+                (unsigned long) queued, (unsigned long) expected);
+    }
+
+    report("rx_filter_isr_cycles_per_frame", filtered, "cycles");
+    report("rx_filter_net_cycles_per_frame", filtered - unfiltered, "cycles");
+    report("rx_filter_queued_frames", 100.0 * queued / BENCHMARK_FRAMES, "%");
+}
+
+/**
+ * Receives periodic status frames from BENCHMARK_MAILBOX_IDS identifiers mixed with event frames,
+ * one in four, while the main loop only visits every BENCHMARK_MAILBOX_PERIOD frames. With
+ * ECAN1_MAILBOXES the status frames go to mailboxes and only the events are queued. Without it
+ * everything is queued and the main loop discards stale status frames, but events are lost
+ * whenever the queue fills up first.
+ */
+static void benchmarkReceiveMailbox(void)
+{
+    tCanMessage msgs[BENCHMARK_TX_BURST];
+    tCanMessage msg;
+    uint32_t ids[BENCHMARK_MAILBOX_IDS];
+    uint64_t isrCycles = 0;
+    uint32_t events = 0;
+    uint32_t received = 0;
+    uint32_t i;
+    uint8_t count, j;
+
+    for (j = 0; j < BENCHMARK_MAILBOX_IDS; ++j) {
+        ids[j] = 0x100 + j;
+    }
+
+    Emu_Reset();
+    ecan1_init(benchmarkParameters);
+    ecan1_mailbox_set(ids, BENCHMARK_MAILBOX_IDS);
+
+    for (i = 0; i < BENCHMARK_FRAMES; ++i) {
+        makeFrame(&msg, i);
+        msg.frame_type = CAN_FRAME_STD;
+        if (i % 4 == 3) {
+            msg.id = 0x400 + (i & 0xFF);
+            ++events;
+        } else {
+            msg.id = ids[i % BENCHMARK_MAILBOX_IDS];
+        }
+        Emu_InjectFrame(&msg);
+
+        uint64_t t0 = Emu_ReadCycles();
+        Emu_Interrupt();
+        isrCycles += Emu_ReadCycles() - t0;
+
+        if ((i + 1) % BENCHMARK_MAILBOX_PERIOD == 0) {
+            while ((count = ecan1_receive_many(msgs, BENCHMARK_TX_BURST))) {
+                for (j = 0; j < count; ++j) {
+                    received += (msgs[j].id >= 0x400);
+                }
+            }
+            for (j = 0; j < BENCHMARK_MAILBOX_IDS; ++j) {
+                ecan1_mailbox_read(ids[j], &msg, NULL);
+            }
+        }
+    }
+    ecan1_mailbox_set(NULL, 0);
+
+    report("rx_mailbox_isr_cycles_per_frame", (double) isrCycles / BENCHMARK_FRAMES, "cycles");
+    report("rx_mailbox_lost_events", 100.0 * (events - received) / events, "%");
+}
+
+/**
+ * The signals decoded by the signal decoding benchmark, a mix of sizes, signedness and byte orders.
+ */
+static const tCanSignal benchmarkSignals[BENCHMARK_SIGNALS] = {
+    CSD_LITTLE_ENDIAN(0, 16, 0, 0.01f, 0),
+    CSD_LITTLE_ENDIAN(16, 8, CSD_SIGNED, 0.5f, -40),
+    CSD_LITTLE_ENDIAN(24, 4, 0, 1, 0),
+    CSD_LITTLE_ENDIAN(28, 12, CSD_SIGNED, 0.1f, 0),
+    CSD_BIG_ENDIAN(47, 16, 0, 0.001f, 0),
+    CSD_BIG_ENDIAN(59, 4, 0, 1, 0)
+};
+
+/**
+ * Decodes benchmarkSignals by hand from the output of ecan1_receive_matlab(), the way a chain of
+ * Extract Bits, Shift Arithmetic and Data Type Conversion blocks does for each signal.
+ */
+static void decodeByHand(const uint32_t *message, float *values)
+{
+    uint32_t low = message[1];
+    uint32_t high = message[2];
+    int16_t current;
+
+    values[0] = (float) (low & 0xFFFF) * 0.01f;
+    values[1] = (float) (int8_t) (low >> 16) * 0.5f - 40;
+    values[2] = (float) ((low >> 24) & 0xF);
+    current = (int16_t) ((low >> 28) | (high & 0xFF) << 4);
+    values[3] = (float) (current >= 0x800 ? current - 0x1000 : current) * 0.1f;
+    values[4] = (float) (((high >> 8) & 0xFF) << 8 | ((high >> 16) & 0xFF)) * 0.001f;
+    values[5] = (float) ((high >> 24) & 0xF);
+}
+
+/**
+ * Decodes BENCHMARK_SIGNALS signals from each received frame with CSD_DecodeMatlab() and by hand,
+ * checking that both agree.
+ */
+static void benchmarkSignalDecode(void)
+{
+    const tCanSignalMessage messages[] = {{0x123, benchmarkSignals, BENCHMARK_SIGNALS}};
+    uint32_t output[5];
+    double engine[BENCHMARK_SIGNALS];
+    float hand[BENCHMARK_SIGNALS];
+    uint64_t engineCycles = 0, handCycles = 0;
+    uint32_t mismatches = 0;
+    uint32_t i;
+    uint8_t j;
+
+    CSD_SetDatabase(messages, 1);
+    for (i = 0; i < BENCHMARK_FRAMES; ++i) {
+        // Every frame is different so that the work can't be hoisted out of the loop.
+        output[0] = 0x123;
+        output[1] = i * 2654435761UL;
+        output[2] = i * 40503UL ^ (i << 20);
+        output[3] = 8 | (1UL << 16);
+        output[4] = BENCHMARK_SIGNALS;
+
+        uint64_t t0 = Emu_ReadCycles();
+        CSD_DecodeMatlab(output, engine);
+        uint64_t t1 = Emu_ReadCycles();
+        decodeByHand(output, hand);
+        uint64_t t2 = Emu_ReadCycles();
+        engineCycles += t1 - t0;
+        handCycles += t2 - t1;
+
+        for (j = 0; j < BENCHMARK_SIGNALS; ++j) {
+            mismatches += (engine[j] != hand[j]);
+        }
+    }
+    CSD_SetDatabase(NULL, 0);
+
+    if (mismatches) {
+        fprintf(stderr, "Signal decoding disagreed %lu times.\n", (unsigned long) mismatches);
+    }
+    report("signal_decode_cycles_per_frame", (double) engineCycles / BENCHMARK_FRAMES, "cycles");
+    report("signal_by_hand_cycles_per_frame", (double) handCycles / BENCHMARK_FRAMES, "cycles");
+}
+
+/**
+ * Queues bursts of frames with ecan1_buffered_transmit() and lets the bus drain them.
+ */
+static void benchmarkTransmit(void)
+{
+    tCanMessage msg;
+    uint64_t isrCycles = 0;
+    uint32_t sent = 0;
+    uint32_t i;
+
+    Emu_Reset();
+    ecan1_init(benchmarkParameters);
+
+    uint64_t start = Emu_ReadNanoseconds();
+    for (i = 0; i < BENCHMARK_FRAMES; i += BENCHMARK_TX_BURST) {
+        uint8_t j;
+        for (j = 0; j < BENCHMARK_TX_BURST; ++j) {
+            makeFrame(&msg, i + j);
+            ecan1_buffered_transmit(&msg);
+        }
+
+        while (Emu_BusTransmit(NULL)) {
+            ++sent;
+            uint64_t t0 = Emu_ReadCycles();
+            Emu_Interrupt();
+            isrCycles += Emu_ReadCycles() - t0;
+        }
+    }
+    uint64_t elapsed = Emu_ReadNanoseconds() - start;
+
+    report("tx_isr_cycles_per_frame", (double) isrCycles / sent, "cycles");
+    report("tx_ns_per_frame", (double) elapsed / sent, "ns");
+    report("tx_frames_per_second", sent * 1e9 / elapsed, "frames/s");
+}
+
+/**
+ * Compares queueing ECAN1_TRANSMIT_MANY_SIZE frames with one ecan1_buffered_transmit_matlab() call
+ * each against a single ecan1_buffered_transmit_many_matlab() call. Only the queueing is timed.
+ */
+static void benchmarkTransmitMatlab(void)
+{
+    const uint16_t n = ECAN1_TRANSMIT_MANY_SIZE;
+    uint16_t rows[ECAN1_TRANSMIT_MANY_SIZE][8];
+    uint16_t matrix[8 * ECAN1_TRANSMIT_MANY_SIZE + 1];
+    uint64_t singleCycles = 0, manyCycles = 0;
+    uint32_t sent = 0;
+    uint32_t i;
+    uint16_t j, k;
+
+    // The same frames in both layouts.
+    for (j = 0; j < n; ++j) {
+        rows[j][0] = 8 << 8;
+        rows[j][1] = 0x100 + j;
+        rows[j][2] = 0;
+        rows[j][3] = 0;
+        for (k = 4; k < 8; ++k) {
+            rows[j][k] = j * k;
+        }
+        for (k = 0; k < 8; ++k) {
+            matrix[j + k * n] = rows[j][k];
+        }
+    }
+    matrix[8 * n] = n;
+
+    Emu_Reset();
+    ecan1_init(benchmarkParameters);
+
+    for (i = 0; i < BENCHMARK_FRAMES; i += n) {
+        uint64_t t0 = Emu_ReadCycles();
+        for (j = 0; j < n; ++j) {
+            ecan1_buffered_transmit_matlab(rows[j]);
+        }
+        singleCycles += Emu_ReadCycles() - t0;
+        while (Emu_BusTransmit(NULL)) {
+            ++sent;
+            Emu_Interrupt();
+        }
+
+        t0 = Emu_ReadCycles();
+        ecan1_buffered_transmit_many_matlab(matrix);
+        manyCycles += Emu_ReadCycles() - t0;
+        while (Emu_BusTransmit(NULL)) {
+            ++sent;
+            Emu_Interrupt();
+        }
+    }
+
+    if (sent != 2 * i) {
+        fprintf(stderr, "MATLAB transmit benchmark lost %lu frames.\n", (unsigned long) (2 * i - sent));
+    }
+    report("tx_matlab_queue_cycles_per_frame", (double) singleCycles / i, "cycles");
+    report("tx_matlab_many_queue_cycles_per_frame", (double) manyCycles / i, "cycles");
+}
+
+/**
+ * Measures how long the bus sits idle between queued frames. When the module finishes a frame and
+ * another TX buffer is already pending, the next frame follows back-to-back. Otherwise the bus
+ * waits for the interrupt handler to load the next one, so the gap is the time it takes to run.
+ */
+static void benchmarkTransmitGap(const char *name, const uint16_t *parameters)
+{
+    tCanMessage msgs[BENCHMARK_TX_BURST];
+    uint64_t gapCycles = 0;
+    uint32_t backToBack = 0;
+    uint32_t queued = 0;
+    uint32_t sent = 0;
+    char label[64];
+    uint8_t j;
+
+    Emu_Reset();
+    ecan1_init(parameters);
+
+    // Keep the queue topped up so the bus is never waiting on the main loop.
+    while (sent < BENCHMARK_FRAMES) {
+        if (queued - sent < BENCHMARK_TX_BURST) {
+            for (j = 0; j < BENCHMARK_TX_BURST; ++j) {
+                makeFrame(&msgs[j], queued + j);
+            }
+            queued += ecan1_buffered_transmit_many(msgs, BENCHMARK_TX_BURST);
+        }
+
+        if (!Emu_BusTransmit(NULL)) {
+            fprintf(stderr, "Transmit gap benchmark stalled after %lu frames.\n", (unsigned long) sent);
+            break;
+        }
+        ++sent;
+        if (Emu_TxPending()) {
+            ++backToBack;
+            Emu_Interrupt();
+        } else {
+            uint64_t t0 = Emu_ReadCycles();
+            Emu_Interrupt();
+            gapCycles += Emu_ReadCycles() - t0;
+        }
+    }
+
+    snprintf(label, sizeof(label), "%s_gap_cycles_per_frame", name);
+    report(label, (double) gapCycles / sent, "cycles");
+    snprintf(label, sizeof(label), "%s_back_to_back", name);
+    report(label, 100.0 * backToBack / sent, "%");
+}
+
+/**
+ * Measures how long an urgent frame, with the highest possible priority, waits behind a
+ * transmission queue kept full of lower-priority frames. The wait is counted in frames sent
+ * between queueing the urgent frame and it reaching the bus. With ECAN1_TX_PRIORITY defined this
+ * is bounded by the frames already loaded into TX buffers, otherwise by the length of the queue.
+ */
+static void benchmarkTransmitLatency(const char *name, const uint16_t *parameters)
+{
+    tCanMessage msgs[BENCHMARK_TX_BURST];
+    tCanMessage urgent;
+    tCanMessage frame;
+    uint32_t background = 0;
+    uint32_t sent = 0;
+    uint32_t queuedAt = 0;
+    uint32_t urgentSent = 0;
+    uint32_t worst = 0;
+    uint64_t total = 0;
+    bool waiting = false;
+    char label[64];
+    uint8_t j;
+
+    makeFrame(&urgent, 0);
+
+    Emu_Reset();
+    ecan1_init(parameters);
+
+    while (sent < BENCHMARK_FRAMES) {
+        // Every so often queue an urgent frame as soon as there's room for it.
+        if (!waiting && sent % BENCHMARK_URGENT_PERIOD == 0) {
+            ecan1_buffered_transmit(&urgent);
+            queuedAt = sent;
+            waiting = true;
+        }
+
+        // Keep the rest of the queue full of lower-priority frames.
+        uint8_t queued;
+        do {
+            for (j = 0; j < BENCHMARK_TX_BURST; ++j) {
+                makeFrame(&msgs[j], background + j);
+                if (msgs[j].frame_type == CAN_FRAME_STD) {
+                    msgs[j].id |= 0x100;
+                }
+            }
+            queued = ecan1_buffered_transmit_many(msgs, BENCHMARK_TX_BURST);
+            background += queued;
+        } while (queued == BENCHMARK_TX_BURST);
+
+        if (!Emu_BusTransmit(&frame)) {
+            fprintf(stderr, "Transmit latency benchmark stalled after %lu frames.\n", (unsigned long) sent);
+            break;
+        }
+        Emu_Interrupt();
+        if (waiting && frame.frame_type == CAN_FRAME_STD && frame.id == urgent.id) {
+            uint32_t latency = sent - queuedAt;
+            if (latency > worst) {
+                worst = latency;
+            }
+            total += latency;
+            ++urgentSent;
+            waiting = false;
+        }
+        ++sent;
+    }
+
+#ifdef ECAN1_TX_PRIORITY
+    snprintf(label, sizeof(label), "%s_priority_urgent_worst_frames", name);
+#else
+    snprintf(label, sizeof(label), "%s_fifo_urgent_worst_frames", name);
+#endif
+    report(label, worst, "frames");
+#ifdef ECAN1_TX_PRIORITY
+    snprintf(label, sizeof(label), "%s_priority_urgent_mean_frames", name);
+#else
+    snprintf(label, sizeof(label), "%s_fifo_urgent_mean_frames", name);
+#endif
+    report(label, (double) total / urgentSent, "frames");
+}
+
+/**
+ * Compares the per-byte cost of CircularBuffer against MaskedBuffer, one byte at a time and in
+ * chunks. The buffer is kept half full so every pass wraps around.
+ */
+static void benchmarkByteBuffers(void)
+{
+    static uint8_t cbData[BENCHMARK_BUFFER_SIZE];
+    static uint8_t mbData[BENCHMARK_BUFFER_SIZE];
+    uint8_t chunk[BENCHMARK_CHUNK] = {0};
+    volatile uint8_t sink = 0;
+    CircularBuffer cb;
+    MaskedBuffer mb;
+    uint8_t d = 0;
+    uint32_t i;
+
+    CB_Init(&cb, cbData, BENCHMARK_BUFFER_SIZE);
+    CB_WriteMany(&cb, chunk, BENCHMARK_BUFFER_SIZE / 2, true);
+    uint64_t t0 = Emu_ReadCycles();
+    for (i = 0; i < BENCHMARK_BYTES; ++i) {
+        CB_WriteByte(&cb, (uint8_t) i);
+        CB_ReadByte(&cb, &d);
+        sink += d;
+    }
+    report("cb_byte_cycles_per_byte", (double) (Emu_ReadCycles() - t0) / BENCHMARK_BYTES, "cycles");
+
+    MB_INIT(&mb, mbData);
+    MB_WriteMany(&mb, chunk, BENCHMARK_BUFFER_SIZE / 2, true);
+    t0 = Emu_ReadCycles();
+    for (i = 0; i < BENCHMARK_BYTES; ++i) {
+        MB_WriteByte(&mb, (uint8_t) i);
+        MB_ReadByte(&mb, &d);
+        sink += d;
+    }
+    report("mb_byte_cycles_per_byte", (double) (Emu_ReadCycles() - t0) / BENCHMARK_BYTES, "cycles");
+
+    t0 = Emu_ReadCycles();
+    for (i = 0; i < BENCHMARK_BYTES; i += BENCHMARK_CHUNK) {
+        CB_WriteMany(&cb, chunk, BENCHMARK_CHUNK, true);
+        CB_ReadMany(&cb, chunk, BENCHMARK_CHUNK);
+    }
+    report("cb_many_cycles_per_byte", (double) (Emu_ReadCycles() - t0) / BENCHMARK_BYTES, "cycles");
+
+    t0 = Emu_ReadCycles();
+    for (i = 0; i < BENCHMARK_BYTES; i += BENCHMARK_CHUNK) {
+        MB_WriteMany(&mb, chunk, BENCHMARK_CHUNK, true);
+        MB_ReadMany(&mb, chunk, BENCHMARK_CHUNK);
+    }
+    report("mb_many_cycles_per_byte", (double) (Emu_ReadCycles() - t0) / BENCHMARK_BYTES, "cycles");
+}
+
+/**
+ * Records the time taken by `ops` operations that moved `bytes` bytes through a buffer.
+ */
+static void reportTransfer(const char *name, uint64_t elapsed, uint32_t ops, uint32_t bytes)
+{
+    char key[64];
+
+    snprintf(key, sizeof(key), "%s_ns_per_op", name);
+    report(key, (double) elapsed / ops, "ns");
+    snprintf(key, sizeof(key), "%s_bytes_per_second", name);
+    report(key, bytes * 1e9 / elapsed, "bytes/s");
+}
+
+/**
+ * Moves data through a CircularBuffer of `size` bytes, `chunk` bytes at a time, with CB_WriteMany()
+ * followed by CB_ReadMany(), or by CB_PeekMany() and CB_Remove() when `peek` is set. The buffer
+ * starts out holding `fill` bytes and holds that many again after every operation.
+ */
+static void benchmarkCircularChunks(const char *name, uint16_t size, uint16_t fill, uint16_t chunk, bool peek)
+{
+    static uint8_t data[BENCHMARK_BUFFER_SIZE];
+    uint8_t in[BENCHMARK_BUFFER_SIZE] = {0};
+    uint8_t out[BENCHMARK_BUFFER_SIZE];
+    volatile uint8_t sink = 0;
+    uint32_t ops = BENCHMARK_SUITE_BYTES / chunk;
+    CircularBuffer b;
+    uint32_t i;
+
+    CB_Init(&b, data, size);
+    CB_WriteMany(&b, in, fill, true);
+    uint64_t start = Emu_ReadNanoseconds();
+    for (i = 0; i < ops; ++i) {
+        in[0] = (uint8_t) i;
+        CB_WriteMany(&b, in, chunk, true);
+        if (peek) {
+            CB_PeekMany(&b, out, chunk);
+            CB_Remove(&b, chunk);
+        } else {
+            CB_ReadMany(&b, out, chunk);
+        }
+        sink += out[0];
+    }
+    reportTransfer(name, Emu_ReadNanoseconds() - start, ops, ops * chunk);
+}
+
+/**
+ * The MaskedBuffer counterpart of benchmarkCircularChunks(). `size` must be a power of two.
+ */
+static void benchmarkMaskedChunks(const char *name, uint16_t size, uint16_t fill, uint16_t chunk, bool peek)
+{
+    static uint8_t data[BENCHMARK_BUFFER_SIZE];
+    uint8_t in[BENCHMARK_BUFFER_SIZE] = {0};
+    uint8_t out[BENCHMARK_BUFFER_SIZE];
+    volatile uint8_t sink = 0;
+    uint32_t ops = BENCHMARK_SUITE_BYTES / chunk;
+    MaskedBuffer b;
+    uint32_t i;
+
+    MB_Init(&b, data, size);
+    MB_WriteMany(&b, in, fill, true);
+    uint64_t start = Emu_ReadNanoseconds();
+    for (i = 0; i < ops; ++i) {
+        in[0] = (uint8_t) i;
+        MB_WriteMany(&b, in, chunk, true);
+        if (peek) {
+            MB_PeekMany(&b, out, chunk);
+            MB_Remove(&b, chunk);
+        } else {
+            MB_ReadMany(&b, out, chunk);
+        }
+        sink += out[0];
+    }
+    reportTransfer(name, Emu_ReadNanoseconds() - start, ops, ops * chunk);
+}
+
+/**
+ * Times the byte buffers one byte at a time, including writes into a full buffer, then in chunks
+ * of an odd size, of a tCanMessage and of a larger block. The wrap benchmarks use a buffer one
+ * byte longer than the chunk, so that almost every transfer straddles its end, and the near-full
+ * ones leave room for exactly one more chunk.
+ */
+static void benchmarkByteBufferSuite(void)
+{
+    static uint8_t data[BENCHMARK_BUFFER_SIZE];
+    volatile uint8_t sink = 0;
+    CircularBuffer cb;
+    MaskedBuffer mb;
+    uint8_t d = 0;
+    uint32_t i;
+
+    CB_Init(&cb, data, BENCHMARK_BUFFER_SIZE);
+    for (i = 0; i < BENCHMARK_BUFFER_SIZE / 2; ++i) {
+        CB_WriteByte(&cb, 0);
+    }
+    uint64_t start = Emu_ReadNanoseconds();
+    for (i = 0; i < BENCHMARK_SUITE_BYTES; ++i) {
+        CB_WriteByte(&cb, (uint8_t) i);
+        CB_ReadByte(&cb, &d);
+        sink += d;
+    }
+    reportTransfer("suite_cb_byte", Emu_ReadNanoseconds() - start, BENCHMARK_SUITE_BYTES, BENCHMARK_SUITE_BYTES);
+
+    // Only the failed write is timed, so this reports no throughput.
+    while (CB_WriteByte(&cb, 0));
+    start = Emu_ReadNanoseconds();
+    for (i = 0; i < BENCHMARK_SUITE_BYTES; ++i) {
+        sink += CB_WriteByte(&cb, (uint8_t) i);
+    }
+    report("suite_cb_byte_full_ns_per_op", (double) (Emu_ReadNanoseconds() - start) / BENCHMARK_SUITE_BYTES, "ns");
+
+    MB_Init(&mb, data, BENCHMARK_BUFFER_SIZE);
+    for (i = 0; i < BENCHMARK_BUFFER_SIZE / 2; ++i) {
+        MB_WriteByte(&mb, 0);
+    }
+    start = Emu_ReadNanoseconds();
+    for (i = 0; i < BENCHMARK_SUITE_BYTES; ++i) {
+        MB_WriteByte(&mb, (uint8_t) i);
+        MB_ReadByte(&mb, &d);
+        sink += d;
+    }
+    reportTransfer("suite_mb_byte", Emu_ReadNanoseconds() - start, BENCHMARK_SUITE_BYTES, BENCHMARK_SUITE_BYTES);
+
+    const uint16_t half = BENCHMARK_BUFFER_SIZE / 2;
+    benchmarkCircularChunks("suite_cb_many_7", BENCHMARK_BUFFER_SIZE, half, 7, false);
+    benchmarkCircularChunks("suite_cb_many_13", BENCHMARK_BUFFER_SIZE, half, 13, false);
+    benchmarkCircularChunks("suite_cb_many_msg", BENCHMARK_BUFFER_SIZE, half, sizeof(tCanMessage), false);
+    benchmarkCircularChunks("suite_cb_many_64", BENCHMARK_BUFFER_SIZE, 32, 64, false);
+    benchmarkCircularChunks("suite_cb_peek_remove_13", BENCHMARK_BUFFER_SIZE, half, 13, true);
+    benchmarkCircularChunks("suite_cb_peek_remove_msg", BENCHMARK_BUFFER_SIZE, half, sizeof(tCanMessage), true);
+    benchmarkCircularChunks("suite_cb_wrap_13", 14, 0, 13, false);
+    benchmarkCircularChunks("suite_cb_wrap_msg", sizeof(tCanMessage) + 1, 0, sizeof(tCanMessage), false);
+    benchmarkCircularChunks("suite_cb_near_full_13", BENCHMARK_BUFFER_SIZE, BENCHMARK_BUFFER_SIZE - 13, 13, false);
+
+    benchmarkMaskedChunks("suite_mb_many_7", BENCHMARK_BUFFER_SIZE, half, 7, false);
+    benchmarkMaskedChunks("suite_mb_many_13", BENCHMARK_BUFFER_SIZE, half, 13, false);
+    benchmarkMaskedChunks("suite_mb_many_msg", BENCHMARK_BUFFER_SIZE, half, sizeof(tCanMessage), false);
+    benchmarkMaskedChunks("suite_mb_many_64", BENCHMARK_BUFFER_SIZE, 32, 64, false);
+    benchmarkMaskedChunks("suite_mb_peek_remove_13", BENCHMARK_BUFFER_SIZE, half, 13, true);
+    benchmarkMaskedChunks("suite_mb_wrap_13", 16, 0, 13, false);
+    benchmarkMaskedChunks("suite_mb_near_full_13", BENCHMARK_BUFFER_SIZE, BENCHMARK_BUFFER_SIZE - 13, 13, false);
+}
+
+/**
+ * Times the CanMessageBuffer paths used by the ECAN queues: one message at a time, in batches, and
+ * in place the way the interrupt handler fills the reception buffer. The buffer is kept half full.
+ * Throughput counts the bytes of each tCanMessage.
+ */
+static void benchmarkMessageBufferSuite(void)
+{
+    static tCanPackedMessage data[BENCHMARK_SUITE_SLOTS];
+    tCanMessage batch[BENCHMARK_TX_BURST];
+    volatile uint32_t sink = 0;
+    CanMessageBuffer b;
+    tCanMessage msg;
+    uint32_t i;
+
+    for (i = 0; i < BENCHMARK_TX_BURST; ++i) {
+        makeFrame(&batch[i], i);
+    }
+    makeFrame(&msg, 1);
+
+    CMB_Init(&b, data, BENCHMARK_SUITE_SLOTS);
+    CMB_WriteMany(&b, batch, BENCHMARK_SUITE_SLOTS / 2);
+    uint64_t start = Emu_ReadNanoseconds();
+    for (i = 0; i < BENCHMARK_SUITE_MESSAGES; ++i) {
+        msg.payload[0] = (uint8_t) i;
+        CMB_Write(&b, &msg);
+        CMB_Read(&b, &msg);
+        sink += msg.id;
+    }
+    reportTransfer("suite_cmb_message", Emu_ReadNanoseconds() - start, BENCHMARK_SUITE_MESSAGES,
+                   BENCHMARK_SUITE_MESSAGES * sizeof(tCanMessage));
+
+    start = Emu_ReadNanoseconds();
+    for (i = 0; i < BENCHMARK_SUITE_MESSAGES; i += BENCHMARK_TX_BURST) {
+        CMB_WriteMany(&b, batch, BENCHMARK_TX_BURST);
+        CMB_ReadMany(&b, batch, BENCHMARK_TX_BURST);
+        sink += batch[0].id;
+    }
+    reportTransfer("suite_cmb_many_8", Emu_ReadNanoseconds() - start, BENCHMARK_SUITE_MESSAGES / BENCHMARK_TX_BURST,
+                   BENCHMARK_SUITE_MESSAGES * sizeof(tCanMessage));
+
+    start = Emu_ReadNanoseconds();
+    for (i = 0; i < BENCHMARK_SUITE_MESSAGES; ++i) {
+        tCanPackedMessage *slot = CMB_Reserve(&b);
+        msg.payload[0] = (uint8_t) i;
+        CMB_Pack(slot, &msg);
+        CMB_Commit(&b);
+        CMB_Unpack(&msg, CMB_PeekContiguous(&b, NULL));
+        CMB_Consume(&b, 1);
+        sink += msg.id;
+    }
+    reportTransfer("suite_cmb_in_place", Emu_ReadNanoseconds() - start, BENCHMARK_SUITE_MESSAGES,
+                   BENCHMARK_SUITE_MESSAGES * sizeof(tCanMessage));
+}
+
+int main()
+{
+    output = fopen("bench_output.txt", "w");
+
+    benchmarkReceive();
+    benchmarkReceiveMatlab();
+    benchmarkReceiveManyMatlab();
+    benchmarkReceiveBurst();
+    benchmarkReceiveOverrun();
+    benchmarkReceiveQueue();
+    benchmarkReceiveFilter();
+    benchmarkReceiveMailbox();
+    benchmarkSignalDecode();
+    benchmarkTransmit();
+    benchmarkTransmitMatlab();
+    benchmarkTransmitGap("tx_1buf", benchmarkParameters);
+    benchmarkTransmitGap("tx_3buf", pipelineParameters);
+    benchmarkTransmitLatency("tx_1buf", benchmarkParameters);
+    benchmarkTransmitLatency("tx_3buf", pipelineParameters);
+    benchmarkByteBuffers();
+    benchmarkByteBufferSuite();
+    benchmarkMessageBufferSuite();
+
+    if (output) {
+        fclose(output);
+    }
+
+    return 0;
+}
@@ -0,0 +1,414 @@
+/**
+ * @file   ecanEmulator.c
+ * @date   October, 2026
+ * @brief  Host-side emulation of the dsPIC33F ECAN1 peripheral and its DMA RAM.
+ *
+ * See ecanEmulator.h for usage.
+ */
+#include "ecanEmulator.h"
+
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// The number of message buffers backed by ecan1msgBuf.
+#define EMU_DMA_BUFFERS (sizeof(ecan1msgBuf) / sizeof(ecan1msgBuf[0]))
+
+// Each object passed to __builtin_dmaoffset() gets its own window of DMA address space.
+#define EMU_DMA_WINDOW  0x1000
+#define EMU_DMA_OBJECTS 16
+
+/*
+ * The register file.
+ */
+volatile union C1CTRL1_u Emu_C1CTRL1;
+volatile union C1CFG1_u Emu_C1CFG1;
+volatile union C1CFG2_u Emu_C1CFG2;
+volatile union C1FCTRL_u Emu_C1FCTRL;
+volatile union C1FIFO_u Emu_C1FIFO;
+volatile union C1VEC_u Emu_C1VEC;
+volatile union C1INTF_u Emu_C1INTF;
+volatile union C1INTE_u Emu_C1INTE;
+volatile union C1RXM0SID_u Emu_C1RXM0SID;
+volatile union C1RXM1SID_u Emu_C1RXM1SID;
+volatile union C1RXM2SID_u Emu_C1RXM2SID;
+volatile uint16_t Emu_C1RXMEID[3];
+volatile uint16_t Emu_C1BUFPNT[4];
+volatile uint16_t Emu_C1RXF[16][2];
+volatile uint16_t C1FEN1;
+volatile uint16_t C1FMSKSEL1;
+volatile uint16_t C1FMSKSEL2;
+volatile uint16_t C1RXFUL1;
+volatile uint16_t C1RXFUL2;
+volatile uint16_t C1RXOVF1;
+volatile uint16_t C1RXOVF2;
+volatile uint16_t C1EC;
+volatile uint16_t C1RXD;
+volatile uint16_t C1TXD;
+volatile uint16_t Emu_C1TRCON[4];
+
+volatile union IFS0_u Emu_IFS0;
+volatile union IFS1_u Emu_IFS1;
+volatile union IFS2_u Emu_IFS2;
+volatile union IEC0_u Emu_IEC0;
+volatile union IEC1_u Emu_IEC1;
+volatile union IEC2_u Emu_IEC2;
+volatile union IPC3_u Emu_IPC3;
+volatile union IPC7_u Emu_IPC7;
+
+volatile union U2MODE_u Emu_U2MODE;
+volatile union U2STA_u Emu_U2STA;
+volatile uint16_t U2BRG;
+volatile uint16_t U2TXREG;
+volatile uint16_t U2RXREG;
+
+volatile uint16_t TMR1;
+volatile uint16_t Emu_TMR2;
+volatile uint16_t TMR3;
+volatile uint16_t TMR3HLD;
+
+volatile uint16_t Emu_DMA[8][6];
+volatile uint16_t DMACS0;
+volatile uint16_t DMACS1;
+
+// Objects that have been placed into emulated DMA RAM.
+static const volatile void *dmaObjects[EMU_DMA_OBJECTS];
+
+volatile C1CTRL1BITS *Emu_C1CTRL1bits(void)
+{
+    // The module switches into the requested mode as soon as the driver looks at it.
+    Emu_C1CTRL1.bits.OPMODE = Emu_C1CTRL1.bits.REQOP;
+    return &Emu_C1CTRL1.bits;
+}
+
+volatile uint16_t *Emu_TMR2Latch(void)
+{
+    // Any access to the low half latches the high half, which is close enough for the driver.
+    TMR3HLD = TMR3;
+    return &Emu_TMR2;
+}
+
+volatile DMA1REQBITS *Emu_DMA1REQbits(void)
+{
+    // DMA1REQ is one of the six contiguous channel 1 registers, so it can't have a union of its own.
+    return (volatile DMA1REQBITS *) &Emu_DMA[1][1];
+}
+
+uint16_t Emu_DmaOffset(const volatile void *object)
+{
+    uint16_t i;
+    for (i = 0; i < EMU_DMA_OBJECTS && dmaObjects[i]; ++i) {
+        if (dmaObjects[i] == object) {
+            return i * EMU_DMA_WINDOW;
+        }
+    }
+
+    // Out of windows, so everything else aliases onto the last one.
+    if (i == EMU_DMA_OBJECTS) {
+        i = EMU_DMA_OBJECTS - 1;
+    }
+    dmaObjects[i] = object;
+    return i * EMU_DMA_WINDOW;
+}
+
+void *Emu_DmaAddress(uint16_t offset)
+{
+    uint8_t *base = (uint8_t *) dmaObjects[offset / EMU_DMA_WINDOW];
+    if (!base) {
+        return NULL;
+    }
+    return base + (offset % EMU_DMA_WINDOW);
+}
+
+void Emu_Reset(void)
+{
+    Emu_C1CTRL1.reg = 0x0480; // Configuration mode after reset
+    Emu_C1CFG1.reg = 0;
+    Emu_C1CFG2.reg = 0;
+    Emu_C1FCTRL.reg = 0;
+    Emu_C1FIFO.reg = 0;
+    Emu_C1VEC.reg = 0x0040; // No interrupt
+    Emu_C1INTF.reg = 0;
+    Emu_C1INTE.reg = 0;
+    Emu_C1RXM0SID.reg = 0;
+    Emu_C1RXM1SID.reg = 0;
+    Emu_C1RXM2SID.reg = 0;
+    memset((void *) Emu_C1RXMEID, 0, sizeof(Emu_C1RXMEID));
+    memset((void *) Emu_C1BUFPNT, 0, sizeof(Emu_C1BUFPNT));
+    memset((void *) Emu_C1RXF, 0, sizeof(Emu_C1RXF));
+    C1FEN1 = 0xFFFF;
+    C1FMSKSEL1 = C1FMSKSEL2 = 0;
+    C1RXFUL1 = C1RXFUL2 = C1RXOVF1 = C1RXOVF2 = 0;
+    C1EC = 0;
+    C1RXD = C1TXD = 0;
+    memset((void *) Emu_C1TRCON, 0, sizeof(Emu_C1TRCON));
+
+    Emu_IFS0.reg = Emu_IFS1.reg = Emu_IFS2.reg = 0;
+    Emu_IEC0.reg = Emu_IEC1.reg = Emu_IEC2.reg = 0;
+    Emu_IPC3.reg = 0x0444; // Every priority defaults to 4
+    Emu_IPC7.reg = 0x4444;
+    Emu_U2MODE.reg = 0;
+    Emu_U2STA.reg = 0x0110; // Receiver idle and transmit shift register empty
+    U2BRG = U2TXREG = U2RXREG = 0;
+    TMR1 = 0;
+    Emu_TMR2 = TMR3 = TMR3HLD = 0;
+
+    memset((void *) Emu_DMA, 0, sizeof(Emu_DMA));
+    DMACS0 = DMACS1 = 0;
+
+    memset(ecan1msgBuf, 0, sizeof(ecan1msgBuf));
+}
+
+void Emu_EncodeFrame(const tCanMessage *frame, uint16_t *words)
+{
+    uint8_t rtr = (frame->message_type == CAN_MSG_RTR);
+
+    if (frame->frame_type == CAN_FRAME_EXT) {
+        words[0] = (uint16_t) (((frame->id >> 18) & 0x7FF) << 2) | 0x0003;
+        words[1] = (uint16_t) ((frame->id >> 6) & 0xFFF);
+        words[2] = (uint16_t) ((frame->id & 0x3F) << 10) | (rtr << 9);
+    } else {
+        words[0] = (uint16_t) ((frame->id & 0x7FF) << 2) | (rtr << 1);
+        words[1] = 0;
+        words[2] = 0;
+    }
+    words[2] |= frame->validBytes & 0x000F;
+    words[3] = ((uint16_t) frame->payload[1] << 8) | frame->payload[0];
+    words[4] = ((uint16_t) frame->payload[3] << 8) | frame->payload[2];
+    words[5] = ((uint16_t) frame->payload[5] << 8) | frame->payload[4];
+    words[6] = ((uint16_t) frame->payload[7] << 8) | frame->payload[6];
+    words[7] = 0;
+}
+
+void Emu_DecodeFrame(const uint16_t *words, tCanMessage *frame)
+{
+    uint8_t i;
+
+    if (words[0] & 0x0001) {
+        frame->frame_type = CAN_FRAME_EXT;
+        frame->id = ((uint32_t) (words[0] & 0x1FFC) << 16) |
+                    ((uint32_t) (words[1] & 0x0FFF) << 6) |
+                    ((uint32_t) (words[2] & 0xFC00) >> 10);
+        frame->message_type = (words[2] & 0x0200) ? CAN_MSG_RTR : CAN_MSG_DATA;
+    } else {
+        frame->frame_type = CAN_FRAME_STD;
+        frame->id = (words[0] & 0x1FFC) >> 2;
+        frame->message_type = (words[0] & 0x0002) ? CAN_MSG_RTR : CAN_MSG_DATA;
+    }
+    frame->validBytes = words[2] & 0x000F;
+    for (i = 0; i < 8; ++i) {
+        frame->payload[i] = (uint8_t) (words[3 + i / 2] >> ((i & 1) * 8));
+    }
+}
+
+/**
+ * Returns the mask registers selected by a given filter.
+ */
+static void getFilterMask(uint8_t filter, uint16_t *maskSid, uint16_t *maskEid)
+{
+    uint16_t select = (filter < 8) ? C1FMSKSEL1 : C1FMSKSEL2;
+    switch ((select >> ((filter & 7) * 2)) & 3) {
+    case 1:
+        *maskSid = Emu_C1RXM1SID.reg;
+        *maskEid = Emu_C1RXMEID[1];
+        break;
+    case 2:
+        *maskSid = Emu_C1RXM2SID.reg;
+        *maskEid = Emu_C1RXMEID[2];
+        break;
+    default:
+        *maskSid = Emu_C1RXM0SID.reg;
+        *maskEid = Emu_C1RXMEID[0];
+        break;
+    }
+}
+
+/**
+ * Runs a frame through the acceptance filters.
+ * @return The number of the highest-priority matching filter, or -1 if none match.
+ */
+static int matchFilters(const tCanMessage *frame)
+{
+    uint8_t ide = (frame->frame_type == CAN_FRAME_EXT);
+    uint16_t sid = ide ? (uint16_t) (frame->id >> 18) & 0x7FF : (uint16_t) frame->id & 0x7FF;
+    uint32_t eid = ide ? frame->id & 0x3FFFF : 0;
+    uint8_t n;
+
+    for (n = 0; n < 16; ++n) {
+        if (!(C1FEN1 & (1 << n))) {
+            continue;
+        }
+
+        uint16_t maskSid, maskEid;
+        getFilterMask(n, &maskSid, &maskEid);
+        uint16_t filterSid = Emu_C1RXF[n][0];
+
+        // MIDE restricts the filter to frames whose type matches EXIDE.
+        if ((maskSid & 0x0008) && (((filterSid >> 3) & 1) != ide)) {
+            continue;
+        }
+        if (((sid ^ (filterSid >> 5)) & (maskSid >> 5)) != 0) {
+            continue;
+        }
+        if (ide) {
+            uint32_t filterEid = ((uint32_t) (filterSid & 3) << 16) | Emu_C1RXF[n][1];
+            uint32_t mask = ((uint32_t) (maskSid & 3) << 16) | maskEid;
+            if (((eid ^ filterEid) & mask) != 0) {
+                continue;
+            }
+        }
+        return n;
+    }
+
+    return -1;
+}
+
+/**
+ * Returns whether the given buffer's C1RXFUL bit is set.
+ */
+static bool bufferFull(uint8_t buffer)
+{
+    return ((buffer < 16 ? C1RXFUL1 : C1RXFUL2) >> (buffer & 15)) & 1;
+}
+
+/**
+ * Catches up on the FIFO read pointer. The module advances FNRB whenever the CPU clears the full
+ * bit of the buffer it points to, which the emulator can't observe as it happens. So this is done
+ * before every reception and before the interrupt handler runs, which is all the driver can see.
+ */
+static void syncFifo(void)
+{
+    uint8_t start = Emu_C1FCTRL.bits.FSA;
+    uint8_t end = EMU_DMA_BUFFERS;
+    uint8_t next = Emu_C1FIFO.bits.FNRB;
+
+    if (start >= end) {
+        return;
+    }
+    if (next < start || next >= end) {
+        next = start;
+    }
+    if (Emu_C1FIFO.bits.FBP < start || Emu_C1FIFO.bits.FBP >= end) {
+        Emu_C1FIFO.bits.FBP = start;
+    }
+    while (next != Emu_C1FIFO.bits.FBP && !bufferFull(next)) {
+        next = (next + 1 < end) ? next + 1 : start;
+    }
+    Emu_C1FIFO.bits.FNRB = next;
+}
+
+int Emu_InjectFrame(const tCanMessage *frame)
+{
+    int filter = matchFilters(frame);
+    if (filter < 0) {
+        return EMU_RX_FILTERED;
+    }
+
+    // A buffer pointer of 15 stores into the FIFO at FBP, which then moves on to the next buffer.
+    uint8_t buffer = (Emu_C1BUFPNT[filter / 4] >> ((filter & 3) * 4)) & 0xF;
+    if (buffer == 15) {
+        syncFifo();
+        buffer = Emu_C1FIFO.bits.FBP;
+        if (!bufferFull(buffer)) {
+            Emu_C1FIFO.bits.FBP = (buffer + 1u < EMU_DMA_BUFFERS) ? buffer + 1 : Emu_C1FCTRL.bits.FSA;
+        }
+    }
+    volatile uint16_t *full = (buffer < 16) ? &C1RXFUL1 : &C1RXFUL2;
+    volatile uint16_t *overflow = (buffer < 16) ? &C1RXOVF1 : &C1RXOVF2;
+    uint16_t bit = 1 << (buffer & 15);
+
+    if (buffer >= EMU_DMA_BUFFERS || (*full & bit)) {
+        *overflow |= bit;
+        Emu_C1INTF.bits.RBOVIF = 1;
+        return EMU_RX_OVERRUN;
+    }
+
+    // The DMA channel moves the frame into the message buffer.
+    Emu_EncodeFrame(frame, ecan1msgBuf[buffer]);
+    ecan1msgBuf[buffer][7] = (uint16_t) filter << 8;
+    *full |= bit;
+
+    Emu_C1VEC.bits.ICODE = buffer;
+    Emu_C1VEC.bits.FILHIT = filter;
+    Emu_C1INTF.bits.RBIF = 1;
+    if (Emu_C1INTE.bits.RBIE) {
+        Emu_IFS2.bits.C1IF = 1;
+    }
+
+    return EMU_RX_ACCEPTED;
+}
+
+int Emu_BusTransmit(tCanMessage *frame)
+{
+    int best = -1;
+    uint8_t bestPriority = 0;
+    uint8_t n;
+
+    // Arbitrate between the pending buffers the way the module does: highest TXnPRI first and the
+    // highest-numbered buffer among equals.
+    for (n = 0; n < 8 && n < EMU_DMA_BUFFERS; ++n) {
+        uint8_t control = (uint8_t) (Emu_C1TRCON[n / 2] >> ((n & 1) * 8));
+        if ((control & 0x80) && (control & 0x08) && (best < 0 || (control & 3) >= bestPriority)) {
+            best = n;
+            bestPriority = control & 3;
+        }
+    }
+    if (best < 0) {
+        return STANDARD_ERROR;
+    }
+
+    if (frame) {
+        Emu_DecodeFrame((const uint16_t *) ecan1msgBuf[best], frame);
+    }
+    Emu_C1TRCON[best / 2] &= ~(0x0008 << ((best & 1) * 8));
+
+    Emu_C1VEC.bits.ICODE = best;
+    Emu_C1INTF.bits.TBIF = 1;
+    if (Emu_C1INTE.bits.TBIE) {
+        Emu_IFS2.bits.C1IF = 1;
+    }
+
+    return SUCCESS;
+}
+
+bool Emu_TxPending(void)
+{
+    uint8_t n;
+
+    for (n = 0; n < 8 && n < EMU_DMA_BUFFERS; ++n) {
+        uint8_t control = (uint8_t) (Emu_C1TRCON[n / 2] >> ((n & 1) * 8));
+        if ((control & 0x80) && (control & 0x08)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Emu_Interrupt(void)
+{
+    if (Emu_IEC2.bits.C1IE && Emu_IFS2.bits.C1IF) {
+        syncFifo();
+        _C1Interrupt();
+        return true;
+    }
+    return false;
+}
+
+uint64_t Emu_ReadCycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return Emu_ReadNanoseconds();
+#endif
+}
+
+uint64_t Emu_ReadNanoseconds(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t) t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
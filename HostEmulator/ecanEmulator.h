@@ -0,0 +1,102 @@
+/**
+ * @file   ecanEmulator.h
+ * @date   October, 2026
+ * @brief  Host-side emulation of the dsPIC33F ECAN1 peripheral and its DMA RAM.
+ *
+ * The emulator backs the fake register file declared in HostEmulator/p33fxxxx.h and stands in for
+ * the CAN bus. Frames are injected the way the ECAN module and DMA would deliver them: they're run
+ * through the configured acceptance filters, written into ecan1msgBuf, and flagged in C1RXFUL1 and
+ * C1INTF. Transmission pulls frames back out of the TX buffers whose TXREQ bit is set. Neither ever
+ * calls into the driver directly; Emu_Interrupt() runs _C1Interrupt() only when the interrupt is
+ * both flagged and enabled, like the CPU would.
+ *
+ * This lets ecanFunctions.c compile unmodified for x86:
+ * ```
+ * gcc -I. -IHostEmulator -Wno-pointer-to-int-cast ecanFunctions.c CanMessageBuffer.c \
+ *     CircularBuffer.c MaskedBuffer.c HostEmulator/ecanEmulator.c HostEmulator/ecanBenchmark.c \
+ *     -o ecanBenchmark
+ * ```
+ */
+#ifndef _ECAN_EMULATOR_H_
+#define _ECAN_EMULATOR_H_
+
+#include <p33fxxxx.h>
+#include "ecanFunctions.h"
+
+/**
+ * Return values for Emu_InjectFrame().
+ */
+enum {
+    EMU_RX_ACCEPTED = 0, // The frame was stored into a receive buffer.
+    EMU_RX_FILTERED,     // No enabled acceptance filter matched the frame.
+    EMU_RX_OVERRUN       // The target buffer was still full, so the frame was lost.
+};
+
+/**
+ * The ECAN1 interrupt handler provided by ecanFunctions.c.
+ */
+void _C1Interrupt(void);
+
+/**
+ * Clears the entire register file and DMA RAM, returning the emulator to its power-on state.
+ * Should be called before ecan1_init().
+ */
+void Emu_Reset(void);
+
+/**
+ * Delivers a frame from the bus. The frame is matched against the enabled acceptance filters in
+ * priority order and stored into the buffer the winning filter points to, setting its C1RXFUL bit,
+ * C1INTF.RBIF, C1VEC.ICODE and IFS2.C1IF. If that buffer hasn't been emptied yet its C1RXOVF bit is
+ * set instead. A buffer pointer of 15 selects the FIFO from C1FCTRL.FSA to the last DMA buffer,
+ * which is filled at C1FIFO.FBP and read from C1FIFO.FNRB.
+ * @return One of EMU_RX_ACCEPTED, EMU_RX_FILTERED or EMU_RX_OVERRUN.
+ */
+int Emu_InjectFrame(const tCanMessage *frame);
+
+/**
+ * Puts the highest-priority pending TX buffer on the bus. Its TXREQ bit is cleared and
+ * C1INTF.TBIF, C1VEC.ICODE and IFS2.C1IF are set as the hardware would on completion.
+ * @param frame Where the transmitted frame is decoded to. May be NULL.
+ * @return SUCCESS if a frame was transmitted, STANDARD_ERROR if no TX buffer was pending.
+ */
+int Emu_BusTransmit(tCanMessage *frame);
+
+/**
+ * Returns true if any enabled TX buffer has its TXREQ bit set, meaning the module would start
+ * another frame straight after the current one.
+ */
+bool Emu_TxPending(void);
+
+/**
+ * Runs _C1Interrupt() if the ECAN1 interrupt is both flagged and enabled.
+ * @return True if the interrupt handler was run.
+ */
+bool Emu_Interrupt(void);
+
+/**
+ * Encodes a frame into the 8-word ECAN message buffer layout used in DMA RAM.
+ */
+void Emu_EncodeFrame(const tCanMessage *frame, uint16_t *words);
+
+/**
+ * Decodes an 8-word ECAN message buffer back into a frame.
+ */
+void Emu_DecodeFrame(const uint16_t *words, tCanMessage *frame);
+
+/**
+ * Returns the host memory backing a DMA RAM offset previously handed out by Emu_DmaOffset().
+ */
+void *Emu_DmaAddress(uint16_t offset);
+
+/**
+ * Reads a free-running cycle counter for benchmarking. This is the TSC on x86 and nanoseconds
+ * elsewhere.
+ */
+uint64_t Emu_ReadCycles(void);
+
+/**
+ * Reads a monotonic wall clock in nanoseconds.
+ */
+uint64_t Emu_ReadNanoseconds(void);
+
+#endif /* _ECAN_EMULATOR_H_ */
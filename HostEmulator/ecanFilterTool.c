@@ -0,0 +1,156 @@
+/**
+ * @file   ecanFilterTool.c
+ * @date   October, 2026
+ * @brief  Prints the ecan1_init() filter parameters accepting a list of CAN identifiers.
+ *
+ * Identifiers are given in hexadecimal on the command line. Ones above 0x7FF, or ending in `x`, are
+ * extended. The filter configuration from CFO_Optimize() is printed as initializers for the
+ * parameters array along with how many unwanted identifiers it lets through, then checked by
+ * running it through ecan1_init() on the emulator: every wanted identifier must be received, and
+ * the emulated acceptance filters must agree with CFO_Accepts() on all standard identifiers and on
+ * a sample of extended ones.
+ *
+ * To run from the repository root:
+ * ```
+ * $ gcc -O2 -I. -IHostEmulator -Wno-pointer-to-int-cast ecanFunctions.c CanMessageBuffer.c \
+ *       CanMessageHeap.c CanFilterOptimizer.c HostEmulator/ecanEmulator.c \
+ *       HostEmulator/ecanFilterTool.c -o ecanFilterTool
+ * $ ./ecanFilterTool [-b buffer] 100 101 1A0 18FEF100x ...
+ * ```
+ *
+ * Filters point at buffer 1 unless another is given with -b, where 15 is the FIFO.
+ */
+#include "ecanEmulator.h"
+#include "CanFilterOptimizer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// How many random extended identifiers are checked against the emulator.
+#define TOOL_EXT_SAMPLES 100000UL
+
+/**
+ * Standard frames, normal mode, 1Mbit/s at 40MIPS. Buffers 0, 2 and 3 transmit. The filters are
+ * filled in by CFO_Optimize().
+ */
+static uint16_t toolParameters[53] = {
+    [0] = 0x0101,
+    [1] = 10000,
+    [2] = 40000,
+    [3] = 7 | (4 << 3) | (5 << 6),
+    [13] = 0x0080,
+    [14] = 0x8080
+};
+
+/**
+ * Delivers a frame with the given identifier to the emulator and empties the driver's queue again.
+ * Returns whether the frame was received.
+ */
+static bool receives(uint32_t id)
+{
+    tCanMessage frame;
+    uint8_t messagesLeft;
+    bool received;
+
+    memset(&frame, 0, sizeof(frame));
+    frame.frame_type = (id & CFO_EXT) ? CAN_FRAME_EXT : CAN_FRAME_STD;
+    frame.message_type = CAN_MSG_DATA;
+    frame.id = id & ~CFO_EXT;
+    if (Emu_InjectFrame(&frame) != EMU_RX_ACCEPTED) {
+        return false;
+    }
+    Emu_Interrupt();
+    received = ecan1_receive(&frame, &messagesLeft);
+    return received && frame.id == (id & ~CFO_EXT);
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t ids[CFO_MAX_IDS];
+    uint16_t count = 0;
+    uint32_t unwanted;
+    uint32_t id;
+    uint32_t seed = 1;
+    uint32_t mismatches = 0;
+    uint8_t bufferPointer = 1;
+    uint8_t filters = 0;
+    int i;
+
+    for (i = 1; i < argc; ++i) {
+        char *end;
+
+        if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            bufferPointer = (uint8_t) strtoul(argv[++i], NULL, 0);
+            continue;
+        }
+        if (count == CFO_MAX_IDS) {
+            fprintf(stderr, "At most %d identifiers are supported.\n", CFO_MAX_IDS);
+            return 1;
+        }
+        id = strtoul(argv[i], &end, 16);
+        if (end == argv[i] || (*end && strcmp(end, "x") != 0) || id > 0x1FFFFFFF) {
+            fprintf(stderr, "Invalid identifier: %s\n", argv[i]);
+            return 1;
+        }
+        ids[count++] = (*end == 'x' || id > 0x7FF) ? (id | CFO_EXT) : id;
+    }
+    if (!count) {
+        fprintf(stderr, "Usage: %s [-b buffer] id...\n", argv[0]);
+        return 1;
+    }
+
+    if (!CFO_Optimize(ids, count, bufferPointer, toolParameters, &unwanted)) {
+        fprintf(stderr, "The buffer pointer must be between 0 and 15.\n");
+        return 1;
+    }
+
+    for (i = 4; i <= 52; ++i) {
+        if (i <= 12 || i >= 17) {
+            printf("    [%d] = 0x%04X,\n", i, toolParameters[i]);
+        }
+    }
+    for (i = 0; i < 16; ++i) {
+        filters += (toolParameters[4] >> i) & 1;
+    }
+    printf("%u identifiers, %u filters, %lu unwanted identifiers accepted.\n",
+           count, filters, (unsigned long) unwanted);
+
+    // Check the configuration on the emulator.
+    Emu_Reset();
+    ecan1_init(toolParameters);
+    for (i = 0; i < count; ++i) {
+        if (!receives(ids[i])) {
+            fprintf(stderr, "Wanted identifier %lX isn't received.\n", (unsigned long) ids[i]);
+            ++mismatches;
+        }
+    }
+    for (id = 0; id <= 0x7FF; ++id) {
+        mismatches += receives(id) != (CFO_Accepts(toolParameters, id) >= 0);
+    }
+    for (i = 0; i < count; ++i) {
+        if (ids[i] & CFO_EXT) {
+            break;
+        }
+    }
+    if (i < count) {
+        unsigned long sample;
+        for (sample = 0; sample < TOOL_EXT_SAMPLES; ++sample) {
+            // Half of the sample is near the wanted identifiers, where the filters are decided.
+            seed = seed * 1103515245 + 12345;
+            id = (seed >> 3) & 0x1FFFFFFF;
+            if (sample & 1) {
+                id = (ids[(seed >> 8) % count] ^ (id & 0x300FF)) & 0x1FFFFFFF;
+            }
+            id |= CFO_EXT;
+            mismatches += receives(id) != (CFO_Accepts(toolParameters, id) >= 0);
+        }
+    }
+    if (mismatches) {
+        fprintf(stderr, "%lu identifiers disagree with the emulator.\n", (unsigned long) mismatches);
+        return 1;
+    }
+    printf("Checked against the emulator.\n");
+
+    return 0;
+}
@@ -0,0 +1,432 @@
+/**
+ * @file   ecanSlcanTest.c
+ * @date   October, 2026
+ * @brief  Checks the SLCAN bridge from Examples/MultiReceive on top of the emulator.
+ *
+ * UART2 is replaced by its two queues, which the test fills and drains at the rate of the serial
+ * link. First every command is checked against its exact reply. Then the bus is kept fully loaded
+ * at 1Mbit/s for a simulated second while the host end of the link sends frames as fast as the
+ * UART allows, at 115200 and at 921600 baud. Every line reaching the host must be an intact frame,
+ * in the order received, and every frame the host sends must leave on the bus intact, in order,
+ * and acknowledged. At 115200 baud the bus carries far more than the link can, so most received
+ * frames are dropped by the reception queue, but the bridge must either forward every frame or keep
+ * the link to the host at least 90% busy.
+ *
+ * Add -DECAN1_TX_PRIORITY to test the bridge with the driver's transmission queue in priority
+ * order. Frames from the host then leave by identifier, so only their count and contents are
+ * checked.
+ *
+ * To run from the repository root:
+ * ```
+ * $ gcc -O2 -I. -IHostEmulator -IExamples/MultiReceive -Wno-pointer-to-int-cast ecanFunctions.c \
+ *       CanMessageBuffer.c CanMessageHeap.c MaskedBuffer.c Examples/MultiReceive/slcan.c \
+ *       HostEmulator/ecanEmulator.c HostEmulator/ecanSlcanTest.c -o ecanSlcanTest
+ * $ ./ecanSlcanTest
+ * ```
+ */
+#include "ecanEmulator.h"
+#include "slcan.h"
+#include "uart2.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+// How long each throughput run lasts.
+#define SLCAN_TEST_US 1000000UL
+
+// How often slcanStep() is called, as by a 1ms model step.
+#define SLCAN_TEST_STEP_US 1000
+
+// The stand-in for UART2: the bridge's ends of the link.
+MaskedBuffer uart2RxBuffer;
+static uint8_t rxDataArray[128];
+MaskedBuffer uart2TxBuffer;
+static uint8_t txDataArray[128];
+
+void uart2EnqueueData(unsigned char *data, unsigned char length)
+{
+    MB_WriteMany(&uart2TxBuffer, data, length, false);
+}
+
+/**
+ * Standard frames, normal mode, 1Mbit/s at 40MIPS. Buffers 0, 2 and 3 transmit and filter 0
+ * accepts every frame into buffer 1.
+ */
+static const uint16_t testParameters[53] = {
+    [0] = 0x0101,
+    [1] = 10000,
+    [2] = 40000,
+    [3] = 7 | (4 << 3) | (5 << 6),
+    [4] = 0x0001,
+    [13] = 0x0080,
+    [14] = 0x8080,
+    [17] = 0x0001
+};
+
+// The host's end of the link during a throughput run.
+static char hostLine[SLCAN_MAX_LINE + 1];
+static uint8_t hostLength;
+static uint32_t hostFrames;    // Frames received by the host.
+static uint32_t hostLastSeq;
+static uint32_t hostAcks;      // z and Z replies received by the host.
+static char hostSend[SLCAN_MAX_LINE + 1];
+static uint8_t hostSendLength;
+static uint8_t hostSendNext;
+static uint32_t hostSent;      // Frames sent by the host.
+static uint32_t busSent;       // Frames from the host transmitted on the bus.
+
+/**
+ * Runs the interrupt handler if it's due.
+ */
+static void runInterrupt(void)
+{
+    Emu_Interrupt();
+}
+
+/**
+ * Builds a data frame that carries its sequence number. Odd sequence numbers are extended, and
+ * frames carry between 4 and 8 bytes.
+ */
+static void makeFrame(tCanMessage *msg, uint32_t seq)
+{
+    uint8_t j;
+
+    memset(msg, 0, sizeof(*msg));
+    msg->message_type = CAN_MSG_DATA;
+    if (seq & 1) {
+        msg->frame_type = CAN_FRAME_EXT;
+        msg->id = (seq * 2654435761UL) & 0x1FFFFFFF;
+    } else {
+        msg->frame_type = CAN_FRAME_STD;
+        msg->id = seq & 0x7FF;
+    }
+    msg->validBytes = 4 + seq % 5;
+    memcpy(msg->payload, &seq, sizeof(seq));
+    for (j = 4; j < msg->validBytes; ++j) {
+        msg->payload[j] = (uint8_t) (seq * 7 + j);
+    }
+}
+
+/**
+ * Returns the sequence number of a frame built by makeFrame(), checking that every other field
+ * still matches it.
+ */
+static uint32_t checkFrame(const tCanMessage *msg)
+{
+    tCanMessage expected;
+    uint32_t seq;
+
+    memcpy(&seq, msg->payload, sizeof(seq));
+    makeFrame(&expected, seq);
+    assert(msg->id == expected.id);
+    assert(msg->frame_type == expected.frame_type);
+    assert(msg->message_type == expected.message_type);
+    assert(msg->validBytes == expected.validBytes);
+    assert(memcmp(msg->payload, expected.payload, msg->validBytes) == 0);
+    return seq;
+}
+
+/**
+ * Returns the bits a frame occupies on the bus with worst-case bit stuffing.
+ */
+static uint32_t frameBits(const tCanMessage *msg)
+{
+    uint32_t bits = (msg->frame_type == CAN_FRAME_EXT ? 39 : 19) + 15 + 8 * msg->validBytes;
+
+    return bits + (bits - 1) / 4 + 13;
+}
+
+/**
+ * Sends a command to the bridge, runs it, and checks everything it sends back.
+ */
+static void command(const char *text, const char *expected)
+{
+    char reply[4 * SLCAN_MAX_LINE];
+    uint16_t length;
+
+    assert(MB_WriteMany(&uart2RxBuffer, text, strlen(text), true));
+    slcanStep();
+    length = MB_GetLength(&uart2TxBuffer);
+    assert(length < sizeof(reply));
+    MB_ReadMany(&uart2TxBuffer, reply, length);
+    reply[length] = '\0';
+    if (strcmp(reply, expected) != 0) {
+        printf("\"%s\" was answered with \"%s\".\n", text, reply);
+        assert(false);
+    }
+}
+
+/**
+ * Checks that the next frame on the bus is the given one.
+ */
+static void expectTransmitted(uint32_t id, uint8_t frameType, uint8_t messageType, uint8_t validBytes,
+                              const uint8_t *payload)
+{
+    tCanMessage frame;
+
+    assert(Emu_BusTransmit(&frame));
+    runInterrupt();
+    assert(frame.id == id);
+    assert(frame.frame_type == frameType);
+    assert(frame.message_type == messageType);
+    assert(frame.validBytes == validBytes);
+    if (messageType == CAN_MSG_DATA) {
+        assert(memcmp(frame.payload, payload, validBytes) == 0);
+    }
+}
+
+/**
+ * Delivers a frame from the bus.
+ */
+static void receive(uint32_t id, uint8_t frameType, uint8_t messageType, uint8_t validBytes,
+                    const uint8_t *payload)
+{
+    tCanMessage frame;
+
+    memset(&frame, 0, sizeof(frame));
+    frame.id = id;
+    frame.frame_type = frameType;
+    frame.message_type = messageType;
+    frame.validBytes = validBytes;
+    memcpy(frame.payload, payload, validBytes);
+    assert(Emu_InjectFrame(&frame) == EMU_RX_ACCEPTED);
+    runInterrupt();
+}
+
+/**
+ * Checks every command against its exact reply.
+ */
+static void testCommands(void)
+{
+    static const uint8_t data[8] = {0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77};
+    static const uint8_t mixed[2] = {0xA0, 0xB1};
+    char overlong[40];
+    tCanMessage msg;
+    uint8_t messagesLeft;
+
+    command("V\r", "V0100\r");
+    command("N\r", "N0000\r");
+    command("F\r", "F00\r");
+    command("\r", "\r");
+    command("X\r", "\a");
+
+    // Frames can't be sent while the channel is closed, and the bit rate can't be changed while
+    // it's open.
+    command("t1231AB\r", "\a");
+    command("S6\r", "\r");
+    command("S9\r", "\a");
+    command("O\r", "\r");
+    command("O\r", "\a");
+    command("S6\r", "\a");
+
+    // Sending frames, with hexadecimal in either case and CR LF line endings.
+    command("t1232a0B1\r", "z\r");
+    expectTransmitted(0x123, CAN_FRAME_STD, CAN_MSG_DATA, 2, mixed);
+    command("T1ABCDEF080011223344556677\r\n", "Z\r");
+    expectTransmitted(0x1ABCDEF0, CAN_FRAME_EXT, CAN_MSG_DATA, 8, data);
+    command("r7FF3\r", "z\r");
+    expectTransmitted(0x7FF, CAN_FRAME_STD, CAN_MSG_RTR, 3, NULL);
+    command("R000000010\r", "Z\r");
+    expectTransmitted(0x1, CAN_FRAME_EXT, CAN_MSG_RTR, 0, NULL);
+    command("t0000\r", "z\r");
+    expectTransmitted(0x0, CAN_FRAME_STD, CAN_MSG_DATA, 0, NULL);
+
+    // A command can arrive over several steps.
+    command("t12", "");
+    command("31CD\r", "z\r");
+    expectTransmitted(0x123, CAN_FRAME_STD, CAN_MSG_DATA, 1, (const uint8_t *) "\xCD");
+
+    // Malformed frames.
+    command("t8001\r", "\a");
+    command("t12320\r", "\a");
+    command("t1231G0\r", "\a");
+    command("t1239\r", "\a");
+    command("T200000000\r", "\a");
+    command("r1231AB\r", "\a");
+    command("t\r", "\a");
+    memset(overlong, 'A', sizeof(overlong));
+    overlong[0] = 't';
+    overlong[sizeof(overlong) - 2] = '\r';
+    overlong[sizeof(overlong) - 1] = '\0';
+    command(overlong, "\a");
+    command("t1230\r", "z\r");
+    expectTransmitted(0x123, CAN_FRAME_STD, CAN_MSG_DATA, 0, NULL);
+    assert(!Emu_TxPending());
+
+    // Received frames are forwarded while the channel is open, in listen-only mode too.
+    receive(0x456, CAN_FRAME_STD, CAN_MSG_DATA, 3, data + 1);
+    receive(0x18FEF100, CAN_FRAME_EXT, CAN_MSG_DATA, 8, data);
+    receive(0x18FEF100, CAN_FRAME_EXT, CAN_MSG_RTR, 2, data);
+    receive(0x7FF, CAN_FRAME_STD, CAN_MSG_RTR, 0, data);
+    command("", "t4563112233\rT18FEF10080011223344556677\rR18FEF1002\rr7FF0\r");
+    command("C\r", "\r");
+    command("L\r", "\r");
+    command("t1230\r", "\a");
+    receive(0x001, CAN_FRAME_STD, CAN_MSG_DATA, 1, data + 7);
+    command("", "t001177\r");
+    command("C\r", "\r");
+    receive(0x002, CAN_FRAME_STD, CAN_MSG_DATA, 0, data);
+    command("", "");
+    assert(ecan1_receive(&msg, &messagesLeft) && msg.id == 0x002);
+
+    printf("Commands checked.\n");
+}
+
+/**
+ * Handles a byte reaching the host, checking each line once it's complete.
+ */
+static void hostReceive(uint8_t c)
+{
+    tCanMessage msg;
+    uint32_t seq;
+
+    assert(c != '\a');
+    if (c != '\r') {
+        assert(hostLength < SLCAN_MAX_LINE);
+        hostLine[hostLength++] = (char) c;
+        return;
+    }
+    if (hostLength == 1 && (hostLine[0] == 'z' || hostLine[0] == 'Z')) {
+        ++hostAcks;
+    } else {
+        assert(slcanDecode(hostLine, hostLength, &msg));
+        seq = checkFrame(&msg);
+        assert(hostFrames == 0 || seq > hostLastSeq);
+        hostLastSeq = seq;
+        ++hostFrames;
+    }
+    hostLength = 0;
+}
+
+/**
+ * Returns the next byte the host sends, which are the lines of frames built by makeFrame() with
+ * sequence numbers from 0x80000000 up.
+ */
+static uint8_t hostNextByte(void)
+{
+    tCanMessage msg;
+    uint8_t i;
+
+    if (hostSendNext == hostSendLength) {
+        makeFrame(&msg, 0x80000000UL + hostSent++);
+        if (msg.frame_type == CAN_FRAME_EXT) {
+            hostSendLength = (uint8_t) sprintf(hostSend, "T%08lX%u", (unsigned long) msg.id, msg.validBytes);
+        } else {
+            hostSendLength = (uint8_t) sprintf(hostSend, "t%03lX%u", (unsigned long) msg.id, msg.validBytes);
+        }
+        for (i = 0; i < msg.validBytes; ++i) {
+            hostSendLength += (uint8_t) sprintf(&hostSend[hostSendLength], "%02x", msg.payload[i]);
+        }
+        hostSend[hostSendLength++] = '\r';
+        hostSendNext = 0;
+    }
+    return (uint8_t) hostSend[hostSendNext++];
+}
+
+/**
+ * Keeps the bus fully loaded and the link to the host busy in both directions for SLCAN_TEST_US,
+ * then lets everything the host sent drain out onto the bus.
+ */
+static void testThroughput(uint32_t baud)
+{
+    const uint64_t byteNs = 10000000000ULL / baud;
+    const uint64_t endNs = SLCAN_TEST_US * 1000ULL;
+    uint64_t now;
+    uint64_t busFree = 0;
+    uint64_t toHost = 0;
+    uint64_t fromHost = 0;
+    uint64_t stepNs = 0;
+    uint32_t rxSeq = 0;
+    uint32_t steps = 0;
+    uint32_t linkBytes = 0;
+    tCanMessage frame;
+    uint8_t c;
+
+    Emu_Reset();
+    ecan1_init(testParameters);
+    MB_INIT(&uart2RxBuffer, rxDataArray);
+    MB_INIT(&uart2TxBuffer, txDataArray);
+    slcanInit();
+    command("O\r", "\r");
+    hostLength = 0;
+    hostFrames = hostAcks = 0;
+    hostSent = busSent = 0;
+    hostSendLength = hostSendNext = 0;
+
+    for (now = 0; now < endNs || hostAcks < hostSent || MB_GetLength(&uart2TxBuffer); now += 1000) {
+        // The bus, which gives queued frames priority and is never idle until the end.
+        if (now >= busFree) {
+            if (Emu_BusTransmit(&frame)) {
+#ifdef ECAN1_TX_PRIORITY
+                checkFrame(&frame);
+#else
+                assert(checkFrame(&frame) == 0x80000000UL + busSent);
+#endif
+                ++busSent;
+                busFree = now + 1000ULL * frameBits(&frame);
+                runInterrupt();
+            } else if (now < endNs) {
+                makeFrame(&frame, rxSeq++);
+                Emu_InjectFrame(&frame);
+                busFree = now + 1000ULL * frameBits(&frame);
+                runInterrupt();
+            }
+        }
+
+        // The link in both directions. The host only sends whole lines before the end.
+        while (toHost <= now) {
+            if (MB_ReadByte(&uart2TxBuffer, &c)) {
+                hostReceive(c);
+                if (toHost < endNs) {
+                    ++linkBytes;
+                }
+                toHost += byteNs;
+            } else {
+                toHost = now + 1000;
+            }
+        }
+        while (fromHost <= now) {
+            if (now < endNs || hostSendNext != hostSendLength) {
+                assert(MB_WriteByte(&uart2RxBuffer, hostNextByte()));
+                fromHost += byteNs;
+            } else {
+                fromHost = now + 1000;
+            }
+        }
+
+        if (now % (SLCAN_TEST_STEP_US * 1000ULL) == 0) {
+            uint64_t start = Emu_ReadNanoseconds();
+            slcanStep();
+            stepNs += Emu_ReadNanoseconds() - start;
+            ++steps;
+        }
+    }
+
+    printf("%lu baud: %lu of %lu bus frames forwarded, %lu frames sent by the host, %.1f%% of the "
+           "link used, %.0fns per step.\n", (unsigned long) baud, (unsigned long) hostFrames,
+           (unsigned long) rxSeq, (unsigned long) hostSent,
+           100.0 * linkBytes * byteNs / endNs, (double) stepNs / steps);
+    assert(hostAcks == hostSent);
+    assert(busSent == hostSent);
+    assert(hostFrames == rxSeq || linkBytes * byteNs >= endNs * 9 / 10);
+}
+
+int main()
+{
+    printf("Running unit tests.\n");
+
+    Emu_Reset();
+    ecan1_init(testParameters);
+    MB_INIT(&uart2RxBuffer, rxDataArray);
+    MB_INIT(&uart2TxBuffer, txDataArray);
+    slcanInit();
+    testCommands();
+
+    testThroughput(115200);
+    testThroughput(921600);
+
+    printf("All tests passed.\n");
+
+    return 0;
+}
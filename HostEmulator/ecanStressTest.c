@@ -0,0 +1,666 @@
+/**
+ * @file   ecanStressTest.c
+ * @date   October, 2026
+ * @brief  Checks the ECAN1 driver's interrupt/main-loop handoff under asynchronous interrupts.
+ *
+ * A periodic SIGALRM plays the part of the CAN bus and the CPU's interrupt controller. Every tick
+ * delivers a sequence-numbered frame, completes the pending transmission, and runs _C1Interrupt()
+ * through the emulator, landing at whatever instruction the main loop happens to be executing. The
+ * main loop meanwhile calls the reception and buffered transmission functions without ever masking
+ * interrupts. The test checks that every frame arrives intact and in order unless the reception
+ * queue was full, that transmissions leave in the order they were queued, and that the
+ * transmission chain never stalls.
+ *
+ * To run from the repository root:
+ * ```
+ * $ gcc -O2 -I. -IHostEmulator -Wno-pointer-to-int-cast ecanFunctions.c CanMessageBuffer.c \
+ *       CanMessageHeap.c HostEmulator/ecanEmulator.c HostEmulator/ecanStressTest.c -o ecanStressTest
+ * $ ./ecanStressTest
+ * ```
+ *
+ * Add -DECAN1_TX_PRIORITY to test the driver with its transmission queue in priority order. Frames
+ * then leave by identifier rather than in the order they were queued, so only their count and
+ * contents are checked. Add for example -DECAN1_DMA_BUFFERS=32 -DECAN1_FIFO_START=8 to receive
+ * through the FIFO, and -DECAN1_RX_RAW to have received frames decoded in the main loop. With
+ * -DECAN1_MAILBOXES=4 a few identifiers go to mailboxes instead, which the main loop polls. With
+ * -DECAN1_STATS the driver's statistics are checked against the test's own counts, and with
+ * -DECAN1_BUS_LOAD the bus load estimate is checked for a known set of frames. With for example
+ * -DECAN1_TRACE=64, or any size of at least 8, the main loop reads the trace as it's recorded, and
+ * freezing it on a trigger frame is checked at the end.
+ */
+#define _DEFAULT_SOURCE
+
+#include "ecanEmulator.h"
+
+#include <assert.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+// How many interrupts are fired over the course of the test.
+#define STRESS_TICKS 200000UL
+
+// The period between interrupts.
+#define STRESS_PERIOD_US 15
+
+// The most frames pulled out by each call to ecan1_receive_many().
+#define STRESS_BATCH 5
+
+// Driver state that the test inspects.
+extern CanMessageBuffer ecan1_rx_buffer;
+extern CanMessageBuffer ecan1_tx_buffer;
+extern volatile unsigned char currentlyTransmitting;
+#ifdef ECAN1_TX_PRIORITY
+extern CanMessageHeap ecan1_tx_heap;
+#endif
+
+/**
+ * Standard frames, normal mode, 1Mbit/s at 40MIPS. Buffers 0, 2 and 3 transmit, buffer 0 with a
+ * TXnPRI of 1, and filter 0 accepts every frame into buffer 1 or the FIFO.
+ */
+static const uint16_t stressParameters[53] = {
+    [0] = 0x0101,
+    [1] = 10000,
+    [2] = 40000,
+    [3] = 7 | (4 << 3) | (5 << 6),
+    [4] = 0x0001,
+    [13] = 0x0081,
+    [14] = 0x8080,
+#ifdef ECAN1_FIFO_START
+    [17] = 0x000F
+#else
+    [17] = 0x0001
+#endif
+};
+
+#ifdef ECAN1_MAILBOXES
+// Standard identifiers given a mailbox. makeFrame() only gives them to even sequence numbers.
+static const uint32_t stressMailboxIds[ECAN1_MAILBOXES] = {0x010, 0x012, 0x014, 0x016};
+
+// The sequence number last read from each mailbox.
+static uint32_t mailboxSeq[ECAN1_MAILBOXES];
+
+// The frames received into the mailboxes.
+static uint32_t mailboxUpdates;
+#endif
+
+#ifdef ECAN1_TRACE
+// The trace records read by the main loop in each direction, and the last timestamp read.
+static uint32_t traceRx;
+static uint32_t traceTx;
+static uint32_t traceLastTime;
+#endif
+
+// State owned by the interrupt side.
+static volatile uint32_t rxInjected;
+static volatile uint32_t rxDropped;
+static volatile uint32_t txOnBus;
+static volatile uint32_t txOutOfOrder;
+static volatile uint32_t ticks;
+static volatile uint32_t interrupts;
+
+/**
+ * Returns the number of frames queued for transmission but not yet loaded into a TX buffer.
+ */
+static uint16_t txQueueLength(void)
+{
+#ifdef ECAN1_TX_PRIORITY
+    return CMH_GetLength(&ecan1_tx_heap);
+#else
+    return CMB_GetLength(&ecan1_tx_buffer);
+#endif
+}
+
+/**
+ * Runs the interrupt handler if it's due, counting how often it runs.
+ */
+static void runInterrupt(void)
+{
+    if (Emu_Interrupt()) {
+        ++interrupts;
+    }
+}
+
+/**
+ * Builds a frame that carries its sequence number and can be checked for corruption on arrival.
+ * Every fifth frame is a remote transmit request, and frames carry between 4 and 8 bytes.
+ */
+static void makeFrame(tCanMessage *msg, uint32_t seq)
+{
+    uint8_t j;
+
+    msg->buffer = 0;
+    msg->message_type = (seq % 5 == 0) ? CAN_MSG_RTR : CAN_MSG_DATA;
+    if (seq & 1) {
+        msg->frame_type = CAN_FRAME_EXT;
+        msg->id = (seq * 2654435761UL) & 0x1FFFFFFF;
+    } else {
+        msg->frame_type = CAN_FRAME_STD;
+        msg->id = seq & 0x7FF;
+    }
+    msg->validBytes = 4 + seq % 5;
+    memcpy(msg->payload, &seq, sizeof(seq));
+    for (j = 4; j < 8; ++j) {
+        msg->payload[j] = (j < msg->validBytes) ? (uint8_t) (seq * 7 + j) : 0xA5;
+    }
+}
+
+/**
+ * Returns the sequence number of a frame built by makeFrame(), checking that every other field
+ * still matches it.
+ */
+static uint32_t checkFrame(const tCanMessage *msg)
+{
+    tCanMessage expected;
+    uint32_t seq;
+    uint8_t j;
+
+    memcpy(&seq, msg->payload, sizeof(seq));
+    makeFrame(&expected, seq);
+    assert(msg->id == expected.id);
+    assert(msg->frame_type == expected.frame_type);
+    assert(msg->message_type == expected.message_type);
+    assert(msg->validBytes == expected.validBytes);
+    assert(memcmp(msg->payload, expected.payload, msg->validBytes) == 0);
+
+    // The junk makeFrame() leaves past validBytes must have been zeroed.
+    for (j = msg->validBytes; j < 8; ++j) {
+        assert(msg->payload[j] == 0);
+    }
+
+    return seq;
+}
+
+/**
+ * Checks a received frame like checkFrame(), along with the receive buffer it was read from.
+ */
+static uint32_t checkReceived(const tCanMessage *msg)
+{
+#ifdef ECAN1_FIFO_START
+    assert(msg->buffer >= ECAN1_FIFO_START && msg->buffer < ECAN1_DMA_BUFFERS);
+#else
+    assert(msg->buffer == 1);
+#endif
+    return checkFrame(msg);
+}
+
+/**
+ * Checks that a transmitted frame is intact and, unless the queue is in priority order, that it's
+ * the next one queued.
+ */
+static void checkTransmitted(const tCanMessage *frame)
+{
+    uint32_t seq = checkFrame(frame);
+
+#ifndef ECAN1_TX_PRIORITY
+    if (seq != txOnBus) {
+        ++txOutOfOrder;
+    }
+#else
+    (void) seq;
+#endif
+    ++txOnBus;
+}
+
+#ifdef ECAN1_BUS_LOAD
+/**
+ * Returns the bits a frame occupies on the bus with worst-case bit stuffing, counting everything
+ * from the start of frame through the interframe space.
+ */
+static uint32_t frameBits(const tCanMessage *msg)
+{
+    // The stuffed bits: the arbitration and control fields, the data and the CRC.
+    uint32_t bits = (msg->frame_type == CAN_FRAME_EXT ? 39 : 19) + 15;
+
+    if (msg->message_type != CAN_MSG_RTR) {
+        bits += 8 * msg->validBytes;
+    }
+    return bits + (bits - 1) / 4 + 13;
+}
+#endif
+
+/**
+ * Returns whether a frame goes to a mailbox rather than the reception queue.
+ */
+static bool hasMailbox(const tCanMessage *msg)
+{
+#ifdef ECAN1_MAILBOXES
+    uint8_t i;
+
+    for (i = 0; i < ECAN1_MAILBOXES; ++i) {
+        if (msg->frame_type == CAN_FRAME_STD && msg->id == stressMailboxIds[i]) {
+            return true;
+        }
+    }
+#else
+    (void) msg;
+#endif
+    return false;
+}
+
+#ifdef ECAN1_MAILBOXES
+/**
+ * Reads every mailbox, checking that each holds an intact frame no older than the last one read
+ * from it.
+ */
+static void readMailboxes(void)
+{
+    tCanMessage msg;
+    uint16_t updates;
+    uint8_t i;
+
+    for (i = 0; i < ECAN1_MAILBOXES; ++i) {
+        if (ecan1_mailbox_read(stressMailboxIds[i], &msg, &updates)) {
+            uint32_t seq = checkReceived(&msg);
+            assert(msg.id == stressMailboxIds[i]);
+            assert(updates ? seq > mailboxSeq[i] : seq == mailboxSeq[i]);
+            mailboxSeq[i] = seq;
+            mailboxUpdates += updates;
+        }
+    }
+}
+#endif
+
+#ifdef ECAN1_TRACE
+/**
+ * Sets the 32-bit timer the trace timestamps are read from.
+ */
+static void setTime(uint32_t time)
+{
+    TMR3 = (uint16_t) (time >> 16);
+    TMR2 = (uint16_t) time;
+}
+
+/**
+ * Reads a batch of trace records, checking that each holds an intact frame and that they're in
+ * order.
+ */
+static void readTrace(void)
+{
+    tEcan1TraceRecord records[STRESS_BATCH];
+    tCanMessage msg;
+    uint16_t count;
+    uint16_t i;
+
+    count = ecan1_trace_read(records, STRESS_BATCH);
+    assert(count <= STRESS_BATCH);
+    for (i = 0; i < count; ++i) {
+        CMB_Unpack(&msg, &records[i].frame);
+        checkFrame(&msg);
+        assert((records[i].stamp & ECAN1_TRACE_TIME_MASK) >= traceLastTime);
+        traceLastTime = records[i].stamp & ECAN1_TRACE_TIME_MASK;
+        if (records[i].stamp & ECAN1_TRACE_TX) {
+            ++traceTx;
+        } else {
+            ++traceRx;
+        }
+    }
+}
+#endif
+
+/**
+ * One bus event per tick in each direction, with the interrupt handler run after each like the CPU
+ * would.
+ */
+static void onTick(int signal)
+{
+    tCanMessage frame;
+
+    (void) signal;
+
+    if (ticks >= STRESS_TICKS) {
+        return;
+    }
+
+    // While the main loop holds off the ECAN1 interrupt, keep the bus quiet so that no frame is
+    // lost to a buffer the interrupt handler hasn't been able to empty.
+    if (!IEC2bits.C1IE) {
+        return;
+    }
+    ++ticks;
+#ifdef ECAN1_TRACE
+    setTime(ticks);
+#endif
+
+    // The driver drops a frame exactly when its reception queue is already full.
+    makeFrame(&frame, rxInjected++);
+    if (!hasMailbox(&frame) && CMB_GetLength(&ecan1_rx_buffer) > ecan1_rx_buffer.mask) {
+        ++rxDropped;
+    }
+    assert(Emu_InjectFrame(&frame) == EMU_RX_ACCEPTED);
+    runInterrupt();
+
+    if (Emu_BusTransmit(&frame)) {
+        checkTransmitted(&frame);
+        runInterrupt();
+    }
+}
+
+int main()
+{
+    struct itimerval timer = {{0, STRESS_PERIOD_US}, {0, STRESS_PERIOD_US}};
+    struct itimerval stop = {{0, 0}, {0, 0}};
+    tCanMessage msg;
+    tCanMessage batch[STRESS_BATCH];
+    uint8_t count;
+    uint8_t i;
+    uint8_t messagesLeft;
+    uint32_t received = 0;
+    uint32_t lastSeq = 0;
+    uint32_t txQueued = 0;
+
+    printf("Running unit tests.\n");
+
+    Emu_Reset();
+    ecan1_init(stressParameters);
+#ifdef ECAN1_MAILBOXES
+    assert(ecan1_mailbox_set(stressMailboxIds, ECAN1_MAILBOXES));
+#endif
+
+    signal(SIGALRM, onTick);
+    setitimer(ITIMER_REAL, &timer, NULL);
+
+    while (ticks < STRESS_TICKS) {
+        // Alternate between receiving one frame and receiving a batch.
+        if (ecan1_receive(&msg, &messagesLeft)) {
+            uint32_t seq = checkReceived(&msg);
+            assert(received == 0 || seq > lastSeq);
+            lastSeq = seq;
+            ++received;
+        }
+        count = ecan1_receive_many(batch, STRESS_BATCH);
+        assert(count <= STRESS_BATCH);
+        for (i = 0; i < count; ++i) {
+            uint32_t seq = checkReceived(&batch[i]);
+            assert(received == 0 || seq > lastSeq);
+            lastSeq = seq;
+            ++received;
+        }
+#ifdef ECAN1_MAILBOXES
+        readMailboxes();
+#endif
+#ifdef ECAN1_TRACE
+        readTrace();
+#endif
+
+        // Queue short bursts of transmissions once the previous one has drained, so that the
+        // transmission chain is regularly restarted from here as well as continued by the
+        // interrupt handler.
+        // Single frames and batches are queued alternately.
+        if (txQueueLength() == 0) {
+            count = 1 + (txQueued % STRESS_BATCH);
+            if (count == 1) {
+                makeFrame(&msg, txQueued++);
+                ecan1_buffered_transmit(&msg);
+            } else {
+                for (i = 0; i < count; ++i) {
+                    makeFrame(&batch[i], txQueued++);
+                }
+                assert(ecan1_buffered_transmit_many(batch, count) == count);
+            }
+        }
+    }
+
+    setitimer(ITIMER_REAL, &stop, NULL);
+
+    // Top up the reception queue so that the final drain takes several batches.
+    while (CMB_GetLength(&ecan1_rx_buffer) <= ecan1_rx_buffer.mask) {
+        makeFrame(&msg, rxInjected++);
+        Emu_InjectFrame(&msg);
+        runInterrupt();
+    }
+
+    // Drain whatever is left in both directions, checking the MATLAB batch format along the way.
+    do {
+        uint32_t output[4 * ECAN1_RECEIVE_MANY_SIZE + 1];
+        uint16_t left = CMB_GetLength(&ecan1_rx_buffer);
+
+        ecan1_receive_many_matlab(output);
+        count = output[4 * ECAN1_RECEIVE_MANY_SIZE];
+        assert(count == (left < ECAN1_RECEIVE_MANY_SIZE ? left : ECAN1_RECEIVE_MANY_SIZE));
+        for (i = 0; i < ECAN1_RECEIVE_MANY_SIZE; ++i) {
+            if (i < count) {
+                uint32_t seq = output[i + ECAN1_RECEIVE_MANY_SIZE];
+                makeFrame(&msg, seq);
+                assert(received == 0 || seq > lastSeq);
+                assert(output[i] == msg.id);
+                assert((output[i + 3 * ECAN1_RECEIVE_MANY_SIZE] & 0xFF) == msg.validBytes);
+                assert(((output[i + 3 * ECAN1_RECEIVE_MANY_SIZE] >> 8) & 1) == (msg.message_type == CAN_MSG_RTR));
+                assert((output[i + 3 * ECAN1_RECEIVE_MANY_SIZE] >> 16) == (uint32_t) (left - i));
+                lastSeq = seq;
+                ++received;
+            } else {
+                assert(output[i] == 0 && output[i + 3 * ECAN1_RECEIVE_MANY_SIZE] == 0);
+            }
+        }
+    } while (count);
+    while (Emu_BusTransmit(&msg)) {
+        checkTransmitted(&msg);
+        runInterrupt();
+    }
+
+    // Finally queue a batch in the MATLAB format and check that it's sent unchanged.
+    {
+        uint16_t data[8 * ECAN1_TRANSMIT_MANY_SIZE + 1];
+        const uint16_t n = ECAN1_TRANSMIT_MANY_SIZE;
+
+        for (i = 0; i < n; ++i) {
+            makeFrame(&msg, txQueued++);
+            data[i] = (uint16_t) (msg.validBytes << 8);
+            data[i + n] = (uint16_t) msg.id;
+            data[i + 2 * n] = (uint16_t) (msg.id >> 16);
+            data[i + 3 * n] = (uint16_t) ((msg.message_type == CAN_MSG_RTR) << 8 | (msg.frame_type == CAN_FRAME_EXT));
+            data[i + 4 * n] = (uint16_t) (msg.payload[1] << 8 | msg.payload[0]);
+            data[i + 5 * n] = (uint16_t) (msg.payload[3] << 8 | msg.payload[2]);
+            data[i + 6 * n] = (uint16_t) (msg.payload[5] << 8 | msg.payload[4]);
+            data[i + 7 * n] = (uint16_t) (msg.payload[7] << 8 | msg.payload[6]);
+        }
+        data[8 * n] = n;
+        ecan1_buffered_transmit_many_matlab(data);
+
+        // The first frame is taken out of the queue as soon as it's loaded into a TX buffer.
+        assert(txQueueLength() == n - 1);
+        assert(Emu_TxPending());
+    }
+    while (Emu_BusTransmit(&msg)) {
+        checkTransmitted(&msg);
+        runInterrupt();
+    }
+
+    // Send a frame directly from buffer 0 while the queue is also being sent. The queue has to
+    // keep clear of buffer 0 until that frame has left, and it must leave with buffer 0's TXnPRI.
+    // Buffer 3 holds the first queued frame, so it can't be used for a direct send until that has
+    // left, and neither can buffer 0 again until its own frame has.
+    {
+        const uint32_t directSeq = 0xD1EC7;
+        uint8_t directSent = 0;
+
+        makeFrame(&msg, txQueued++);
+        ecan1_buffered_transmit(&msg);
+        makeFrame(&msg, directSeq);
+        msg.buffer = 3;
+        assert(!ecan1_transmit(&msg));
+        msg.buffer = 0;
+        assert(ecan1_transmit(&msg));
+        assert(!ecan1_transmit(&msg));
+        assert((C1TR01CON & 0x000B) == 0x0009);
+        assert(currentlyTransmitting);
+        for (i = 0; i < STRESS_BATCH; ++i) {
+            makeFrame(&msg, txQueued++);
+            ecan1_buffered_transmit(&msg);
+        }
+        while (Emu_BusTransmit(&msg)) {
+            if (checkFrame(&msg) == directSeq) {
+                ++directSent;
+            } else {
+                checkTransmitted(&msg);
+            }
+            runInterrupt();
+        }
+        assert(directSent == 1);
+
+        // Once everything has left, buffer 3 is free again.
+        makeFrame(&msg, directSeq);
+        msg.buffer = 3;
+        assert(ecan1_transmit(&msg));
+        assert(Emu_BusTransmit(&msg) && checkFrame(&msg) == directSeq);
+        runInterrupt();
+        assert(!Emu_TxPending());
+    }
+
+#ifdef ECAN1_MAILBOXES
+    readMailboxes();
+    printf("%lu frames received into mailboxes.\n", (unsigned long) mailboxUpdates);
+    received += mailboxUpdates;
+#endif
+    printf("%lu frames received, %lu dropped, %lu transmitted.\n",
+           (unsigned long) received, (unsigned long) rxDropped, (unsigned long) txOnBus);
+
+    assert(received + rxDropped == rxInjected);
+    assert(txOutOfOrder == 0);
+    assert(txOnBus == txQueued);
+    assert(txQueueLength() == 0);
+    assert(!currentlyTransmitting);
+
+#ifdef ECAN1_STATS
+    {
+        tEcan1Stats stats;
+        uint32_t output[ECAN1_STATS_MATLAB_SIZE];
+        uint16_t stored = 0;
+
+        assert(ecan1_stats_get(&stats));
+        assert(stats.isrCount == interrupts);
+        assert(stats.isrMinCycles <= stats.isrAverageCycles && stats.isrAverageCycles <= stats.isrMaxCycles);
+        assert(stats.rxHighWatermark == ecan1_rx_buffer.mask + 1);
+        assert(stats.txHighWatermark == ECAN1_TRANSMIT_MANY_SIZE);
+        assert(stats.rxDropped == rxDropped);
+        assert(stats.rxOverflowed == 0);
+        assert(stats.txDropped == 0);
+        assert(stats.txCompleted == txOnBus);
+
+        ecan1_stats_matlab(output);
+        assert(output[0] == stats.isrCount && output[6] == stats.rxDropped && output[9] == stats.txCompleted);
+
+        // Overrun a receive buffer before the interrupt handler can empty it. The FIFO can hold
+        // more frames than the empty reception buffer, which drops the rest.
+        ecan1_stats_reset();
+        for (i = 0; i <= ECAN1_DMA_BUFFERS; ++i) {
+            makeFrame(&msg, rxInjected++);
+            if (Emu_InjectFrame(&msg) == EMU_RX_OVERRUN) {
+                break;
+            }
+            ++stored;
+        }
+        runInterrupt();
+        assert(ecan1_stats_get(&stats));
+        assert(stats.isrCount == 1);
+        assert(stats.rxOverflowed == 1);
+        assert(stats.rxDropped == (stored > ecan1_rx_buffer.mask + 1 ? stored - ecan1_rx_buffer.mask - 1U : 0U));
+        assert(C1RXOVF1 == 0 && C1RXOVF2 == 0);
+        printf("Statistics match.\n");
+    }
+#endif
+
+#ifdef ECAN1_BUS_LOAD
+    {
+        uint32_t bits = 0;
+
+        // Push everything so far out of the window, then count a few frames in each direction
+        // within one period. At 1Mbit/s each period carries ECAN1_BUS_LOAD_PERIOD_US bits.
+        for (i = 0; i < ECAN1_BUS_LOAD_WINDOW + 1; ++i) {
+            ecan1_bus_load_update();
+        }
+        assert(ecan1_bus_load() == 0);
+        for (i = 0; i < 5; ++i) {
+            makeFrame(&msg, rxInjected++);
+            assert(Emu_InjectFrame(&msg) == EMU_RX_ACCEPTED);
+            runInterrupt();
+            bits += frameBits(&msg);
+        }
+        for (i = 0; i < 3; ++i) {
+            makeFrame(&msg, txQueued++);
+            ecan1_buffered_transmit(&msg);
+            bits += frameBits(&msg);
+        }
+        while (Emu_BusTransmit(&msg)) {
+            checkTransmitted(&msg);
+            runInterrupt();
+        }
+        ecan1_bus_load_update();
+        assert(ecan1_bus_load() == bits * 10000 / ((uint32_t) ECAN1_BUS_LOAD_PERIOD_US * ECAN1_BUS_LOAD_WINDOW));
+        printf("Bus load %u.%02u%% for %lu bits.\n", ecan1_bus_load() / 100, ecan1_bus_load() % 100,
+               (unsigned long) bits);
+    }
+#endif
+
+#ifdef ECAN1_TRACE
+    {
+        tEcan1TraceRecord records[ECAN1_TRACE];
+        uint32_t first;
+        uint16_t count;
+        uint16_t n;
+
+        assert(ecan1_trace_state() == ECAN1_TRACE_RUNNING);
+        printf("%lu frames received and %lu transmitted read from the trace.\n",
+               (unsigned long) traceRx, (unsigned long) traceTx);
+        assert(traceRx > 0 && traceTx > 0);
+
+        // Overrun the trace. Only the newest frames are kept.
+        ecan1_trace_start();
+        first = rxInjected;
+        for (n = 0; n < ECAN1_TRACE + 3; ++n) {
+            makeFrame(&msg, rxInjected++);
+            Emu_InjectFrame(&msg);
+            runInterrupt();
+        }
+        assert(ecan1_trace_read(records, ECAN1_TRACE) == ECAN1_TRACE);
+        assert(ecan1_trace_read(records, 1) == 0);
+        CMB_Unpack(&msg, &records[0].frame);
+        assert(checkFrame(&msg) == first + 3);
+
+        // Freeze two frames after the fourth of ten.
+        first = rxInjected;
+        makeFrame(&msg, first + 3);
+        ecan1_trace_trigger(msg.frame_type == CAN_FRAME_EXT ? ECAN1_FILTER_EXT(msg.id) : msg.id,
+                            CMB_PACKED_ID | CMB_PACKED_EXT, 2);
+        assert(ecan1_trace_state() == ECAN1_TRACE_ARMED);
+        for (i = 0; i < 10; ++i) {
+            setTime(0x80000000UL + i);
+            makeFrame(&msg, rxInjected++);
+            Emu_InjectFrame(&msg);
+            runInterrupt();
+            assert(ecan1_trace_state() == (i < 3 ? ECAN1_TRACE_ARMED : i < 5 ? ECAN1_TRACE_TRIGGERED : ECAN1_TRACE_FROZEN));
+        }
+        count = ecan1_trace_read(records, ECAN1_TRACE);
+        assert(count == 6);
+        for (i = 0; i < count; ++i) {
+            CMB_Unpack(&msg, &records[i].frame);
+            assert(checkFrame(&msg) == first + i);
+            assert(records[i].stamp == i);
+        }
+
+        // Transmitted frames are recorded once they've left.
+        ecan1_trace_start();
+        makeFrame(&msg, txQueued++);
+        ecan1_buffered_transmit(&msg);
+        assert(ecan1_trace_read(records, 1) == 0);
+        while (Emu_BusTransmit(&msg)) {
+            checkTransmitted(&msg);
+            runInterrupt();
+        }
+        assert(ecan1_trace_read(records, ECAN1_TRACE) == 1);
+        assert(records[0].stamp & ECAN1_TRACE_TX);
+        CMB_Unpack(&msg, &records[0].frame);
+        assert(checkFrame(&msg) == txQueued - 1);
+
+        ecan1_trace_freeze();
+        assert(ecan1_trace_state() == ECAN1_TRACE_FROZEN);
+        printf("Trace triggers.\n");
+    }
+#endif
+
+    printf("All tests passed.\n");
+
+    return 0;
+}
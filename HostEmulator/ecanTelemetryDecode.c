@@ -0,0 +1,80 @@
+/**
+ * @file   ecanTelemetryDecode.c
+ * @date   October, 2026
+ * @brief  Turns a capture of the telemetry stream from Examples/MultiReceive/telemetry.c into a trace.
+ *
+ * The output is a dump of tEcan1TraceRecords laid out as on the dsPIC, as if read with
+ * ecan1_trace_read(), so it's printed by ecanTraceDecode. How many packets were decoded, and how
+ * many were corrupt or lost, is reported on standard error at the end.
+ *
+ * To run from the repository root:
+ * ```
+ * $ gcc -O2 -I. -IHostEmulator -IExamples/MultiReceive HostEmulator/ecanTelemetryDecoder.c \
+ *       HostEmulator/ecanTelemetryDecode.c -o ecanTelemetryDecode
+ * $ ./ecanTelemetryDecode [capture.bin] | ./ecanTraceDecode -r 5000000
+ * ```
+ *
+ * The capture is read from standard input if no file is given.
+ */
+#include "ecanTelemetryDecoder.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * Writes a little-endian uint32 into a dump.
+ */
+static void putWord(uint8_t *bytes, uint32_t value)
+{
+    bytes[0] = (uint8_t) value;
+    bytes[1] = (uint8_t) (value >> 8);
+    bytes[2] = (uint8_t) (value >> 16);
+    bytes[3] = (uint8_t) (value >> 24);
+}
+
+int main(int argc, char *argv[])
+{
+    static tTelemetryDecoder decoder;
+    tEcan1TraceRecord records[TD_MAX_RECORDS];
+    uint8_t dump[16];
+    FILE *input = stdin;
+    unsigned long frames = 0;
+    uint8_t count;
+    uint8_t i;
+    int c;
+
+    if (argc > 2 || (argc == 2 && argv[1][0] == '-')) {
+        fprintf(stderr, "Usage: %s [capture.bin]\n", argv[0]);
+        return 1;
+    }
+    if (argc == 2) {
+        input = fopen(argv[1], "rb");
+        if (!input) {
+            perror(argv[1]);
+            return 1;
+        }
+    }
+
+    TD_Init(&decoder);
+    while ((c = fgetc(input)) != EOF) {
+        TD_Write(&decoder, (uint8_t) c);
+        while ((count = TD_Read(&decoder, records))) {
+            for (i = 0; i < count; ++i) {
+                putWord(dump, records[i].stamp);
+                putWord(dump + 4, records[i].frame.header);
+                memcpy(dump + 8, records[i].frame.payload, 8);
+                fwrite(dump, 1, sizeof(dump), stdout);
+            }
+            frames += count;
+        }
+    }
+
+    if (ferror(input)) {
+        perror("Reading the capture");
+        return 1;
+    }
+    fprintf(stderr, "%lu frames in %lu packets, %lu corrupt and %lu lost packets, %lu packets skipped "
+            "waiting for a key packet, %lu bytes skipped.\n", frames, decoder.packets,
+            decoder.corruptPackets, decoder.lostPackets, decoder.unsyncedPackets, decoder.skippedBytes);
+    return 0;
+}
@@ -0,0 +1,207 @@
+/**
+ * @file   ecanTelemetryDecoder.c
+ * @date   October, 2026
+ * @brief  Decodes the telemetry stream sent by Examples/MultiReceive/telemetry.c.
+ */
+#include "ecanTelemetryDecoder.h"
+
+#include <string.h>
+
+/**
+ * Returns the CRC-16/CCITT-FALSE of some bytes, computed a bit at a time.
+ */
+static uint16_t crc16(const uint8_t *data, uint8_t length)
+{
+    uint16_t crc = 0xFFFF;
+    uint8_t bit;
+
+    while (length--) {
+        crc ^= (uint16_t) *data++ << 8;
+        for (bit = 0; bit < 8; ++bit) {
+            crc = (crc & 0x8000) ? (uint16_t) ((crc << 1) ^ 0x1021) : (uint16_t) (crc << 1);
+        }
+    }
+    return crc;
+}
+
+/**
+ * Drops bytes from the front of the packet being received.
+ */
+static void drop(tTelemetryDecoder *d, uint8_t count)
+{
+    d->length -= count;
+    memmove(d->data, d->data + count, d->length);
+}
+
+/**
+ * Decodes the records in an intact packet's body.
+ * @return The number of records, or 0 if the body doesn't parse.
+ */
+static uint8_t decodeBody(tTelemetryDecoder *d, const uint8_t *body, uint8_t length,
+                          tEcan1TraceRecord *records)
+{
+    uint8_t count = 0;
+    uint8_t i = 0;
+
+    while (i < length) {
+        tEcan1TraceRecord *record = &records[count];
+        uint8_t header = body[i++];
+        uint8_t slot = TELEMETRY_DICTIONARY;
+        uint8_t bytes;
+        uint32_t delta = 0;
+        uint32_t id;
+        uint8_t shift;
+
+        if (count == TD_MAX_RECORDS) {
+            return 0;
+        }
+        if (header & TELEMETRY_INDEX) {
+            slot = header & ~TELEMETRY_INDEX;
+            if (slot >= d->dictionaryUsed) {
+                return 0;
+            }
+            header = d->dictionaryHeader[slot];
+        }
+        bytes = header & TELEMETRY_LENGTH;
+        if (bytes > 8) {
+            return 0;
+        }
+
+        for (shift = 0;; shift += 7) {
+            if (i == length || shift > 28) {
+                return 0;
+            }
+            delta |= (uint32_t) (body[i] & 0x7F) << shift;
+            if (!(body[i++] & 0x80)) {
+                break;
+            }
+        }
+
+        if (slot < TELEMETRY_DICTIONARY) {
+            id = d->dictionaryId[slot];
+        } else {
+            if (length - i < ((header & TELEMETRY_EXT) ? 4 : 2)) {
+                return 0;
+            }
+            id = body[i] | (uint32_t) body[i + 1] << 8;
+            i += 2;
+            if (header & TELEMETRY_EXT) {
+                id |= (uint32_t) body[i] << 16 | (uint32_t) body[i + 1] << 24;
+                i += 2;
+                if (id > CMB_PACKED_ID) {
+                    return 0;
+                }
+                id |= CMB_PACKED_EXT;
+            } else if (id > 0x7FF) {
+                return 0;
+            }
+            d->dictionaryHeader[d->dictionaryNext] = header;
+            d->dictionaryId[d->dictionaryNext] = id;
+            d->dictionaryNext = (d->dictionaryNext + 1) % TELEMETRY_DICTIONARY;
+            if (d->dictionaryUsed < TELEMETRY_DICTIONARY) {
+                ++d->dictionaryUsed;
+            }
+        }
+
+        memset(record, 0, sizeof(*record));
+        record->frame.header = id;
+        if (header & TELEMETRY_RTR) {
+            record->frame.header |= CMB_PACKED_RTR;
+        } else {
+            if (length - i < bytes) {
+                return 0;
+            }
+            memcpy(record->frame.payload, &body[i], bytes);
+            i += bytes;
+        }
+        if (bytes == 8) {
+            record->frame.header |= CMB_PACKED_FULL;
+        } else {
+            record->frame.payload[7] = bytes;
+        }
+
+        d->stamp = (d->stamp + delta) & ECAN1_TRACE_TIME_MASK;
+        record->stamp = d->stamp;
+        if (header & TELEMETRY_TX) {
+            record->stamp |= ECAN1_TRACE_TX;
+        }
+        ++count;
+    }
+    return count;
+}
+
+void TD_Init(tTelemetryDecoder *d)
+{
+    memset(d, 0, sizeof(*d));
+}
+
+void TD_Write(tTelemetryDecoder *d, uint8_t byte)
+{
+    d->data[d->length++] = byte;
+}
+
+uint8_t TD_Read(tTelemetryDecoder *d, tEcan1TraceRecord *records)
+{
+    uint8_t body;
+    uint8_t sequence;
+    uint8_t count;
+    uint16_t crc;
+
+    while (d->length) {
+        // Look for the sync bytes and a plausible length.
+        if (d->data[0] != TELEMETRY_SYNC0 || (d->length > 1 && d->data[1] != TELEMETRY_SYNC1) ||
+            (d->length > 2 && (d->data[2] == 0 || d->data[2] > TELEMETRY_MAX_BODY))) {
+            drop(d, 1);
+            ++d->skippedBytes;
+            continue;
+        }
+        if (d->length < 3 || d->length < d->data[2] + TELEMETRY_OVERHEAD) {
+            return 0;
+        }
+
+        // A packet that fails the CRC may have been a false start, so only its first byte is
+        // dropped.
+        body = d->data[2];
+        crc = crc16(&d->data[2], body + 2);
+        if ((d->data[body + 4] | d->data[body + 5] << 8) != crc) {
+            drop(d, 1);
+            ++d->skippedBytes;
+            if (d->synced) {
+                ++d->corruptPackets;
+                d->synced = false;
+            }
+            continue;
+        }
+
+        sequence = d->data[3];
+        if (d->synced && (sequence & TELEMETRY_SEQUENCE) != d->sequence) {
+            d->lostPackets += (uint8_t) ((sequence & TELEMETRY_SEQUENCE) - d->sequence) & TELEMETRY_SEQUENCE;
+            d->synced = false;
+        }
+        d->sequence = (sequence + 1) & TELEMETRY_SEQUENCE;
+        if (sequence & TELEMETRY_KEY) {
+            d->synced = true;
+            d->dictionaryUsed = 0;
+            d->dictionaryNext = 0;
+            d->stamp = 0;
+        }
+
+        count = 0;
+        if (!d->synced) {
+            ++d->unsyncedPackets;
+        } else {
+            count = decodeBody(d, &d->data[4], body, records);
+            if (count) {
+                ++d->packets;
+            } else {
+                ++d->corruptPackets;
+                d->synced = false;
+            }
+        }
+        drop(d, body + TELEMETRY_OVERHEAD);
+        if (count) {
+            return count;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,61 @@
+/**
+ * @file   ecanTelemetryDecoder.h
+ * @date   October, 2026
+ * @brief  Decodes the telemetry stream sent by Examples/MultiReceive/telemetry.c back into trace records.
+ *
+ * Bytes are written into the decoder as they arrive with TD_Write(), and after each one TD_Read()
+ * is called until it returns 0, since a byte can complete more than one packet. The decoder
+ * hunts for the sync bytes and drops anything whose CRC doesn't match, one byte at a time, so it
+ * locks onto a stream joined midway. Since records refer to the dictionary and timestamps built by
+ * the packets before them, after a corrupt or missing packet it skips ahead to the next key packet.
+ *
+ * The records come out as ecan1_trace_read() returns them: timestamps are the low 31 bits of the
+ * timer along with ECAN1_TRACE_TX, and payload bytes beyond the frame's length are zero.
+ */
+#ifndef _ECAN_TELEMETRY_DECODER_H_
+#define _ECAN_TELEMETRY_DECODER_H_
+
+#include "ecanFunctions.h"
+#include "telemetry.h"
+
+// The most records a packet can hold, each taking at least 2 bytes.
+#define TD_MAX_RECORDS (TELEMETRY_MAX_BODY / 2)
+
+/**
+ * The state of a decoder. The counters are for reporting the quality of the link.
+ */
+typedef struct {
+    uint8_t data[TELEMETRY_MAX_PACKET];        // The bytes of the packet being received.
+    uint8_t length;                            // The number of bytes in data.
+    bool synced;                               // Set from a key packet until a packet is lost.
+    uint8_t sequence;                          // The sequence number of the next packet.
+    uint8_t dictionaryHeader[TELEMETRY_DICTIONARY]; // The header bytes in the dictionary.
+    uint32_t dictionaryId[TELEMETRY_DICTIONARY];    // The IDs in the dictionary along with CMB_PACKED_EXT.
+    uint8_t dictionaryUsed;
+    uint8_t dictionaryNext;
+    uint32_t stamp;                            // The timestamp of the last record.
+    unsigned long packets;                     // Packets decoded.
+    unsigned long skippedBytes;                // Bytes dropped while looking for a packet.
+    unsigned long corruptPackets;              // Packets that failed the CRC or didn't parse while in sync.
+    unsigned long lostPackets;                 // Packets missing from the sequence.
+    unsigned long unsyncedPackets;             // Intact packets skipped while waiting for a key packet.
+} tTelemetryDecoder;
+
+/**
+ * Empties a decoder and zeroes its counters.
+ */
+void TD_Init(tTelemetryDecoder *d);
+
+/**
+ * Adds a byte from the stream. TD_Read() must be called until it returns 0 before the next one.
+ */
+void TD_Write(tTelemetryDecoder *d, uint8_t byte);
+
+/**
+ * Decodes the next complete packet.
+ * @param records Where the packet's records are stored, TD_MAX_RECORDS at most.
+ * @return The number of records decoded, or 0 if more bytes are needed.
+ */
+uint8_t TD_Read(tTelemetryDecoder *d, tEcan1TraceRecord *records);
+
+#endif /* _ECAN_TELEMETRY_DECODER_H_ */
@@ -0,0 +1,485 @@
+/**
+ * @file   ecanTelemetryTest.c
+ * @date   October, 2026
+ * @brief  Checks the telemetry stream from Examples/MultiReceive against its decoder, and compares
+ *         how many frames per second it mirrors with SLCAN and the text path in extra.c.
+ *
+ * UART2 is replaced by its transmission queue, which the test drains at the rate of the serial
+ * link. First a packet is checked byte for byte, then the stream is checked for timestamps that
+ * wrap, key packets, and a decoder that recovers from corruption or joins the stream midway. Then
+ * the bus is kept fully loaded at 1Mbit/s with traffic from 24 IDs for a simulated second, at 57600
+ * and 115200 baud. Every frame that reaches the host must be intact, in order, and carry the time
+ * it was received. The same frames are also encoded as SLCAN lines and as the numbers extra.c
+ * prints, to compare the frames per second each would mirror over the same link.
+ *
+ * To run from the repository root:
+ * ```
+ * $ gcc -O2 -DECAN1_TRACE=64 -I. -IHostEmulator -IExamples/MultiReceive -Wno-pointer-to-int-cast \
+ *       ecanFunctions.c CanMessageBuffer.c CanMessageHeap.c MaskedBuffer.c \
+ *       Examples/MultiReceive/telemetry.c Examples/MultiReceive/slcan.c Examples/MultiReceive/extra.c \
+ *       HostEmulator/ecanEmulator.c HostEmulator/ecanTelemetryDecoder.c \
+ *       HostEmulator/ecanTelemetryTest.c -o ecanTelemetryTest
+ * $ ./ecanTelemetryTest
+ * ```
+ */
+#include "ecanEmulator.h"
+#include "ecanTelemetryDecoder.h"
+#include "slcan.h"
+#include "uart2.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+// How long each throughput run lasts.
+#define TELEMETRY_TEST_US 1000000UL
+
+// How often telemetryStep() is called, as by a 1ms model step.
+#define TELEMETRY_TEST_STEP_US 1000
+
+// The timer runs at 5MHz, as from a 40MIPS clock with a 1:8 prescaler.
+#define TELEMETRY_TEST_TICK_NS 200
+
+// The number of different IDs in the throughput runs.
+#define TELEMETRY_TEST_IDS 24
+
+// The most frames a throughput run can put on the bus.
+#define TELEMETRY_TEST_FRAMES 10000
+
+// From extra.c.
+void enqueueNumberText(unsigned long num);
+
+// The stand-in for UART2. Anything queued while counting is only counted.
+MaskedBuffer uart2RxBuffer;
+static uint8_t rxDataArray[128];
+MaskedBuffer uart2TxBuffer;
+static uint8_t txDataArray[128];
+static bool counting;
+static unsigned long countedBytes;
+
+void initUart2(unsigned int brgRegister)
+{
+    (void) brgRegister;
+}
+
+void uart2EnqueueData(unsigned char *data, unsigned char length)
+{
+    if (counting) {
+        countedBytes += length;
+    } else {
+        MB_WriteMany(&uart2TxBuffer, data, length, false);
+    }
+}
+
+/**
+ * Standard frames, normal mode, 1Mbit/s at 40MIPS. Buffers 0, 2 and 3 transmit and filter 0
+ * accepts every frame into buffer 1.
+ */
+static const uint16_t testParameters[53] = {
+    [0] = 0x0101,
+    [1] = 10000,
+    [2] = 40000,
+    [3] = 7 | (4 << 3) | (5 << 6),
+    [4] = 0x0001,
+    [13] = 0x0080,
+    [14] = 0x8080,
+    [17] = 0x0001
+};
+
+// The bytes sent over the link by the unit tests.
+static uint8_t stream[4096];
+static uint16_t streamLength;
+
+// The timestamps of the frames in a throughput run.
+static uint32_t stamps[TELEMETRY_TEST_FRAMES];
+
+/**
+ * Sets the 32-bit timer that timestamps the trace.
+ */
+static void setTime(uint32_t time)
+{
+    TMR3 = (uint16_t) (time >> 16);
+    TMR2 = (uint16_t) time;
+}
+
+/**
+ * Starts the driver, the link and the encoder afresh.
+ */
+static void restart(void)
+{
+    Emu_Reset();
+    ecan1_init(testParameters);
+    MB_INIT(&uart2RxBuffer, rxDataArray);
+    MB_INIT(&uart2TxBuffer, txDataArray);
+    telemetryInit();
+    streamLength = 0;
+}
+
+/**
+ * Delivers a frame from the bus at the given time.
+ */
+static void receive(uint32_t time, uint32_t id, uint8_t frameType, uint8_t messageType, uint8_t validBytes,
+                    const uint8_t *payload)
+{
+    tCanMessage frame;
+
+    memset(&frame, 0, sizeof(frame));
+    frame.id = id;
+    frame.frame_type = frameType;
+    frame.message_type = messageType;
+    frame.validBytes = validBytes;
+    memcpy(frame.payload, payload, validBytes);
+    setTime(time);
+    assert(Emu_InjectFrame(&frame) == EMU_RX_ACCEPTED);
+    Emu_Interrupt();
+}
+
+/**
+ * Runs the encoder, draining the link into `stream` until the trace is empty.
+ */
+static void sendAll(void)
+{
+    uint16_t length;
+
+    do {
+        telemetryStep();
+        length = MB_GetLength(&uart2TxBuffer);
+        assert(streamLength + length <= sizeof(stream));
+        MB_ReadMany(&uart2TxBuffer, &stream[streamLength], length);
+        streamLength += length;
+    } while (length);
+}
+
+/**
+ * Decodes part of `stream`.
+ * @return The number of records decoded.
+ */
+static uint16_t decode(tTelemetryDecoder *d, uint16_t start, tEcan1TraceRecord *records, uint16_t max)
+{
+    uint16_t count = 0;
+    uint8_t n;
+    uint16_t i;
+
+    for (i = start; i < streamLength; ++i) {
+        TD_Write(d, stream[i]);
+        while ((n = TD_Read(d, &records[count]))) {
+            count += n;
+            assert(count + TD_MAX_RECORDS <= max);
+        }
+    }
+    return count;
+}
+
+/**
+ * Checks a decoded record.
+ */
+static void checkRecord(const tEcan1TraceRecord *record, uint32_t stamp, uint32_t id, uint8_t frameType,
+                        uint8_t messageType, uint8_t validBytes, const uint8_t *payload)
+{
+    tCanMessage msg;
+
+    CMB_Unpack(&msg, &record->frame);
+    assert(record->stamp == stamp);
+    assert(msg.id == id);
+    assert(msg.frame_type == frameType);
+    assert(msg.message_type == messageType);
+    assert(msg.validBytes == validBytes);
+    if (messageType == CAN_MSG_DATA) {
+        assert(memcmp(msg.payload, payload, validBytes) == 0);
+    }
+}
+
+/**
+ * Checks the layout of a packet, and that each kind of frame survives the trip.
+ */
+static void testPackets(void)
+{
+    static const uint8_t expected[] = {
+        0xA5, 0x5A, 0x07, 0x80, 0x02, 0xAC, 0x02, 0x23, 0x01, 0xAB, 0xCD, 0x34, 0xC8
+    };
+    static const uint8_t data[8] = {0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77};
+    tTelemetryDecoder decoder;
+    tEcan1TraceRecord records[4 * TD_MAX_RECORDS];
+    tCanMessage msg;
+    uint16_t firstLength;
+
+    restart();
+    receive(300, 0x123, CAN_FRAME_STD, CAN_MSG_DATA, 2, (const uint8_t *) "\xAB\xCD");
+    sendAll();
+    assert(streamLength == sizeof(expected));
+    assert(memcmp(stream, expected, sizeof(expected)) == 0);
+
+    // A repeated ID and header byte take a byte.
+    firstLength = streamLength;
+    receive(400, 0x123, CAN_FRAME_STD, CAN_MSG_DATA, 2, (const uint8_t *) "\xAB\xCD");
+    sendAll();
+    assert(streamLength - firstLength == TELEMETRY_OVERHEAD + 4);
+
+    receive(401, 0x18FEF100, CAN_FRAME_EXT, CAN_MSG_DATA, 8, data);
+    receive(0x7FFFFFF0, 0x18FEF100, CAN_FRAME_EXT, CAN_MSG_RTR, 3, data);
+    receive(0x80000010, 0x7FF, CAN_FRAME_STD, CAN_MSG_RTR, 0, data);
+    receive(0x80000010, 0x000, CAN_FRAME_STD, CAN_MSG_DATA, 0, data);
+    memset(&msg, 0, sizeof(msg));
+    msg.id = 0x1FFFFFFF;
+    msg.frame_type = CAN_FRAME_EXT;
+    msg.message_type = CAN_MSG_DATA;
+    msg.validBytes = 5;
+    memcpy(msg.payload, data, 5);
+    setTime(0x80000020);
+    ecan1_buffered_transmit(&msg);
+    assert(Emu_BusTransmit(&msg));
+    Emu_Interrupt();
+    sendAll();
+
+    TD_Init(&decoder);
+    assert(decode(&decoder, 0, records, sizeof(records) / sizeof(records[0])) == 7);
+    checkRecord(&records[0], 300, 0x123, CAN_FRAME_STD, CAN_MSG_DATA, 2, (const uint8_t *) "\xAB\xCD");
+    checkRecord(&records[1], 400, 0x123, CAN_FRAME_STD, CAN_MSG_DATA, 2, (const uint8_t *) "\xAB\xCD");
+    checkRecord(&records[2], 401, 0x18FEF100, CAN_FRAME_EXT, CAN_MSG_DATA, 8, data);
+    checkRecord(&records[3], 0x7FFFFFF0, 0x18FEF100, CAN_FRAME_EXT, CAN_MSG_RTR, 3, NULL);
+    checkRecord(&records[4], 0x10, 0x7FF, CAN_FRAME_STD, CAN_MSG_RTR, 0, NULL);
+    checkRecord(&records[5], 0x10, 0x000, CAN_FRAME_STD, CAN_MSG_DATA, 0, NULL);
+    checkRecord(&records[6], 0x20 | ECAN1_TRACE_TX, 0x1FFFFFFF, CAN_FRAME_EXT, CAN_MSG_DATA, 5, data);
+    assert(decoder.packets == 3 && decoder.skippedBytes == 0 && decoder.corruptPackets == 0);
+
+    printf("Packets checked.\n");
+}
+
+// The number of packets sent by sendSequence(), and where each starts in `stream`.
+#define TELEMETRY_TEST_PACKETS (2 * TELEMETRY_KEY_INTERVAL + 4)
+static uint16_t packetStarts[TELEMETRY_TEST_PACKETS + 1];
+
+/**
+ * Fills `stream` with packets that each hold one frame, carrying the packet's index in its first
+ * data byte.
+ */
+static void sendSequence(void)
+{
+    uint8_t data[8] = {0};
+    uint8_t i;
+
+    restart();
+    for (i = 0; i < TELEMETRY_TEST_PACKETS; ++i) {
+        packetStarts[i] = streamLength;
+        data[0] = i;
+        receive(1000 * i, 0x100 + (i & 3), CAN_FRAME_STD, CAN_MSG_DATA, 8, data);
+        sendAll();
+    }
+    packetStarts[i] = streamLength;
+}
+
+/**
+ * Checks the records decoded from sendSequence()'s packets, given that the packets from `gapStart`
+ * up to but not including `gapEnd` were lost.
+ */
+static void checkSequence(const tEcan1TraceRecord *records, uint16_t count, uint8_t gapStart, uint8_t gapEnd)
+{
+    uint8_t data[8] = {0};
+    uint16_t i;
+
+    assert(count == TELEMETRY_TEST_PACKETS - (gapEnd - gapStart));
+    for (i = 0; i < count; ++i) {
+        data[0] = (uint8_t) (i < gapStart ? i : i + gapEnd - gapStart);
+        checkRecord(&records[i], 1000 * data[0], 0x100 + (data[0] & 3), CAN_FRAME_STD, CAN_MSG_DATA, 8, data);
+    }
+}
+
+/**
+ * Checks that the decoder recovers from corruption, from a missing packet, and from joining the
+ * stream midway, each time at the next key packet.
+ */
+static void testRecovery(void)
+{
+    tTelemetryDecoder decoder;
+    tEcan1TraceRecord records[TELEMETRY_TEST_PACKETS + TD_MAX_RECORDS];
+    const uint16_t maxRecords = sizeof(records) / sizeof(records[0]);
+    uint16_t length;
+
+    sendSequence();
+    TD_Init(&decoder);
+    checkSequence(records, decode(&decoder, 0, records, maxRecords), 0, 0);
+    assert(decoder.packets == TELEMETRY_TEST_PACKETS);
+
+    sendSequence();
+    stream[packetStarts[3] + 5] ^= 0x10;
+    TD_Init(&decoder);
+    checkSequence(records, decode(&decoder, 0, records, maxRecords), 3, TELEMETRY_KEY_INTERVAL);
+    assert(decoder.corruptPackets == 1 && decoder.lostPackets == 0);
+    assert(decoder.unsyncedPackets == TELEMETRY_KEY_INTERVAL - 4);
+
+    sendSequence();
+    length = packetStarts[4] - packetStarts[3];
+    memmove(&stream[packetStarts[3]], &stream[packetStarts[4]], streamLength - packetStarts[4]);
+    streamLength -= length;
+    TD_Init(&decoder);
+    checkSequence(records, decode(&decoder, 0, records, maxRecords), 3, TELEMETRY_KEY_INTERVAL);
+    assert(decoder.corruptPackets == 0 && decoder.lostPackets == 1);
+    assert(decoder.unsyncedPackets == TELEMETRY_KEY_INTERVAL - 4);
+
+    sendSequence();
+    TD_Init(&decoder);
+    checkSequence(records, decode(&decoder, 5, records, maxRecords), 0, TELEMETRY_KEY_INTERVAL);
+    assert(decoder.unsyncedPackets == TELEMETRY_KEY_INTERVAL - 1);
+
+    printf("Recovery checked.\n");
+}
+
+/**
+ * Builds a data frame that carries its sequence number, from one of TELEMETRY_TEST_IDS IDs of
+ * which half are extended. Each ID always has the same length, between 4 and 8 bytes.
+ */
+static void makeFrame(tCanMessage *msg, uint32_t seq)
+{
+    uint8_t source = seq % TELEMETRY_TEST_IDS;
+    uint8_t j;
+
+    memset(msg, 0, sizeof(*msg));
+    msg->message_type = CAN_MSG_DATA;
+    if (source & 1) {
+        msg->frame_type = CAN_FRAME_EXT;
+        msg->id = 0x18FE0000UL | ((uint32_t) source << 8) | 0x21;
+    } else {
+        msg->frame_type = CAN_FRAME_STD;
+        msg->id = 0x100 + 0x10 * source;
+    }
+    msg->validBytes = 4 + source % 5;
+    memcpy(msg->payload, &seq, sizeof(seq));
+    for (j = 4; j < msg->validBytes; ++j) {
+        msg->payload[j] = (uint8_t) (seq * 7 + j);
+    }
+}
+
+/**
+ * Returns the bits a frame occupies on the bus with worst-case bit stuffing.
+ */
+static uint32_t frameBits(const tCanMessage *msg)
+{
+    uint32_t bits = (msg->frame_type == CAN_FRAME_EXT ? 39 : 19) + 15 + 8 * msg->validBytes;
+
+    return bits + (bits - 1) / 4 + 13;
+}
+
+/**
+ * Returns how many bytes extra.c would send to print a frame: its ID and then its payload as
+ * 32-bit numbers.
+ */
+static unsigned long textBytes(const tCanMessage *msg)
+{
+    uint32_t word;
+    uint8_t i;
+
+    counting = true;
+    countedBytes = 0;
+    enqueueNumberText(msg->id);
+    for (i = 0; i < msg->validBytes; i += 4) {
+        word = 0;
+        memcpy(&word, &msg->payload[i], msg->validBytes - i < 4 ? msg->validBytes - i : 4);
+        enqueueNumberText(word);
+    }
+    counting = false;
+    return countedBytes;
+}
+
+/**
+ * Keeps the bus fully loaded for TELEMETRY_TEST_US while the link drains the stream into a
+ * decoder, then reports the frames per second mirrored against those SLCAN and extra.c would.
+ */
+static void testThroughput(uint32_t baud)
+{
+    static tTelemetryDecoder decoder;
+    const uint64_t byteNs = 10000000000ULL / baud;
+    const uint64_t endNs = TELEMETRY_TEST_US * 1000ULL;
+    tEcan1TraceRecord records[TD_MAX_RECORDS];
+    char line[SLCAN_MAX_LINE];
+    uint64_t now;
+    uint64_t busFree = 0;
+    uint64_t toHost = 0;
+    uint64_t stepNs = 0;
+    uint32_t rxSeq = 0;
+    uint32_t mirrored = 0;
+    uint32_t lastSeq = 0;
+    uint32_t linkBytes = 0;
+    unsigned long slcanTotal = 0;
+    unsigned long textTotal = 0;
+    double telemetryRate;
+    double slcanRate;
+    double textRate;
+    tCanMessage frame;
+    uint32_t seq;
+    uint8_t count;
+    uint8_t i;
+    uint8_t c;
+
+    restart();
+    TD_Init(&decoder);
+
+    for (now = 0; now < endNs; now += 1000) {
+        if (now >= busFree) {
+            assert(rxSeq < TELEMETRY_TEST_FRAMES);
+            makeFrame(&frame, rxSeq);
+            stamps[rxSeq++] = (uint32_t) (now / TELEMETRY_TEST_TICK_NS);
+            setTime((uint32_t) (now / TELEMETRY_TEST_TICK_NS));
+            Emu_InjectFrame(&frame);
+            Emu_Interrupt();
+            busFree = now + 1000ULL * frameBits(&frame);
+            slcanTotal += slcanEncode(&frame, line);
+            textTotal += textBytes(&frame);
+        }
+
+        while (toHost <= now) {
+            if (!MB_ReadByte(&uart2TxBuffer, &c)) {
+                toHost = now + 1000;
+                break;
+            }
+            ++linkBytes;
+            toHost += byteNs;
+            TD_Write(&decoder, c);
+            while ((count = TD_Read(&decoder, records))) {
+                for (i = 0; i < count; ++i) {
+                    memcpy(&seq, records[i].frame.payload, sizeof(seq));
+                    assert(seq < rxSeq);
+                    assert(mirrored == 0 || seq > lastSeq);
+                    lastSeq = seq;
+                    ++mirrored;
+                    makeFrame(&frame, seq);
+                    checkRecord(&records[i], stamps[seq] & ECAN1_TRACE_TIME_MASK, frame.id, frame.frame_type,
+                                frame.message_type, frame.validBytes, frame.payload);
+                }
+            }
+        }
+
+        if (now % (TELEMETRY_TEST_STEP_US * 1000ULL) == 0) {
+            uint64_t start = Emu_ReadNanoseconds();
+            telemetryStep();
+            stepNs += Emu_ReadNanoseconds() - start;
+        }
+    }
+
+    telemetryRate = (double) mirrored * endNs / 1e9 / (linkBytes * byteNs / 1e9);
+    slcanRate = 1e9 / byteNs / ((double) slcanTotal / rxSeq);
+    textRate = 1e9 / byteNs / ((double) textTotal / rxSeq);
+    printf("%lu baud: %lu of %lu bus frames mirrored, %.1f%% of the link used, %.1f bytes per frame, "
+           "%.0fns per frame encoded.\n", (unsigned long) baud, (unsigned long) mirrored,
+           (unsigned long) rxSeq, 100.0 * linkBytes * byteNs / endNs, (double) linkBytes / mirrored,
+           (double) stepNs / mirrored);
+    printf("%lu baud: %.0f frames/s with telemetry, %.0f with SLCAN (%.1f bytes per frame), %.0f "
+           "with extra.c (%.1f bytes per frame).\n", (unsigned long) baud, telemetryRate, slcanRate,
+           (double) slcanTotal / rxSeq, textRate, (double) textTotal / rxSeq);
+    assert(decoder.corruptPackets == 0 && decoder.lostPackets == 0 && decoder.skippedBytes == 0);
+    assert(linkBytes * byteNs >= endNs * 9 / 10);
+    assert(telemetryRate >= 1.75 * slcanRate && telemetryRate >= 1.75 * textRate);
+}
+
+int main()
+{
+    printf("Running unit tests.\n");
+
+    testPackets();
+    testRecovery();
+    testThroughput(57600);
+    testThroughput(115200);
+
+    printf("All tests passed.\n");
+
+    return 0;
+}
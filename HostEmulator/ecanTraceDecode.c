@@ -0,0 +1,139 @@
+/**
+ * @file   ecanTraceDecode.c
+ * @date   October, 2026
+ * @brief  Prints a trace recorded with ECAN1_TRACE as candump-style text or as CSV.
+ *
+ * The input is a dump of the tEcan1TraceRecords returned by ecan1_trace_read(), as they're laid
+ * out on the dsPIC: 16 bytes per record, little-endian. Timestamps are printed relative to the
+ * first record. They're only 31 bits wide, so the time between consecutive records must be less
+ * than 2^31 ticks for them to be unwrapped correctly. Given the timer's rate with -r, in ticks per
+ * second, they're printed in seconds instead of ticks.
+ *
+ * To run from the repository root:
+ * ```
+ * $ gcc -O2 -I. -IHostEmulator HostEmulator/ecanTraceDecode.c -o ecanTraceDecode
+ * $ ./ecanTraceDecode [-c] [-r rate] [trace.bin]
+ * ```
+ *
+ * The trace is read from standard input if no file is given, and -c selects CSV.
+ */
+#include "ecanFunctions.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The size of a record in a dump.
+#define TRACE_RECORD_BYTES 16
+
+/**
+ * Reads a little-endian uint32 from a dump.
+ */
+static uint32_t readWord(const uint8_t *bytes)
+{
+    return (uint32_t) bytes[0] | (uint32_t) bytes[1] << 8 | (uint32_t) bytes[2] << 16 |
+           (uint32_t) bytes[3] << 24;
+}
+
+int main(int argc, char *argv[])
+{
+    uint8_t record[TRACE_RECORD_BYTES];
+    FILE *input = stdin;
+    double rate = 0;
+    bool csv = false;
+    bool first = true;
+    uint32_t lastStamp = 0;
+    uint64_t time = 0;
+    unsigned long records = 0;
+    int i;
+
+    for (i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-c") == 0) {
+            csv = true;
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            rate = strtod(argv[++i], NULL);
+            if (rate <= 0) {
+                fprintf(stderr, "The rate must be positive.\n");
+                return 1;
+            }
+        } else if (i == argc - 1 && argv[i][0] != '-') {
+            input = fopen(argv[i], "rb");
+            if (!input) {
+                perror(argv[i]);
+                return 1;
+            }
+        } else {
+            fprintf(stderr, "Usage: %s [-c] [-r rate] [trace.bin]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (csv) {
+        printf("time,direction,id,extended,rtr,length,data\n");
+    }
+    while (fread(record, 1, sizeof(record), input) == sizeof(record)) {
+        uint32_t stamp = readWord(record);
+        uint32_t header = readWord(record + 4);
+        const uint8_t *payload = record + 8;
+        const char *direction = (stamp & ECAN1_TRACE_TX) ? "TX" : "RX";
+        uint8_t length = (header & CMB_PACKED_FULL) ? 8 : payload[7];
+        uint8_t j;
+
+        // Unwrap the 31-bit timestamps into a running count of ticks.
+        stamp &= ECAN1_TRACE_TIME_MASK;
+        if (!first) {
+            time += (stamp - lastStamp) & ECAN1_TRACE_TIME_MASK;
+        }
+        lastStamp = stamp;
+        first = false;
+        ++records;
+
+        if (length > 8) {
+            fprintf(stderr, "Record %lu has an invalid length of %u.\n", records, length);
+            length = 8;
+        }
+
+        if (csv) {
+            if (rate) {
+                printf("%.6f,", time / rate);
+            } else {
+                printf("%llu,", (unsigned long long) time);
+            }
+            printf("%s,%lX,%d,%d,%u,", direction, (unsigned long) (header & CMB_PACKED_ID),
+                   (header & CMB_PACKED_EXT) != 0, (header & CMB_PACKED_RTR) != 0, length);
+            if (!(header & CMB_PACKED_RTR)) {
+                for (j = 0; j < length; ++j) {
+                    printf("%02X", payload[j]);
+                }
+            }
+            printf("\n");
+            continue;
+        }
+
+        if (rate) {
+            printf("(%12.6f)  %s  ", time / rate, direction);
+        } else {
+            printf("(%12llu)  %s  ", (unsigned long long) time, direction);
+        }
+        if (header & CMB_PACKED_EXT) {
+            printf("%08lX", (unsigned long) (header & CMB_PACKED_ID));
+        } else {
+            printf("     %03lX", (unsigned long) (header & CMB_PACKED_ID));
+        }
+        printf("   [%u] ", length);
+        if (header & CMB_PACKED_RTR) {
+            printf(" remote request");
+        } else {
+            for (j = 0; j < length; ++j) {
+                printf(" %02X", payload[j]);
+            }
+        }
+        printf("\n");
+    }
+
+    if (ferror(input)) {
+        perror("Reading the trace");
+        return 1;
+    }
+    return 0;
+}
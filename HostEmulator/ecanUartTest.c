@@ -0,0 +1,240 @@
+/**
+ * @file   ecanUartTest.c
+ * @date   October, 2026
+ * @brief  Checks the DMA-driven UART2 transmission in Examples/MultiReceive/uart2.c.
+ *
+ * The test plays the part of the UART2 transmitter and DMA channel 1 on top of the emulator's
+ * register file. The transmitter has a 4-byte FIFO ahead of its shift register, and raises its
+ * interrupt request, which the DMA channel transfers on, whenever a byte moves out of the FIFO.
+ * A byte written to U2TXREG while the FIFO is full is lost, as on the hardware. The DMA channel
+ * transfers a byte from DMA RAM to the peripheral address it was given on each request and each
+ * FORCE, and in one-shot mode disables itself and raises DMA1IF after DMA1CNT + 1 bytes.
+ *
+ * Log lines are queued at random moments, sometimes while the transmitter is idle and sometimes
+ * while it's busy, so segments start both ways and often end at the wrap of the queue while the
+ * FIFO is still full. Every byte must come out once and in order, and the DMA interrupt must only
+ * run once per segment rather than once per byte.
+ *
+ * To run from the repository root:
+ * ```
+ * $ gcc -O2 -I. -IHostEmulator -IExamples/MultiReceive -Wno-pointer-to-int-cast ecanFunctions.c \
+ *       CanMessageBuffer.c CanMessageHeap.c MaskedBuffer.c Examples/MultiReceive/uart2.c \
+ *       HostEmulator/ecanEmulator.c HostEmulator/ecanUartTest.c -o ecanUartTest
+ * $ ./ecanUartTest
+ * ```
+ */
+#include "ecanEmulator.h"
+#include "uart2.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+// How many byte times the test runs for.
+#define UART_TEST_TICKS 200000UL
+
+// The depth of the transmit FIFO.
+#define UART_TEST_FIFO 4
+
+// The interrupt request that U2TX raises for the DMA controller.
+#define UART_TEST_IRQ 0x1F
+
+// The DMA channel 1 interrupt handler from uart2.c.
+void _DMA1Interrupt(void);
+
+// The transmitter: the FIFO and the shift register.
+static uint8_t fifo[UART_TEST_FIFO];
+static uint8_t fifoLength;
+static bool shifting;
+static uint8_t shiftRegister;
+
+// The bytes transferred by DMA channel 1 in its current segment.
+static uint16_t dmaTransferred;
+
+// Everything queued and everything sent.
+static uint8_t queued[1 << 20];
+static uint32_t queuedLength;
+static uint8_t sent[1 << 20];
+static uint32_t sentLength;
+static uint32_t lostBytes;
+static uint32_t segments;
+
+static void dmaRequest(void);
+
+/**
+ * Updates UTXBF and TRMT from the transmitter's state.
+ */
+static void updateStatus(void)
+{
+    U2STAbits.UTXBF = (fifoLength == UART_TEST_FIFO);
+    U2STAbits.TRMT = (!fifoLength && !shifting);
+}
+
+/**
+ * Moves the next byte out of the FIFO into an idle shift register, which raises the interrupt
+ * request.
+ */
+static void loadShiftRegister(void)
+{
+    if (shifting || !fifoLength) {
+        return;
+    }
+    shiftRegister = fifo[0];
+    memmove(fifo, fifo + 1, --fifoLength);
+    shifting = true;
+    updateStatus();
+    dmaRequest();
+}
+
+/**
+ * Handles a write to U2TXREG.
+ */
+static void writeTxRegister(uint8_t byte)
+{
+    U2TXREG = byte;
+    if (fifoLength == UART_TEST_FIFO) {
+        ++lostBytes;
+        return;
+    }
+    fifo[fifoLength++] = byte;
+    updateStatus();
+    loadShiftRegister();
+}
+
+/**
+ * Transfers one byte on DMA channel 1 if it's enabled.
+ */
+static void dmaTransfer(void)
+{
+    const uint8_t *source;
+    bool done;
+
+    if (!(DMA1CON & 0x8000)) {
+        return;
+    }
+
+    // Bytes, from DMA RAM to the peripheral, one-shot.
+    assert((DMA1CON & 0x6003) == 0x6001);
+    assert(DMA1PAD == (uint16_t) (uintptr_t) &U2TXREG);
+    source = Emu_DmaAddress(DMA1STA + dmaTransferred);
+    assert(source);
+
+    // The channel is finished with the transfer before the write can raise another request, so
+    // after the last byte of a segment that request finds it disabled and is lost.
+    done = (dmaTransferred++ == DMA1CNT);
+    if (done) {
+        DMA1CON &= ~0x8000;
+        dmaTransferred = 0;
+        ++segments;
+    }
+    writeTxRegister(*source);
+
+    if (done) {
+        IFS0bits.DMA1IF = 1;
+        if (IEC0bits.DMA1IE) {
+            _DMA1Interrupt();
+        }
+    }
+}
+
+/**
+ * Transfers a byte if FORCE was set, as soon as the code that set it returns.
+ */
+static void dmaForce(void)
+{
+    while (DMA1REQbits.FORCE) {
+        DMA1REQbits.FORCE = 0;
+        dmaTransfer();
+    }
+}
+
+/**
+ * Passes the transmitter's interrupt request to DMA channel 1 if it's listening for it.
+ */
+static void dmaRequest(void)
+{
+    if (DMA1REQbits.IRQSEL == UART_TEST_IRQ) {
+        dmaTransfer();
+        dmaForce();
+    }
+}
+
+/**
+ * Finishes sending the byte in the shift register and starts on the next.
+ */
+static void tick(void)
+{
+    if (shifting) {
+        assert(sentLength < sizeof(sent));
+        sent[sentLength++] = shiftRegister;
+        shifting = false;
+        updateStatus();
+    }
+    loadShiftRegister();
+}
+
+/**
+ * Queues a log line, if it fits.
+ * @return Whether it was queued.
+ */
+static bool enqueueLine(uint32_t number)
+{
+    char line[40];
+    int length = snprintf(line, sizeof(line), "line %lu of the log\n", (unsigned long) number);
+
+    if (uart2TxBuffer.mask + 1 - MB_GetLength(&uart2TxBuffer) < (uint16_t) length) {
+        return false;
+    }
+    assert(queuedLength + length <= sizeof(queued));
+    memcpy(&queued[queuedLength], line, length);
+    queuedLength += length;
+    uart2EnqueueData((unsigned char *) line, (unsigned char) length);
+    dmaForce();
+    return true;
+}
+
+int main()
+{
+    uint32_t seed = 1;
+    uint32_t lines = 0;
+    uint32_t i;
+
+    printf("Running unit tests.\n");
+
+    Emu_Reset();
+    initUart2(42);
+    assert(!IEC1bits.U2TXIE && IEC0bits.DMA1IE);
+    updateStatus();
+
+    // A single byte to an idle transmitter must be forced out.
+    uart2EnqueueByte('!');
+    dmaForce();
+    queued[queuedLength++] = '!';
+    tick();
+    tick();
+    assert(sentLength == 1 && sent[0] == '!' && segments == 1);
+
+    for (i = 0; i < UART_TEST_TICKS; ++i) {
+        // Lines arrive in bursts, with idle gaps that let the transmitter drain.
+        seed = seed * 1103515245 + 12345;
+        if ((seed >> 16) % 64 < ((i / 5000) % 2 ? 60 : 2)) {
+            lines += enqueueLine(lines);
+        }
+        tick();
+    }
+    while (MB_GetLength(&uart2TxBuffer) || fifoLength || shifting) {
+        tick();
+    }
+
+    printf("%lu bytes in %lu lines sent in %lu segments, %lu bytes lost.\n", (unsigned long) sentLength,
+           (unsigned long) lines, (unsigned long) segments, (unsigned long) lostBytes);
+    assert(lostBytes == 0);
+    assert(sentLength == queuedLength);
+    assert(memcmp(sent, queued, sentLength) == 0);
+    assert(segments < sentLength / 8);
+
+    printf("All tests passed.\n");
+
+    return 0;
+}
@@ -0,0 +1,436 @@
+/**
+ * @file   p33fxxxx.h
+ * @date   October, 2026
+ * @brief  Host stand-in for the Microchip dsPIC33F device header.
+ *
+ * This header is found instead of the real <p33fxxxx.h> when compiling for x86 with
+ * `-IHostEmulator`. It declares a fake register file covering every SFR touched by
+ * ecanFunctions.c, and by the UART2 code in Examples/MultiReceive, so that both compile unmodified
+ * on the host. The registers are plain
+ * variables defined in ecanEmulator.c, which also provides the bus model that fills and drains
+ * them.
+ *
+ * Like the real device header, `REGbits` and `REG` alias the same storage. A few registers whose
+ * hardware behavior the driver busy-waits on (C1CTRL1's OPMODE following REQOP) are accessed
+ * through small functions so that the emulator can react to the access.
+ */
+#ifndef _HOST_P33FXXXX_H_
+#define _HOST_P33FXXXX_H_
+
+#include <stdint.h>
+
+// Compiler-specific attributes for the dsPIC are meaningless on the host. They're emptied here
+// so that `__attribute__((interrupt, no_auto_psv))` and friends compile as no-ops.
+#define interrupt
+#define __interrupt__
+#define no_auto_psv
+#define space(x)
+
+// Returns the offset of an object within DMA RAM. See Emu_DmaOffset().
+#define __builtin_dmaoffset(x) Emu_DmaOffset((const volatile void *)(x))
+uint16_t Emu_DmaOffset(const volatile void *object);
+
+// Declares a 16-bit register and its bitfield view sharing the same storage.
+#define EMU_SFR(name, bitsType) \
+    extern volatile union name##_u { uint16_t reg; bitsType bits; } Emu_##name
+
+/*
+ * ECAN1 registers
+ */
+typedef struct {
+    uint16_t WIN:1;
+    uint16_t :2;
+    uint16_t CANCAP:1;
+    uint16_t :1;
+    uint16_t OPMODE:3;
+    uint16_t REQOP:3;
+    uint16_t CANCKS:1;
+    uint16_t ABAT:1;
+    uint16_t CSIDL:1;
+    uint16_t :2;
+} C1CTRL1BITS;
+EMU_SFR(C1CTRL1, C1CTRL1BITS);
+#define C1CTRL1     Emu_C1CTRL1.reg
+#define C1CTRL1bits (*Emu_C1CTRL1bits())
+volatile C1CTRL1BITS *Emu_C1CTRL1bits(void);
+
+typedef struct {
+    uint16_t BRP:6;
+    uint16_t SJW:2;
+    uint16_t :8;
+} C1CFG1BITS;
+EMU_SFR(C1CFG1, C1CFG1BITS);
+#define C1CFG1     Emu_C1CFG1.reg
+#define C1CFG1bits Emu_C1CFG1.bits
+
+typedef struct {
+    uint16_t PRSEG:3;
+    uint16_t SEG1PH:3;
+    uint16_t SAM:1;
+    uint16_t SEG2PHTS:1;
+    uint16_t SEG2PH:3;
+    uint16_t :3;
+    uint16_t WAKFIL:1;
+    uint16_t :1;
+} C1CFG2BITS;
+EMU_SFR(C1CFG2, C1CFG2BITS);
+#define C1CFG2     Emu_C1CFG2.reg
+#define C1CFG2bits Emu_C1CFG2.bits
+
+typedef struct {
+    uint16_t FSA:5;
+    uint16_t :8;
+    uint16_t DMABS:3;
+} C1FCTRLBITS;
+EMU_SFR(C1FCTRL, C1FCTRLBITS);
+#define C1FCTRL     Emu_C1FCTRL.reg
+#define C1FCTRLbits Emu_C1FCTRL.bits
+
+typedef struct {
+    uint16_t FNRB:6;
+    uint16_t :2;
+    uint16_t FBP:6;
+    uint16_t :2;
+} C1FIFOBITS;
+EMU_SFR(C1FIFO, C1FIFOBITS);
+#define C1FIFO     Emu_C1FIFO.reg
+#define C1FIFObits Emu_C1FIFO.bits
+
+typedef struct {
+    uint16_t ICODE:7;
+    uint16_t :1;
+    uint16_t FILHIT:5;
+    uint16_t :3;
+} C1VECBITS;
+EMU_SFR(C1VEC, C1VECBITS);
+#define C1VEC     Emu_C1VEC.reg
+#define C1VECbits Emu_C1VEC.bits
+
+typedef struct {
+    uint16_t TBIF:1;
+    uint16_t RBIF:1;
+    uint16_t RBOVIF:1;
+    uint16_t FIFOIF:1;
+    uint16_t :1;
+    uint16_t ERRIF:1;
+    uint16_t WAKIF:1;
+    uint16_t IVRIF:1;
+    uint16_t EWARN:1;
+    uint16_t RXWAR:1;
+    uint16_t TXWAR:1;
+    uint16_t RXBP:1;
+    uint16_t TXBP:1;
+    uint16_t TXBO:1;
+    uint16_t :2;
+} C1INTFBITS;
+EMU_SFR(C1INTF, C1INTFBITS);
+#define C1INTF     Emu_C1INTF.reg
+#define C1INTFbits Emu_C1INTF.bits
+
+typedef struct {
+    uint16_t TBIE:1;
+    uint16_t RBIE:1;
+    uint16_t RBOVIE:1;
+    uint16_t FIFOIE:1;
+    uint16_t :1;
+    uint16_t ERRIE:1;
+    uint16_t WAKIE:1;
+    uint16_t IVRIE:1;
+    uint16_t :8;
+} C1INTEBITS;
+EMU_SFR(C1INTE, C1INTEBITS);
+#define C1INTE     Emu_C1INTE.reg
+#define C1INTEbits Emu_C1INTE.bits
+
+// Acceptance mask registers (visible with WIN = 1)
+typedef struct {
+    uint16_t EID:2;
+    uint16_t :1;
+    uint16_t MIDE:1;
+    uint16_t :1;
+    uint16_t SID:11;
+} C1RXMSIDBITS;
+EMU_SFR(C1RXM0SID, C1RXMSIDBITS);
+EMU_SFR(C1RXM1SID, C1RXMSIDBITS);
+EMU_SFR(C1RXM2SID, C1RXMSIDBITS);
+#define C1RXM0SID     Emu_C1RXM0SID.reg
+#define C1RXM0SIDbits Emu_C1RXM0SID.bits
+#define C1RXM1SID     Emu_C1RXM1SID.reg
+#define C1RXM1SIDbits Emu_C1RXM1SID.bits
+#define C1RXM2SID     Emu_C1RXM2SID.reg
+#define C1RXM2SIDbits Emu_C1RXM2SID.bits
+
+// Plain 16-bit registers. Filters and buffer pointers are kept in arrays in the same order the
+// hardware lays them out so that they can be walked by the emulator.
+extern volatile uint16_t Emu_C1RXMEID[3];
+#define C1RXM0EID Emu_C1RXMEID[0]
+#define C1RXM1EID Emu_C1RXMEID[1]
+#define C1RXM2EID Emu_C1RXMEID[2]
+
+extern volatile uint16_t Emu_C1BUFPNT[4];
+#define C1BUFPNT1 Emu_C1BUFPNT[0]
+#define C1BUFPNT2 Emu_C1BUFPNT[1]
+#define C1BUFPNT3 Emu_C1BUFPNT[2]
+#define C1BUFPNT4 Emu_C1BUFPNT[3]
+
+extern volatile uint16_t Emu_C1RXF[16][2];
+#define C1RXF0SID  Emu_C1RXF[0][0]
+#define C1RXF0EID  Emu_C1RXF[0][1]
+#define C1RXF1SID  Emu_C1RXF[1][0]
+#define C1RXF1EID  Emu_C1RXF[1][1]
+#define C1RXF2SID  Emu_C1RXF[2][0]
+#define C1RXF2EID  Emu_C1RXF[2][1]
+#define C1RXF3SID  Emu_C1RXF[3][0]
+#define C1RXF3EID  Emu_C1RXF[3][1]
+#define C1RXF4SID  Emu_C1RXF[4][0]
+#define C1RXF4EID  Emu_C1RXF[4][1]
+#define C1RXF5SID  Emu_C1RXF[5][0]
+#define C1RXF5EID  Emu_C1RXF[5][1]
+#define C1RXF6SID  Emu_C1RXF[6][0]
+#define C1RXF6EID  Emu_C1RXF[6][1]
+#define C1RXF7SID  Emu_C1RXF[7][0]
+#define C1RXF7EID  Emu_C1RXF[7][1]
+#define C1RXF8SID  Emu_C1RXF[8][0]
+#define C1RXF8EID  Emu_C1RXF[8][1]
+#define C1RXF9SID  Emu_C1RXF[9][0]
+#define C1RXF9EID  Emu_C1RXF[9][1]
+#define C1RXF10SID Emu_C1RXF[10][0]
+#define C1RXF10EID Emu_C1RXF[10][1]
+#define C1RXF11SID Emu_C1RXF[11][0]
+#define C1RXF11EID Emu_C1RXF[11][1]
+#define C1RXF12SID Emu_C1RXF[12][0]
+#define C1RXF12EID Emu_C1RXF[12][1]
+#define C1RXF13SID Emu_C1RXF[13][0]
+#define C1RXF13EID Emu_C1RXF[13][1]
+#define C1RXF14SID Emu_C1RXF[14][0]
+#define C1RXF14EID Emu_C1RXF[14][1]
+#define C1RXF15SID Emu_C1RXF[15][0]
+#define C1RXF15EID Emu_C1RXF[15][1]
+
+extern volatile uint16_t C1FEN1;
+extern volatile uint16_t C1FMSKSEL1;
+extern volatile uint16_t C1FMSKSEL2;
+extern volatile uint16_t C1RXFUL1;
+extern volatile uint16_t C1RXFUL2;
+extern volatile uint16_t C1RXOVF1;
+extern volatile uint16_t C1RXOVF2;
+extern volatile uint16_t C1EC;
+extern volatile uint16_t C1RXD;
+extern volatile uint16_t C1TXD;
+
+// The TX buffer control registers must be contiguous as the driver indexes off of C1TR01CON.
+extern volatile uint16_t Emu_C1TRCON[4];
+#define C1TR01CON Emu_C1TRCON[0]
+#define C1TR23CON Emu_C1TRCON[1]
+#define C1TR45CON Emu_C1TRCON[2]
+#define C1TR67CON Emu_C1TRCON[3]
+
+/*
+ * Interrupt controller registers. Only the bits used by this project are named.
+ */
+typedef struct {
+    uint16_t INT0IF:1;
+    uint16_t IC1IF:1;
+    uint16_t OC1IF:1;
+    uint16_t T1IF:1;
+    uint16_t DMA0IF:1;
+    uint16_t IC2IF:1;
+    uint16_t OC2IF:1;
+    uint16_t T2IF:1;
+    uint16_t T3IF:1;
+    uint16_t SPI1EIF:1;
+    uint16_t SPI1IF:1;
+    uint16_t U1RXIF:1;
+    uint16_t U1TXIF:1;
+    uint16_t AD1IF:1;
+    uint16_t DMA1IF:1;
+    uint16_t :1;
+} IFS0BITS;
+EMU_SFR(IFS0, IFS0BITS);
+#define IFS0     Emu_IFS0.reg
+#define IFS0bits Emu_IFS0.bits
+
+typedef struct {
+    uint16_t :4;
+    uint16_t DMA2IF:1;
+    uint16_t :9;
+    uint16_t U2RXIF:1;
+    uint16_t U2TXIF:1;
+} IFS1BITS;
+EMU_SFR(IFS1, IFS1BITS);
+#define IFS1     Emu_IFS1.reg
+#define IFS1bits Emu_IFS1.bits
+
+typedef struct {
+    uint16_t :3;
+    uint16_t C1IF:1;
+    uint16_t DMA3IF:1;
+    uint16_t :11;
+} IFS2BITS;
+EMU_SFR(IFS2, IFS2BITS);
+#define IFS2     Emu_IFS2.reg
+#define IFS2bits Emu_IFS2.bits
+
+typedef struct {
+    uint16_t INT0IE:1;
+    uint16_t IC1IE:1;
+    uint16_t OC1IE:1;
+    uint16_t T1IE:1;
+    uint16_t DMA0IE:1;
+    uint16_t IC2IE:1;
+    uint16_t OC2IE:1;
+    uint16_t T2IE:1;
+    uint16_t T3IE:1;
+    uint16_t SPI1EIE:1;
+    uint16_t SPI1IE:1;
+    uint16_t U1RXIE:1;
+    uint16_t U1TXIE:1;
+    uint16_t AD1IE:1;
+    uint16_t DMA1IE:1;
+    uint16_t :1;
+} IEC0BITS;
+EMU_SFR(IEC0, IEC0BITS);
+#define IEC0     Emu_IEC0.reg
+#define IEC0bits Emu_IEC0.bits
+
+typedef struct {
+    uint16_t :4;
+    uint16_t DMA2IE:1;
+    uint16_t :9;
+    uint16_t U2RXIE:1;
+    uint16_t U2TXIE:1;
+} IEC1BITS;
+EMU_SFR(IEC1, IEC1BITS);
+#define IEC1     Emu_IEC1.reg
+#define IEC1bits Emu_IEC1.bits
+
+typedef struct {
+    uint16_t :3;
+    uint16_t C1IE:1;
+    uint16_t DMA3IE:1;
+    uint16_t :11;
+} IEC2BITS;
+EMU_SFR(IEC2, IEC2BITS);
+#define IEC2     Emu_IEC2.reg
+#define IEC2bits Emu_IEC2.bits
+
+typedef struct {
+    uint16_t U1TXIP:3;
+    uint16_t :1;
+    uint16_t AD1IP:3;
+    uint16_t :1;
+    uint16_t DMA1IP:3;
+    uint16_t :5;
+} IPC3BITS;
+EMU_SFR(IPC3, IPC3BITS);
+#define IPC3     Emu_IPC3.reg
+#define IPC3bits Emu_IPC3.bits
+
+typedef struct {
+    uint16_t T5IP:3;
+    uint16_t :1;
+    uint16_t INT2IP:3;
+    uint16_t :1;
+    uint16_t U2RXIP:3;
+    uint16_t :1;
+    uint16_t U2TXIP:3;
+    uint16_t :1;
+} IPC7BITS;
+EMU_SFR(IPC7, IPC7BITS);
+#define IPC7     Emu_IPC7.reg
+#define IPC7bits Emu_IPC7.bits
+
+/*
+ * UART2. Nothing moves bytes through it on its own; a test that drives the UART2 code plays the
+ * part of the transmitter and receiver.
+ */
+typedef struct {
+    uint16_t STSEL:1;
+    uint16_t PDSEL:2;
+    uint16_t BRGH:1;
+    uint16_t URXINV:1;
+    uint16_t ABAUD:1;
+    uint16_t LPBACK:1;
+    uint16_t WAKE:1;
+    uint16_t UEN:2;
+    uint16_t :1;
+    uint16_t RTSMD:1;
+    uint16_t IREN:1;
+    uint16_t USIDL:1;
+    uint16_t :1;
+    uint16_t UARTEN:1;
+} U2MODEBITS;
+EMU_SFR(U2MODE, U2MODEBITS);
+#define U2MODE     Emu_U2MODE.reg
+#define U2MODEbits Emu_U2MODE.bits
+
+typedef struct {
+    uint16_t URXDA:1;
+    uint16_t OERR:1;
+    uint16_t FERR:1;
+    uint16_t PERR:1;
+    uint16_t RIDLE:1;
+    uint16_t ADDEN:1;
+    uint16_t URXISEL:2;
+    uint16_t TRMT:1;
+    uint16_t UTXBF:1;
+    uint16_t UTXEN:1;
+    uint16_t UTXBRK:1;
+    uint16_t :1;
+    uint16_t UTXISEL0:1;
+    uint16_t UTXINV:1;
+    uint16_t UTXISEL1:1;
+} U2STABITS;
+EMU_SFR(U2STA, U2STABITS);
+#define U2STA     Emu_U2STA.reg
+#define U2STAbits Emu_U2STA.bits
+
+extern volatile uint16_t U2BRG;
+extern volatile uint16_t U2TXREG;
+extern volatile uint16_t U2RXREG;
+
+/*
+ * Timer 1, which the driver reads to time its interrupt handler with ECAN1_STATS. Nothing advances
+ * it, so every run of the handler is timed at 0 cycles.
+ */
+extern volatile uint16_t TMR1;
+
+/*
+ * Timers 2 and 3 as a 32-bit timer, which the driver reads for the ECAN1_TRACE timestamps. Like
+ * the hardware, reading TMR2 latches TMR3 into TMR3HLD. Nothing advances them, so tests set them
+ * directly.
+ */
+extern volatile uint16_t Emu_TMR2;
+extern volatile uint16_t TMR3;
+extern volatile uint16_t TMR3HLD;
+#define TMR2 (*Emu_TMR2Latch())
+volatile uint16_t *Emu_TMR2Latch(void);
+
+/*
+ * DMA controller. Each channel is six contiguous registers, which dma_init() relies on.
+ */
+extern volatile uint16_t Emu_DMA[8][6];
+#define DMA0CON Emu_DMA[0][0]
+#define DMA0REQ Emu_DMA[0][1]
+#define DMA0STA Emu_DMA[0][2]
+#define DMA0STB Emu_DMA[0][3]
+#define DMA0PAD Emu_DMA[0][4]
+#define DMA0CNT Emu_DMA[0][5]
+#define DMA1CON Emu_DMA[1][0]
+#define DMA1REQ Emu_DMA[1][1]
+#define DMA1STA Emu_DMA[1][2]
+#define DMA1STB Emu_DMA[1][3]
+#define DMA1PAD Emu_DMA[1][4]
+#define DMA1CNT Emu_DMA[1][5]
+
+typedef struct {
+    uint16_t IRQSEL:7;
+    uint16_t :8;
+    uint16_t FORCE:1;
+} DMA1REQBITS;
+#define DMA1REQbits (*Emu_DMA1REQbits())
+volatile DMA1REQBITS *Emu_DMA1REQbits(void);
+extern volatile uint16_t DMACS0;
+extern volatile uint16_t DMACS1;
+
+#endif /* _HOST_P33FXXXX_H_ */
@@ -0,0 +1,463 @@
+/**
+ * @file   MaskedBuffer.c
+ * @date   October, 2026
+ * @brief  Provides a power-of-two circular buffer for bytes and non-primitive datatypes.
+ *
+ * Unit testing has been completed on x86 by compiling with the UNIT_TEST_MASKED_BUFFER macro.
+ * With gcc: `gcc MaskedBuffer.c -DUNIT_TEST_MASKED_BUFFER -Wall`
+ * Add -DCB_STATS to test the statistics as well.
+ */
+#include "MaskedBuffer.h"
+
+#include <stddef.h>
+#include <string.h>
+
+/**
+ * Records `size` bytes written by the producer, once writeCount has been updated.
+ */
+static inline void RecordWrite(MaskedBuffer *b, uint16_t size)
+{
+#ifdef CB_STATS
+	uint16_t length = MB_GetLength(b);
+	b->stats.bytesWritten += size;
+	if (length > b->stats.peakSize) {
+		b->stats.peakSize = length;
+	}
+#else
+	(void)b;
+	(void)size;
+#endif
+}
+
+/**
+ * Records `size` bytes read or removed by the consumer.
+ */
+static inline void RecordRead(MaskedBuffer *b, uint16_t size)
+{
+#ifdef CB_STATS
+	b->stats.bytesRead += size;
+#else
+	(void)b;
+	(void)size;
+#endif
+}
+
+/**
+ * Records a write that lost `lost` bytes because the buffer was full.
+ */
+static inline void RecordOverflow(MaskedBuffer *b, uint16_t lost)
+{
+#ifdef CB_STATS
+	++b->stats.overflows;
+	b->stats.bytesLost += lost;
+#else
+	(void)b;
+	(void)lost;
+#endif
+}
+
+/**
+ * Copies `size` bytes out of the buffer starting at the free-running position `start`.
+ */
+static void CopyOut(const MaskedBuffer *b, uint16_t start, uint8_t *outData, uint16_t size)
+{
+	uint16_t index = start & b->mask;
+	uint16_t firstPart = b->mask + 1 - index;
+
+	if (size <= firstPart) {
+		memcpy(outData, &b->data[index], size);
+	} else {
+		memcpy(outData, &b->data[index], firstPart);
+		memcpy(&outData[firstPart], b->data, size - firstPart);
+	}
+}
+
+int MB_Init(MaskedBuffer *b, uint8_t *data, const uint16_t size)
+{
+	if (!b || !data) {
+		return STANDARD_ERROR;
+	}
+
+	// The size must be a power of two, and small enough that a full buffer can be told apart from
+	// an empty one using 16-bit counters.
+	if (size < 2 || size > 0x8000 || (size & (size - 1))) {
+		return STANDARD_ERROR;
+	}
+
+	b->data = data;
+	b->readCount = 0;
+	b->writeCount = 0;
+	b->mask = size - 1;
+	b->overflowCount = 0;
+	MB_ResetStats(b);
+
+	return SUCCESS;
+}
+
+uint16_t MB_GetLength(const MaskedBuffer *b)
+{
+	return (uint16_t) (b->writeCount - b->readCount);
+}
+
+int MB_ReadByte(MaskedBuffer *b, uint8_t *outData)
+{
+	if (b) {
+		uint16_t readCount = b->readCount;
+		if (readCount != b->writeCount) {
+			MEMORY_BARRIER();
+			*outData = b->data[readCount & b->mask];
+			MEMORY_BARRIER();
+			b->readCount = readCount + 1;
+			RecordRead(b, 1);
+			return SUCCESS;
+		}
+	}
+	return STANDARD_ERROR;
+}
+
+int MB_ReadMany(MaskedBuffer *b, void *outData, uint16_t size)
+{
+	if (b && outData) {
+		uint16_t readCount = b->readCount;
+		if ((uint16_t) (b->writeCount - readCount) >= size) {
+			MEMORY_BARRIER();
+			CopyOut(b, readCount, (uint8_t *) outData, size);
+			MEMORY_BARRIER();
+			b->readCount = readCount + size;
+			RecordRead(b, size);
+			return SUCCESS;
+		}
+	}
+	return STANDARD_ERROR;
+}
+
+int MB_WriteByte(MaskedBuffer *b, uint8_t inData)
+{
+	if (b) {
+		uint16_t writeCount = b->writeCount;
+		if ((uint16_t) (writeCount - b->readCount) > b->mask) {
+			++b->overflowCount;
+			RecordOverflow(b, 1);
+			return STANDARD_ERROR;
+		}
+		b->data[writeCount & b->mask] = inData;
+		MEMORY_BARRIER();
+		b->writeCount = writeCount + 1;
+		RecordWrite(b, 1);
+		return SUCCESS;
+	}
+	return STANDARD_ERROR;
+}
+
+int MB_WriteMany(MaskedBuffer *b, const void *inData, uint16_t size, bool failEarly)
+{
+	if (b && inData) {
+		const uint8_t *data_u = (const uint8_t *) inData;
+		uint16_t writeCount = b->writeCount;
+		uint16_t space = b->mask + 1 - (uint16_t) (writeCount - b->readCount);
+		uint16_t toWrite = size;
+
+		if (space < size) {
+			if (failEarly) {
+				return STANDARD_ERROR;
+			}
+			toWrite = space;
+		}
+
+		uint16_t index = writeCount & b->mask;
+		uint16_t firstPart = b->mask + 1 - index;
+		if (toWrite <= firstPart) {
+			memcpy(&b->data[index], data_u, toWrite);
+		} else {
+			memcpy(&b->data[index], data_u, firstPart);
+			memcpy(b->data, &data_u[firstPart], toWrite - firstPart);
+		}
+		MEMORY_BARRIER();
+		b->writeCount = writeCount + toWrite;
+		RecordWrite(b, toWrite);
+
+		if (toWrite < size) {
+			b->overflowCount += size - toWrite;
+			RecordOverflow(b, size - toWrite);
+			return STANDARD_ERROR;
+		}
+		return SUCCESS;
+	}
+	return STANDARD_ERROR;
+}
+
+int MB_Peek(const MaskedBuffer *b, uint8_t *outData)
+{
+	if (b) {
+		uint16_t readCount = b->readCount;
+		if (readCount != b->writeCount) {
+			MEMORY_BARRIER();
+			*outData = b->data[readCount & b->mask];
+			return SUCCESS;
+		}
+	}
+	return STANDARD_ERROR;
+}
+
+int MB_PeekMany(const MaskedBuffer *b, void *outData, uint16_t size)
+{
+	if (b && outData) {
+		uint16_t readCount = b->readCount;
+		if ((uint16_t) (b->writeCount - readCount) >= size) {
+			MEMORY_BARRIER();
+			CopyOut(b, readCount, (uint8_t *) outData, size);
+			return SUCCESS;
+		}
+	}
+	return STANDARD_ERROR;
+}
+
+int MB_Remove(MaskedBuffer *b, uint16_t size)
+{
+	uint16_t readCount = b->readCount;
+	uint16_t writeCount = b->writeCount;
+
+	MEMORY_BARRIER();
+	if ((uint16_t) (writeCount - readCount) < size) {
+		size = writeCount - readCount;
+	}
+	b->readCount = readCount + size;
+	RecordRead(b, size);
+	return SUCCESS;
+}
+
+const uint8_t *MB_PeekContiguous(const MaskedBuffer *b, uint16_t *size)
+{
+	if (b) {
+		uint16_t readCount = b->readCount;
+		uint16_t length = (uint16_t) (b->writeCount - readCount);
+		uint16_t index = readCount & b->mask;
+
+		if (length) {
+			// Stop at the end of the array if the data wraps around it.
+			if (size) {
+				*size = b->mask + 1 - index;
+				if (*size > length) {
+					*size = length;
+				}
+			}
+			MEMORY_BARRIER();
+			return &b->data[index];
+		}
+	}
+	if (size) {
+		*size = 0;
+	}
+	return NULL;
+}
+
+int MB_Consume(MaskedBuffer *b, uint16_t size)
+{
+	if (b) {
+		uint16_t readCount = b->readCount;
+
+		if ((uint16_t) (b->writeCount - readCount) >= size) {
+			MEMORY_BARRIER();
+			b->readCount = readCount + size;
+			RecordRead(b, size);
+			return SUCCESS;
+		}
+	}
+	return STANDARD_ERROR;
+}
+
+int MB_GetStats(const MaskedBuffer *b, CircularBufferStats *stats)
+{
+#ifdef CB_STATS
+	if (b && stats) {
+		*stats = b->stats;
+		return SUCCESS;
+	}
+#else
+	(void)b;
+	(void)stats;
+#endif
+	return STANDARD_ERROR;
+}
+
+void MB_ResetStats(MaskedBuffer *b)
+{
+#ifdef CB_STATS
+	if (b) {
+		b->stats.bytesWritten = 0;
+		b->stats.bytesRead = 0;
+		b->stats.overflows = 0;
+		b->stats.bytesLost = 0;
+		b->stats.peakSize = MB_GetLength(b);
+	}
+#else
+	(void)b;
+#endif
+}
+
+/**
+ * This begins the unit testing code. Directions for compilation are at the top of the file.
+ */
+#ifdef UNIT_TEST_MASKED_BUFFER
+
+#include <assert.h>
+#include <stdio.h>
+
+int main()
+{
+	printf("Running unit tests.\n");
+
+	// Check that only power-of-two sizes are accepted.
+	{
+		MaskedBuffer b;
+		uint8_t data[64];
+		assert(MB_Init(&b, data, 0) == STANDARD_ERROR);
+		assert(MB_Init(&b, data, 1) == STANDARD_ERROR);
+		assert(MB_Init(&b, data, 48) == STANDARD_ERROR);
+		assert(MB_Init(&b, NULL, 64) == STANDARD_ERROR);
+		assert(MB_INIT(&b, data) == SUCCESS);
+		assert(b.mask == 63);
+	}
+
+	// Fill the buffer a byte at a time, overflow it, and read it back.
+	{
+		MaskedBuffer b;
+		uint8_t data[16];
+		uint8_t d;
+		uint16_t i;
+
+		MB_INIT(&b, data);
+		for (i = 0; i < 16; ++i) {
+			assert(MB_WriteByte(&b, i));
+			assert(MB_GetLength(&b) == i + 1);
+		}
+		assert(!MB_WriteByte(&b, 0x89));
+		assert(b.overflowCount == 1);
+		assert(MB_Peek(&b, &d) && d == 0);
+		for (i = 0; i < 16; ++i) {
+			assert(MB_ReadByte(&b, &d) && d == i);
+		}
+		assert(!MB_ReadByte(&b, &d));
+		assert(MB_GetLength(&b) == 0);
+	}
+
+	// Run the counters past their 16-bit wrap-around with multi-byte transfers that straddle the
+	// end of the array.
+	{
+		MaskedBuffer b;
+		uint8_t data[32];
+		uint8_t in[13], out[13];
+		uint32_t i;
+		uint8_t j;
+
+		MB_INIT(&b, data);
+		for (i = 0; i < 20000; ++i) {
+			for (j = 0; j < 13; ++j) {
+				in[j] = (uint8_t) (i + j);
+			}
+			assert(MB_WriteMany(&b, in, 13, true));
+			assert(MB_WriteMany(&b, in, 13, true));
+			assert(MB_PeekMany(&b, out, 13));
+			assert(memcmp(in, out, 13) == 0);
+			assert(MB_Remove(&b, 13));
+			memset(out, 0, sizeof(out));
+			assert(MB_ReadMany(&b, out, 13));
+			assert(memcmp(in, out, 13) == 0);
+			assert(MB_GetLength(&b) == 0);
+		}
+	}
+
+	// Check both failure modes of MB_WriteMany.
+	{
+		MaskedBuffer b;
+		uint8_t data[32];
+		uint8_t in[100];
+		uint8_t d;
+		uint8_t i;
+
+		for (i = 0; i < 100; ++i) {
+			in[i] = i;
+		}
+		MB_INIT(&b, data);
+		assert(MB_WriteMany(&b, in, 18, true));
+		assert(MB_WriteMany(&b, in, 50, true) == STANDARD_ERROR);
+		assert(MB_GetLength(&b) == 18);
+		assert(!MB_WriteMany(&b, in, 100, false));
+		assert(MB_GetLength(&b) == 32);
+		assert(b.overflowCount == 86);
+		for (i = 0; i < 18; ++i) {
+			assert(MB_ReadByte(&b, &d) && d == i);
+		}
+		for (i = 0; i < 14; ++i) {
+			assert(MB_ReadByte(&b, &d) && d == i);
+		}
+
+		// Removing more than is stored empties the buffer.
+		MB_WriteMany(&b, in, 10, true);
+		assert(MB_Remove(&b, 20));
+		assert(MB_GetLength(&b) == 0);
+
+#ifdef CB_STATS
+		// Only the partial write counts as an overflow, as in overflowCount, and the removal only
+		// counts the bytes that were there.
+		CircularBufferStats stats;
+		assert(MB_GetStats(&b, &stats));
+		assert(stats.bytesWritten == 18 + 14 + 10);
+		assert(stats.bytesRead == 32 + 10);
+		assert(stats.overflows == 1);
+		assert(stats.bytesLost == 86);
+		assert(stats.peakSize == 32);
+
+		MB_WriteMany(&b, in, 5, true);
+		MB_ResetStats(&b);
+		assert(MB_GetStats(&b, &stats));
+		assert(stats.bytesWritten == 0 && stats.bytesRead == 0 && stats.overflows == 0 && stats.bytesLost == 0);
+		assert(stats.peakSize == 5);
+#endif
+	}
+
+	// MB_PeekContiguous()/MB_Consume() hand out the stored bytes up to the end of the array.
+	{
+		MaskedBuffer b;
+		uint8_t data[16];
+		uint8_t in[16];
+		const uint8_t *peeked;
+		uint16_t size;
+		uint8_t i;
+
+		for (i = 0; i < 16; ++i) {
+			in[i] = i;
+		}
+		MB_INIT(&b, data);
+		assert(!MB_PeekContiguous(&b, &size));
+		assert(size == 0);
+
+		MB_WriteMany(&b, in, 12, true);
+		assert(MB_Consume(&b, 10));
+		MB_WriteMany(&b, in, 9, true);
+		peeked = MB_PeekContiguous(&b, &size);
+		assert(peeked == &data[10] && size == 6);
+		assert(peeked[0] == 10 && peeked[1] == 11 && peeked[2] == 0);
+
+		// Consuming more than is stored fails without removing anything.
+		assert(MB_Consume(&b, 12) == STANDARD_ERROR);
+		assert(MB_GetLength(&b) == 11);
+		assert(MB_Consume(&b, size));
+		peeked = MB_PeekContiguous(&b, NULL);
+		assert(peeked == &data[0] && MB_PeekContiguous(&b, &size) && size == 5);
+		assert(peeked[0] == 4 && peeked[4] == 8);
+		assert(MB_Consume(&b, 5));
+		assert(!MB_PeekContiguous(&b, &size) && size == 0);
+
+#ifdef CB_STATS
+		CircularBufferStats stats;
+		assert(MB_GetStats(&b, &stats));
+		assert(stats.bytesRead == 21);
+#endif
+	}
+
+	printf("All tests passed.\n");
+
+	return 0;
+}
+#endif // UNIT_TEST_MASKED_BUFFER
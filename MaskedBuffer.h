@@ -0,0 +1,176 @@
+/**
+ * @file   MaskedBuffer.h
+ * @date   October, 2026
+ * @brief  Provides a power-of-two circular buffer for bytes and non-primitive datatypes.
+ *
+ * This is a variant of CircularBuffer for buffers whose size is a power of two fixed at compile
+ * time. Instead of comparing every index against the buffer size, indices are wrapped with a mask.
+ * The read and write positions are free-running counters, so the number of stored bytes is simply
+ * their difference and no separate byte count is kept. Multi-byte reads and writes are done as at
+ * most two contiguous copies.
+ *
+ * Like CanMessageBuffer, a single producer and a single consumer may use the buffer concurrently
+ * without masking interrupts. The writing functions only ever modify writeCount and the reading
+ * functions only ever modify readCount.
+ *
+ * Buffers should be initialized with MB_INIT(), which checks at compile time that the array is a
+ * power of two in size. Sizes from 2 to 32768 bytes are supported.
+ *
+ * With CB_STATS defined the buffer keeps the same usage statistics as CircularBuffer, read with
+ * MB_GetStats(). The producer's statistics are only updated by the writing functions and the
+ * consumer's by the reading functions, so they keep the same concurrency guarantees.
+ *
+ * Unit testing has been completed on x86 by compiling with the UNIT_TEST_MASKED_BUFFER macro.
+ * With gcc: `gcc MaskedBuffer.c -DUNIT_TEST_MASKED_BUFFER -Wall`
+ * Add -DCB_STATS to test the statistics as well.
+ */
+#ifndef _MASKED_BUFFER_H_
+#define _MASKED_BUFFER_H_
+
+#include "Common.h"
+#include "CircularBuffer.h"
+
+/**
+ * @brief A structure which holds information about the masked buffer.
+ *
+ * The useful property is overflowCount. Use MB_GetLength() for the number of stored bytes.
+ */
+typedef struct {
+	volatile uint16_t readCount;  //!< The total number of bytes ever read. Only the bits under `mask` index into `data`. Owned by the consumer.
+	volatile uint16_t writeCount; //!< The total number of bytes ever written. Only the bits under `mask` index into `data`. Owned by the producer.
+	uint16_t mask;                //!< The size of the buffer minus one.
+	uint8_t overflowCount;        //!< Tracks how many bytes have been attempted to be written while the buffer was full.
+	uint8_t *data;                //!< A pointer to the actual data managed by this buffer.
+#ifdef CB_STATS
+	CircularBufferStats stats;    //!< Usage statistics. Read them with MB_GetStats().
+#endif
+} MaskedBuffer;
+
+/**
+ * @brief Initializes a MaskedBuffer over a statically-sized array.
+ *
+ * Fails to compile if `array` isn't a power of two in size.
+ */
+#define MB_INIT(b, array) \
+	((void)sizeof(char[(sizeof(array) & (sizeof(array) - 1)) == 0 ? 1 : -1]), \
+	 MB_Init((b), (array), sizeof(array)))
+
+/**
+ * @brief MB_Init initializes the buffer.
+ *
+ * Returns STANDARD_ERROR if either pointer is NULL or `size` isn't a power of two between 2 and
+ * 32768, otherwise SUCCESS. Like CB_Init() this can also be used to empty an existing buffer, but
+ * not while the producer or consumer may be running.
+ *
+ * @param b A pointer to a masked buffer struct.
+ * @param data A pointer to where the data will be stored.
+ * @param size The length of the buffer.
+ */
+int MB_Init(MaskedBuffer *b, uint8_t *data, const uint16_t size);
+
+/**
+ * @brief MB_GetLength returns the number of unread bytes in the buffer.
+ */
+uint16_t MB_GetLength(const MaskedBuffer *b);
+
+/**
+ * @brief MB_ReadByte reads a byte from the buffer.
+ *
+ * Returns STANDARD_ERROR if b was NULL or had no data to return.
+ *
+ * @see CB_ReadByte()
+ */
+int MB_ReadByte(MaskedBuffer *b, uint8_t *outData);
+
+/**
+ * @brief MB_ReadMany reads multiple bytes from the buffer.
+ *
+ * If there are fewer than `size` bytes in the buffer nothing is read and STANDARD_ERROR is
+ * returned.
+ *
+ * @see CB_ReadMany()
+ */
+int MB_ReadMany(MaskedBuffer *b, void *outData, uint16_t size);
+
+/**
+ * @brief MB_WriteByte writes a byte into the buffer.
+ *
+ * If the buffer is full the byte is not written, overflowCount is incremented, and STANDARD_ERROR
+ * is returned.
+ *
+ * @see CB_WriteByte()
+ */
+int MB_WriteByte(MaskedBuffer *b, uint8_t inData);
+
+/**
+ * @brief MB_WriteMany writes multiple bytes into the buffer.
+ *
+ * With `failEarly` set nothing is written unless all `size` bytes fit. Otherwise as many bytes as
+ * fit are written and the remainder is added to overflowCount. STANDARD_ERROR is returned whenever
+ * not everything was written.
+ *
+ * @see CB_WriteMany()
+ */
+int MB_WriteMany(MaskedBuffer *b, const void *inData, uint16_t size, bool failEarly);
+
+/**
+ * @brief MB_Peek retrieves a byte from the buffer without removing it.
+ *
+ * @see CB_Peek()
+ */
+int MB_Peek(const MaskedBuffer *b, uint8_t *outData);
+
+/**
+ * @brief MB_PeekMany copies `size` bytes from the buffer without removing them.
+ *
+ * @see CB_PeekMany()
+ */
+int MB_PeekMany(const MaskedBuffer *b, void *outData, uint16_t size);
+
+/**
+ * @brief MB_Remove removes `size` bytes from the buffer, or empties it if it holds fewer than
+ * that. Always returns SUCCESS.
+ *
+ * @see CB_Remove()
+ */
+int MB_Remove(MaskedBuffer *b, uint16_t size);
+
+/**
+ * @brief MB_PeekContiguous returns a pointer to the oldest data in the buffer for reading in place,
+ * such as by a DMA channel.
+ *
+ * `size` is set to the number of bytes that can be read contiguously from the returned pointer,
+ * which is less than MB_GetLength() when the stored data wraps around the end of the array. Returns
+ * NULL and sets `size` to 0 if b is NULL or empty.
+ *
+ * @see CB_PeekContiguous()
+ */
+const uint8_t *MB_PeekContiguous(const MaskedBuffer *b, uint16_t *size);
+
+/**
+ * @brief MB_Consume removes data that was read in place with MB_PeekContiguous(). Nothing is
+ * removed and STANDARD_ERROR is returned if the buffer holds fewer than `size` bytes.
+ *
+ * @see CB_Consume()
+ */
+int MB_Consume(MaskedBuffer *b, uint16_t size);
+
+/**
+ * @brief MB_GetStats copies the buffer's usage statistics.
+ *
+ * Returns STANDARD_ERROR if b is NULL or CB_STATS isn't defined. The producer or consumer may be
+ * running meanwhile, in which case the copy may be a few bytes out of step between them.
+ *
+ * @see CB_GetStats()
+ */
+int MB_GetStats(const MaskedBuffer *b, CircularBufferStats *stats);
+
+/**
+ * @brief MB_ResetStats starts the buffer's usage statistics over. Like MB_Init() this must not be
+ * called while the producer or consumer may be running.
+ *
+ * @see CB_ResetStats()
+ */
+void MB_ResetStats(MaskedBuffer *b);
+
+#endif /* _MASKED_BUFFER_H_ */
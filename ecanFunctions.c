@@ -1,5 +1,6 @@
 #include "ecanFunctions.h"
-#include "CircularBuffer.h"
+#include "CanMessageBuffer.h"
+#include "CanMessageHeap.h"
 
 #include <string.h>
 #include <stdbool.h>
@@ -12,24 +13,244 @@
  * @brief  Provides C functions for ECAN blocks
  */
 
-// Specify the number of 8-byte CAN messages buffer supports.
-// This can be overridden by user code.
+// Specify the number of bytes used by each of the CAN message buffers.
+// This can be overridden by user code. The reception buffer also keeps the
+// receive buffer number of each queued message in a byte per slot, outside of
+// these bytes.
 #ifndef ECAN1_BUFFERSIZE
 #define ECAN1_BUFFERSIZE 8 * 24
 #endif
 
+// Rounds n down to a power of two.
+#define ECAN1_FLOOR_POW2(n) ((n) >= 256 ? 256 : (n) >= 128 ? 128 : (n) >= 64 ? 64 : \
+                             (n) >= 32 ? 32 : (n) >= 16 ? 16 : (n) >= 8 ? 8 : (n) >= 4 ? 4 : \
+                             (n) >= 2 ? 2 : 1)
+
+// The number of whole messages that fit into each buffer in their packed
+// form. The message buffers index with a mask, so this is rounded down to a
+// power of two.
+#define ECAN1_BUFFER_MESSAGES ECAN1_FLOOR_POW2(ECAN1_BUFFERSIZE / sizeof(tCanPackedMessage))
+
+// The same for the reception buffer, whose messages are bigger when they're
+// queued raw.
+#ifdef ECAN1_RX_RAW
+#define ECAN1_RX_MESSAGES ECAN1_FLOOR_POW2(ECAN1_BUFFERSIZE / sizeof(tCanRawMessage))
+#else
+#define ECAN1_RX_MESSAGES ECAN1_BUFFER_MESSAGES
+#endif
+
 // Declare space for our message buffer in DMA
-uint16_t ecan1msgBuf[4][8] __attribute__((space(dma)));
+uint16_t ecan1msgBuf[ECAN1_DMA_BUFFERS][8] __attribute__((space(dma)));
+
+// The DMABS setting for ECAN1_DMA_BUFFERS message buffers.
+#define ECAN1_DMABS (ECAN1_DMA_BUFFERS == 32 ? 6 : ECAN1_DMA_BUFFERS == 24 ? 5 : \
+                     ECAN1_DMA_BUFFERS == 16 ? 4 : ECAN1_DMA_BUFFERS == 12 ? 3 : \
+                     ECAN1_DMA_BUFFERS == 8 ? 2 : ECAN1_DMA_BUFFERS == 6 ? 1 : 0)
+
+// Initialize our message buffers and data arrays for transreceiving CAN messages
+CanMessageBuffer ecan1_rx_buffer;
+#ifndef ECAN1_RX_RAW
+tCanPackedMessage rx_data_array[ECAN1_RX_MESSAGES];
+#else
+tCanRawMessage rx_data_array[ECAN1_RX_MESSAGES];
+#endif
+// The receive buffer each queued message was read from, by slot, as there's
+// no room for it in a packed message.
+static uint8_t rx_source_array[ECAN1_RX_MESSAGES];
+CanMessageBuffer ecan1_tx_buffer;
+#ifndef ECAN1_TX_PRIORITY
+tCanPackedMessage tx_data_array[ECAN1_BUFFER_MESSAGES];
+#else
+// In priority order the transmission buffer is replaced by a heap. Unlike the
+// buffer it can't be shared without locking, so the main loop masks the ECAN1
+// interrupt while using it.
+CanMessageHeap ecan1_tx_heap;
+CanMessageHeapSlot tx_heap_array[ECAN1_TX_PRIORITY_SIZE];
+uint8_t tx_heap_order[ECAN1_TX_PRIORITY_SIZE];
+#endif
+
+// Track whether or not we're currently transmitting. This is only cleared by the
+// interrupt handler once the transmission queue has been emptied and every
+// frame sent with ecan1_transmit() has left.
+volatile unsigned char currentlyTransmitting = 0;
+
+// Queued messages are loaded into every hardware TX buffer available so that
+// the module can send them back-to-back. Among pending buffers the module
+// sends the highest TXnPRI first, and the highest-numbered buffer among
+// equals. So each buffer is loaded with an arbitration key, (TXnPRI << 3) |
+// buffer, lower than those of all the frames still pending, which keeps the
+// frames in order. Once there's no lower key available, loading waits until
+// everything pending has been sent and the keys start over from the top.
+#define ECAN1_TX_KEYS 32
+
+// The TX buffers available for transmission: those with TXEN set at
+// initialization that are also in DMA RAM.
+static uint8_t txBuffers;
+
+// The TXENn, RTRENn and TXnPRI bits of each TX buffer's control byte, as
+// given to ecan1_init(). The transmission engine replaces TXnPRI with its own.
+static uint8_t txControl[8];
+
+// The TX buffers loaded with a frame that hadn't been sent yet when last checked.
+static uint8_t txLoaded;
+
+// The TX buffers loaded by ecan1_transmit() whose frames hadn't been sent yet
+// when last checked. The transmission engine leaves them alone meanwhile.
+static volatile uint8_t txDirect;
+
+// The arbitration key of the most recently loaded frame.
+static uint8_t txLastKey;
+
+// The receive buffers not in the FIFO, as masks over C1RXFUL1 and C1RXFUL2.
+#ifdef ECAN1_FIFO_START
+#define ECAN1_RX_BUFFERS ECAN1_FIFO_START
+#else
+#define ECAN1_RX_BUFFERS ECAN1_DMA_BUFFERS
+#endif
+#if ECAN1_RX_BUFFERS >= 16
+#define ECAN1_RXFUL1_MASK 0xFFFF
+#define ECAN1_RXFUL2_MASK (0xFFFF >> (32 - ECAN1_RX_BUFFERS))
+#else
+#define ECAN1_RXFUL1_MASK ((1 << ECAN1_RX_BUFFERS) - 1)
+#define ECAN1_RXFUL2_MASK 0
+#endif
+
+// The number of received messages read out by an interrupt that had already
+// read another.
+static volatile uint16_t rxCoalesced;
+
+// The software filter's table of accepted identifiers and the number of
+// frames it has discarded.
+#ifdef ECAN1_RX_FILTER
+static const uint32_t *rxFilterIds;
+static uint16_t rxFilterCount;
+#endif
+static volatile uint16_t rxFiltered;
+
+// The mailboxes, found through an open-addressed hash table that's kept at
+// most half full so that lookups stay short. Each slot holds a mailbox's index
+// plus one, or 0 when free.
+#ifdef ECAN1_MAILBOXES
+#define ECAN1_MAILBOX_SLOTS ECAN1_FLOOR_POW2(4 * ECAN1_MAILBOXES - 1)
+typedef struct {
+    uint32_t id;                 // As returned by ecan1_decode_id().
+    volatile uint16_t sequence;  // Frames received, skipping 0 once one has been.
+    uint16_t readSequence;       // The sequence when last read.
+    tCanPackedMessage message;   // The latest frame.
+    uint8_t buffer;              // The receive buffer it was read from.
+} tEcan1Mailbox;
+static tEcan1Mailbox mailboxes[ECAN1_MAILBOXES];
+static uint8_t mailboxSlots[ECAN1_MAILBOX_SLOTS];
+#endif
+
+// The statistics kept with ECAN1_STATS. isrAverageCycles is only worked out
+// from isrTotalCycles when they're read, and the interrupt handler minimum
+// starts out at 0xFFFF so that the first run replaces it.
+#ifdef ECAN1_STATS
+static tEcan1Stats stats;
+static uint64_t isrTotalCycles;
+
+/**
+ * Returns the number of set bits.
+ */
+static inline uint8_t ecan1_count_bits(uint16_t bits)
+{
+    uint8_t count = 0;
+    for (; bits; bits &= bits - 1) {
+        ++count;
+    }
+    return count;
+}
+
+/**
+ * Updates the transmission queue's high watermark after messages are queued.
+ */
+static inline void ecan1_stats_tx_queued(void)
+{
+#ifdef ECAN1_TX_PRIORITY
+    uint16_t length = CMH_GetLength(&ecan1_tx_heap);
+#else
+    uint16_t length = CMB_GetLength(&ecan1_tx_buffer);
+#endif
+    if (length > stats.txHighWatermark) {
+        stats.txHighWatermark = length;
+    }
+}
+#endif
+
+// The bus load estimate. The interrupt handler adds the bits of every frame
+// received or transmitted to busBits, and each update moves those counted
+// since the last into a sliding window of periods.
+#ifdef ECAN1_BUS_LOAD
+// The bits a frame with the given number of bits from the start of frame to
+// the data field and `n` data bytes occupies on the bus. The 15-bit CRC is
+// stuffed along with the rest, with the worst case of one stuff bit after the
+// first five bits and every four after that. Then come the CRC delimiter, ACK
+// slot and delimiter, end of frame and interframe space.
+#define ECAN1_FRAME_BITS(header, n) ((header) + 8 * (n) + 15 + ((header) + 8 * (n) + 15 - 1) / 4 + 13)
+#define ECAN1_FRAME_BITS_ROW(header) {ECAN1_FRAME_BITS(header, 0), ECAN1_FRAME_BITS(header, 1), \
+    ECAN1_FRAME_BITS(header, 2), ECAN1_FRAME_BITS(header, 3), ECAN1_FRAME_BITS(header, 4), \
+    ECAN1_FRAME_BITS(header, 5), ECAN1_FRAME_BITS(header, 6), ECAN1_FRAME_BITS(header, 7), \
+    ECAN1_FRAME_BITS(header, 8)}
+
+// Indexed by [extended][data bytes]. Standard frames have 19 bits before the
+// data field and extended ones 39.
+static const uint8_t ecan1FrameBits[2][9] = {
+    ECAN1_FRAME_BITS_ROW(19),
+    ECAN1_FRAME_BITS_ROW(39)
+};
+
+static volatile uint32_t busBits;
+static uint32_t busBitsUpdated;     // busBits at the last update.
+static uint32_t busPeriodBits;      // The bits the bus carries in a period.
+static uint32_t busWindow[ECAN1_BUS_LOAD_WINDOW];
+static uint32_t busWindowBits;      // The sum of busWindow.
+static uint8_t busWindowNext;
+static uint8_t busWindowFilled;
 
-// Initialize our circular buffers and data arrays for transreceiving CAN messages
-CircularBuffer ecan1_rx_buffer;
-uint8_t rx_data_array[ECAN1_BUFFERSIZE];
-CircularBuffer ecan1_tx_buffer;
-uint8_t tx_data_array[ECAN1_BUFFERSIZE];
+/**
+ * Counts the bits of the frame in an ECAN message buffer towards the bus load.
+ * Remote transmit requests have no data field whatever their DLC.
+ */
+static inline void ecan1_bus_count(const uint16_t *ecan_msg_buf_ptr)
+{
+    uint8_t extended = ecan_msg_buf_ptr[0] & 0x0001;
+    uint8_t bytes = ecan_msg_buf_ptr[2] & 0x000F;
+
+    if (extended ? (ecan_msg_buf_ptr[2] & 0x0200) : (ecan_msg_buf_ptr[0] & 0x0002)) {
+        bytes = 0;
+    } else if (bytes > 8) {
+        bytes = 8;
+    }
+    busBits += ecan1FrameBits[extended][bytes];
+}
+#endif
 
-// Track whether or not we're currently transmitting
-unsigned char currentlyTransmitting = 0;
-unsigned char receivedMessagesPending = 0;
+// The trace kept with ECAN1_TRACE. traceWritten and traceRead count records
+// ever written and read, and only their low bits index into trace.
+#ifdef ECAN1_TRACE
+static tEcan1TraceRecord trace[ECAN1_TRACE];
+static volatile uint16_t traceWritten;
+static uint16_t traceRead;
+static volatile uint8_t traceState;
+static uint32_t traceTriggerId;
+static uint32_t traceTriggerMask;
+static uint16_t traceAfter;         // Frames left to record after the trigger.
+
+#ifndef ECAN1_TRACE_TIME
+#define ECAN1_TRACE_TIME() ecan1_trace_time()
+
+/**
+ * Reads Timer2 and Timer3 as a 32-bit timer. Reading TMR2 latches TMR3 into
+ * TMR3HLD, so the two halves always belong together.
+ */
+static inline uint32_t ecan1_trace_time(void)
+{
+    uint16_t low = TMR2;
+    return ((uint32_t) TMR3HLD << 16) | low;
+}
+#endif
+#endif
 
 void ecan1_init(const uint16_t *parameters)
 {
@@ -39,13 +260,25 @@ void ecan1_init(const uint16_t *parameters)
     C1CTRL1bits.REQOP = 4;
     while (C1CTRL1bits.OPMODE != 4);
 
-    // Initialize our circular buffers. If this fails, we crash and burn.
-    if (!CB_Init(&ecan1_tx_buffer, tx_data_array, ECAN1_BUFFERSIZE)) {
+    // Initialize our message buffers. If this fails, we crash and burn.
+#ifndef ECAN1_TX_PRIORITY
+    if (!CMB_Init(&ecan1_tx_buffer, tx_data_array, ECAN1_BUFFER_MESSAGES)) {
+        while (1);
+    }
+#else
+    if (!CMH_Init(&ecan1_tx_heap, tx_heap_array, tx_heap_order, ECAN1_TX_PRIORITY_SIZE)) {
         while (1);
     }
-    if (!CB_Init(&ecan1_rx_buffer, rx_data_array, ECAN1_BUFFERSIZE)) {
+#endif
+#ifndef ECAN1_RX_RAW
+    if (!CMB_Init(&ecan1_rx_buffer, rx_data_array, ECAN1_RX_MESSAGES)) {
         while (1);
     }
+#else
+    if (!CMB_InitRaw(&ecan1_rx_buffer, rx_data_array, ECAN1_RX_MESSAGES)) {
+        while (1);
+    }
+#endif
 
     // Initialize our time quanta
     uint16_t a = parameters[3] & 0x0007;
@@ -66,7 +299,10 @@ void ecan1_init(const uint16_t *parameters)
     // FCAN is selected to be FCY: FCAN = FCY = 40MHz. This is actually a don't care bit in dsPIC33f
     C1CTRL1bits.CANCKS = 1;
 
-    C1FCTRLbits.DMABS = 0; // Use 4 buffers in DMA RAM
+    C1FCTRLbits.DMABS = ECAN1_DMABS; // Use ECAN1_DMA_BUFFERS buffers in DMA RAM
+#ifdef ECAN1_FIFO_START
+    C1FCTRLbits.FSA = ECAN1_FIFO_START; // The rest of them form the receive FIFO
+#endif
 
     // Setup message filters and masks.
     C1CTRL1bits.WIN = 1; // Allow configuration of masks and filters
@@ -74,12 +310,15 @@ void ecan1_init(const uint16_t *parameters)
     // Set our filter mask parameters
     C1RXM0SIDbits.SID = parameters[7] >> 5; // Set filter 0
     C1RXM0SIDbits.MIDE = (parameters[7] & 0x0008) >> 3;
+    C1RXM0SIDbits.EID = parameters[7] & 0x0003;
     C1RXM0EID = parameters[8];
     C1RXM1SIDbits.SID = parameters[9] >> 5; // Set filter 1
     C1RXM1SIDbits.MIDE = (parameters[9] & 0x0008) >> 3;
+    C1RXM1SIDbits.EID = parameters[9] & 0x0003;
     C1RXM1EID = parameters[10];
     C1RXM2SIDbits.SID = parameters[11] >> 5; // Set filter 2
     C1RXM2SIDbits.MIDE = (parameters[11] & 0x0008) >> 3;
+    C1RXM2SIDbits.EID = parameters[11] & 0x0003;
     C1RXM2EID = parameters[12];
 
     C1FEN1 = parameters[4]; // Enable desired filters
@@ -150,6 +389,39 @@ void ecan1_init(const uint16_t *parameters)
     C1TR45CON = parameters[15];
     C1TR67CON = parameters[16];
 
+    // Find the buffers the transmission engine can use.
+    uint8_t n;
+    txBuffers = 0;
+    for (n = 0; n < 8; ++n) {
+        txControl[n] = (uint8_t) (parameters[13 + (n >> 1)] >> ((n & 1) << 3)) & 0x87;
+        if ((txControl[n] & 0x80) && n < ECAN1_DMA_BUFFERS) {
+            txBuffers |= 1 << n;
+        }
+    }
+    txLoaded = 0;
+    txDirect = 0;
+    txLastKey = ECAN1_TX_KEYS;
+    currentlyTransmitting = 0;
+    rxCoalesced = 0;
+    rxFiltered = 0;
+    ecan1_stats_reset();
+#ifdef ECAN1_BUS_LOAD
+    busBits = 0;
+    busBitsUpdated = 0;
+    busPeriodBits = (uint32_t) ((uint64_t) parameters[1] * ECAN1_BUS_LOAD_PERIOD_US / 10000);
+    memset(busWindow, 0, sizeof(busWindow));
+    busWindowBits = 0;
+    busWindowNext = 0;
+    busWindowFilled = 0;
+#endif
+    ecan1_trace_start();
+#ifdef ECAN1_MAILBOXES
+    for (n = 0; n < ECAN1_MAILBOXES; ++n) {
+        mailboxes[n].sequence = 0;
+        mailboxes[n].readSequence = 0;
+    }
+#endif
+
     // Setup necessary DMA channels for transmission and reception
     // Transmission DMA
     uint16_t dmaParameters[6];
@@ -168,13 +440,141 @@ void ecan1_init(const uint16_t *parameters)
     dma_init(dmaParameters);
 }
 
+/**
+ * Decodes the identifier of an ECAN message buffer, with CMB_PACKED_EXT set
+ * for extended frames.
+ */
+static inline uint32_t ecan1_decode_id(const uint16_t *ecan_msg_buf_ptr)
+{
+    uint32_t id;
+
+    // Format the identifier properly according to whether it
+    // uses an extended identifier or not.
+    if ((ecan_msg_buf_ptr[0] & 0x0001) == 0) {
+        return (uint32_t) ((ecan_msg_buf_ptr[0] & 0x1FFC) >> 2);
+    }
+    id = ((uint32_t) (ecan_msg_buf_ptr[0] & 0x1FFC)) << 16;
+    id |= ((uint32_t) (ecan_msg_buf_ptr[1] & 0x0FFF)) << 6;
+    id |= (ecan_msg_buf_ptr[2] & 0xFC00) >> 10;
+    return id | CMB_PACKED_EXT;
+}
+
+/**
+ * Decodes an ECAN message buffer into the packed form messages are queued in.
+ */
+static inline void ecan1_decode(const uint16_t *ecan_msg_buf_ptr, tCanPackedMessage *message)
+{
+    uint32_t header = ecan1_decode_id(ecan_msg_buf_ptr);
+    uint8_t validBytes;
+
+    // Remote transmit requests are flagged by SRR for standard
+    // frames and by RTR for extended frames.
+    if ((header & CMB_PACKED_EXT) ? (ecan_msg_buf_ptr[2] & 0x0200) : (ecan_msg_buf_ptr[0] & 0x0002)) {
+        header |= CMB_PACKED_RTR;
+    }
+
+    message->payload[0] = (uint8_t) ecan_msg_buf_ptr[3];
+    message->payload[1] = (uint8_t) ((ecan_msg_buf_ptr[3] & 0xFF00) >> 8);
+    message->payload[2] = (uint8_t) ecan_msg_buf_ptr[4];
+    message->payload[3] = (uint8_t) ((ecan_msg_buf_ptr[4] & 0xFF00) >> 8);
+    message->payload[4] = (uint8_t) ecan_msg_buf_ptr[5];
+    message->payload[5] = (uint8_t) ((ecan_msg_buf_ptr[5] & 0xFF00) >> 8);
+    message->payload[6] = (uint8_t) ecan_msg_buf_ptr[6];
+    message->payload[7] = (uint8_t) ((ecan_msg_buf_ptr[6] & 0xFF00) >> 8);
+
+    // Shorter messages keep their length in the unused last byte. The module
+    // leaves whatever was there before in the bytes past the length, so
+    // they're zeroed.
+    validBytes = (uint8_t) (ecan_msg_buf_ptr[2] & 0x000F);
+    if (validBytes >= 8) {
+        header |= CMB_PACKED_FULL;
+    } else {
+        memset(&message->payload[validBytes], 0, 7 - validBytes);
+        message->payload[7] = validBytes;
+    }
+    message->header = header;
+}
+
+#ifdef ECAN1_TRACE
+/**
+ * Records the frame in an ECAN message buffer, along with the time and
+ * `direction`, which is ECAN1_TRACE_TX or 0, unless the trace is frozen.
+ */
+static inline void ecan1_trace_record(const uint16_t *ecan_msg_buf_ptr, uint32_t direction)
+{
+    tEcan1TraceRecord *record;
+
+    if (traceState == ECAN1_TRACE_FROZEN) {
+        return;
+    }
+    record = &trace[traceWritten & (ECAN1_TRACE - 1)];
+    record->stamp = (ECAN1_TRACE_TIME() & ECAN1_TRACE_TIME_MASK) | direction;
+    ecan1_decode(ecan_msg_buf_ptr, &record->frame);
+    ++traceWritten;
+
+    if (traceState == ECAN1_TRACE_ARMED) {
+        if ((record->frame.header & traceTriggerMask) == traceTriggerId) {
+            traceState = traceAfter ? ECAN1_TRACE_TRIGGERED : ECAN1_TRACE_FROZEN;
+        }
+    } else if (traceState == ECAN1_TRACE_TRIGGERED && !--traceAfter) {
+        traceState = ECAN1_TRACE_FROZEN;
+    }
+}
+#endif
+
+#ifdef ECAN1_RX_RAW
+/**
+ * Decodes the oldest raw message in the reception buffer and removes it,
+ * storing the receive buffer it came from unless `buffer` is NULL. Returns
+ * false if the buffer is empty.
+ */
+static bool ecan1_rx_decode(tCanPackedMessage *message, uint8_t *buffer)
+{
+    const tCanRawMessage *raw = CMB_PeekContiguousRaw(&ecan1_rx_buffer, NULL);
+
+    if (!raw) {
+        return false;
+    }
+    ecan1_decode(raw->words, message);
+    if (buffer) {
+        *buffer = rx_source_array[raw - rx_data_array];
+    }
+
+    // Only now is the slot handed back to the interrupt handler.
+    CMB_Consume(&ecan1_rx_buffer, 1);
+    return true;
+}
+#endif
+
 int ecan1_receive(tCanMessage *msg, uint8_t *messagesLeft)
 {
-    int foundOne = CB_ReadMany(&ecan1_rx_buffer, msg, sizeof(tCanMessage));
+    // The interrupt handler only ever adds to the reception buffer and we only
+    // ever remove from it, so no critical section is needed here.
+#ifdef ECAN1_RX_RAW
+    tCanPackedMessage packed;
+    uint8_t buffer;
+    int foundOne = ecan1_rx_decode(&packed, &buffer);
+
+    if (foundOne) {
+        CMB_Unpack(msg, &packed);
+        msg->buffer = buffer;
+    }
+#else
+    // The message is unpacked in place so that the receive buffer it came
+    // from can be read before its slot is handed back.
+    const tCanPackedMessage *packed = CMB_PeekContiguous(&ecan1_rx_buffer, NULL);
+    int foundOne = (packed != NULL);
+
+    if (foundOne) {
+        CMB_Unpack(msg, packed);
+        msg->buffer = rx_source_array[packed - rx_data_array];
+        CMB_Consume(&ecan1_rx_buffer, 1);
+    }
+#endif
 
     if (messagesLeft) {
         if (foundOne) {
-            *messagesLeft = --receivedMessagesPending;
+            *messagesLeft = CMB_GetLength(&ecan1_rx_buffer);
         } else {
             *messagesLeft = 0;
         }
@@ -183,91 +583,396 @@ int ecan1_receive(tCanMessage *msg, uint8_t *messagesLeft)
     return foundOne;
 }
 
+/**
+ * Packs a queued message into the 4 uint32s used by the MATLAB reception
+ * functions. Consecutive words are `stride` elements apart so that rows of a
+ * column-major matrix can be filled.
+ */
+static void ecan1_pack_matlab(const tCanPackedMessage *msg, uint16_t messagesLeft, uint32_t *output, uint16_t stride)
+{
+    uint32_t header = msg->header;
+
+    output[0] = header & CMB_PACKED_ID;
+    output[stride] = ((uint32_t) msg->payload[3]) << 24;
+    output[stride] |= ((uint32_t) msg->payload[2]) << 16;
+    output[stride] |= ((uint32_t) msg->payload[1]) << 8;
+    output[stride] |= (uint32_t) msg->payload[0];
+    output[2 * stride] = ((uint32_t) msg->payload[6]) << 16;
+    output[2 * stride] |= ((uint32_t) msg->payload[5]) << 8;
+    output[2 * stride] |= (uint32_t) msg->payload[4];
+
+    // The last payload byte holds the length unless all 8 bytes are valid.
+    if (header & CMB_PACKED_FULL) {
+        output[2 * stride] |= ((uint32_t) msg->payload[7]) << 24;
+        output[3 * stride] = 8;
+    } else {
+        output[3 * stride] = (uint32_t) msg->payload[7];
+    }
+
+    if (header & CMB_PACKED_RTR) {
+        output[3 * stride] |= 0x00000100;
+    }
+
+    output[3 * stride] |= ((uint32_t) messagesLeft) << 16;
+}
+
 int ecan1_receive_matlab(uint32_t *output)
 {
-    tCanMessage msg;
+    int i;
+#ifdef ECAN1_RX_RAW
+    // Decode the message, then repack it.
+    tCanPackedMessage packed;
 
-    if (receivedMessagesPending > 0) {
-        CB_ReadMany(&ecan1_rx_buffer, &msg, sizeof(tCanMessage));
+    if (ecan1_rx_decode(&packed, NULL)) {
 
-        output[0] = msg.id;
-        output[1] = ((uint32_t) msg.payload[3]) << 24;
-        output[1] |= ((uint32_t) msg.payload[2]) << 16;
-        output[1] |= ((uint32_t) msg.payload[1]) << 8;
-        output[1] |= (uint32_t) msg.payload[0];
-        output[2] = ((uint32_t) msg.payload[7]) << 24;
-        output[2] |= ((uint32_t) msg.payload[6]) << 16;
-        output[2] |= ((uint32_t) msg.payload[5]) << 8;
-        output[2] |= (uint32_t) msg.payload[4];
-        output[3] = (uint32_t) msg.validBytes;
+        // The count of messages left includes this one.
+        ecan1_pack_matlab(&packed, CMB_GetLength(&ecan1_rx_buffer) + 1, output, 1);
 
-        if (msg.message_type == CAN_MSG_RTR) {
-            output[3] |= 0x00000100;
-        }
+        return true;
+    }
+#else
+    // Repack the message straight out of its slot in the reception buffer.
+    const tCanPackedMessage *msg = CMB_PeekContiguous(&ecan1_rx_buffer, NULL);
+
+    if (msg) {
+
+        // The count of messages left includes this one.
+        ecan1_pack_matlab(msg, CMB_GetLength(&ecan1_rx_buffer), output, 1);
 
-        output[3] |= ((uint32_t) receivedMessagesPending--) << 16;
+        // Only now is the slot handed back to the interrupt handler.
+        CMB_Consume(&ecan1_rx_buffer, 1);
 
         return true;
-    } else {
-        int i;
-        for(i = 0; i < 4; i++) {
+    }
+#endif
+
+    for(i = 0; i < 4; i++) {
         output[i] = 0;
+    }
+    return false;
+}
+
+uint8_t ecan1_receive_many(tCanMessage *msgs, uint8_t max)
+{
+#ifdef ECAN1_RX_RAW
+    tCanPackedMessage packed;
+    uint8_t buffer;
+    uint8_t count = 0;
+
+    while (count < max && ecan1_rx_decode(&packed, &buffer)) {
+        CMB_Unpack(&msgs[count], &packed);
+        msgs[count++].buffer = buffer;
+    }
+    return count;
+#else
+    const tCanPackedMessage *slots;
+    uint16_t contiguous;
+    uint16_t first;
+    uint8_t count = 0;
+    uint8_t i;
+
+    // Unpack one contiguous run of slots at a time, along with the receive
+    // buffers they came from, and hand each run back together.
+    while (count < max && (slots = CMB_PeekContiguous(&ecan1_rx_buffer, &contiguous))) {
+        if (contiguous > max - count) {
+            contiguous = max - count;
         }
-        return false;
+        first = (uint16_t) (slots - rx_data_array);
+        for (i = 0; i < contiguous; ++i, ++count) {
+            CMB_Unpack(&msgs[count], &slots[i]);
+            msgs[count].buffer = rx_source_array[first + i];
+        }
+        CMB_Consume(&ecan1_rx_buffer, contiguous);
+    }
+    return count;
+#endif
+}
+
+void ecan1_receive_many_matlab(uint32_t *output)
+{
+    uint16_t left = CMB_GetLength(&ecan1_rx_buffer);
+    uint8_t count = 0;
+    uint8_t i;
+#ifdef ECAN1_RX_RAW
+    tCanPackedMessage packed;
+
+    // Decode and repack messages one at a time.
+    while (count < ECAN1_RECEIVE_MANY_SIZE && ecan1_rx_decode(&packed, NULL)) {
+        // The count of messages left includes this one.
+        ecan1_pack_matlab(&packed, left - count, &output[count], ECAN1_RECEIVE_MANY_SIZE);
+        ++count;
+    }
+#else
+    const tCanPackedMessage *msgs;
+    uint16_t contiguous;
+
+    // Repack messages straight out of the reception buffer, one contiguous run
+    // of slots at a time. There are at most two runs, one on each side of the
+    // end of the buffer.
+    while (count < ECAN1_RECEIVE_MANY_SIZE &&
+           (msgs = CMB_PeekContiguous(&ecan1_rx_buffer, &contiguous))) {
+        if (contiguous > ECAN1_RECEIVE_MANY_SIZE - count) {
+            contiguous = ECAN1_RECEIVE_MANY_SIZE - count;
+        }
+        for (i = 0; i < contiguous; ++i, ++count) {
+            // The count of messages left includes this one.
+            ecan1_pack_matlab(&msgs[i], left - count, &output[count], ECAN1_RECEIVE_MANY_SIZE);
+        }
+        CMB_Consume(&ecan1_rx_buffer, contiguous);
+    }
+#endif
+
+    // Zero the rest of the rows.
+    for (i = count; i < ECAN1_RECEIVE_MANY_SIZE; ++i) {
+        output[i] = 0;
+        output[i + ECAN1_RECEIVE_MANY_SIZE] = 0;
+        output[i + 2 * ECAN1_RECEIVE_MANY_SIZE] = 0;
+        output[i + 3 * ECAN1_RECEIVE_MANY_SIZE] = 0;
     }
+
+    output[4 * ECAN1_RECEIVE_MANY_SIZE] = count;
 }
 
 // NOTE: We do not block for message transmission to complete. Message queuing
 // is handled by the transmission circular buffer.
 
-void ecan1_transmit(const tCanMessage *message)
+/**
+ * Encodes a queued message into one of the message buffers in DMA RAM.
+ */
+static inline void ecan1_write_buffer(uint8_t buffer, const tCanPackedMessage *message)
 {
-    uint32_t word0 = 0, word1 = 0, word2 = 0;
-    uint32_t sid10_0 = 0, eid5_0 = 0, eid17_6 = 0;
-    uint16_t *ecan_msg_buf_ptr = ecan1msgBuf[message->buffer];
-
-    // Variables for setting correct TXREQ bit
-    uint16_t bit_to_set;
-    uint16_t offset;
-    uint16_t *bufferCtrlRegAddr;
+    uint32_t header = message->header;
+    uint16_t word0, word1 = 0, word2 = 0, word6 = message->payload[6];
+    uint16_t *ecan_msg_buf_ptr = ecan1msgBuf[buffer];
 
     // Divide the identifier into bit-chunks for storage
     // into the registers.
-    if (message->frame_type == CAN_FRAME_EXT) {
-        eid5_0 = (message->id & 0x3F);
-        eid17_6 = (message->id >> 6) & 0xFFF;
-        sid10_0 = (message->id >> 18) & 0x7FF;
-        word0 = 1;
-        word1 = eid17_6;
+    if (header & CMB_PACKED_EXT) {
+        word0 = ((uint16_t) (header >> 16) & 0x1FFC) | 1;
+        word1 = (uint16_t) (header >> 6) & 0xFFF;
+        word2 = ((uint16_t) header & 0x3F) << 10;
     } else {
-        sid10_0 = (message->id & 0x7FF);
+        word0 = ((uint16_t) header & 0x7FF) << 2;
     }
 
-    word0 |= (sid10_0 << 2);
-    word2 |= (eid5_0 << 10);
-
     // Set remote transmit bits
-    if (message->message_type == CAN_MSG_RTR) {
+    if (header & CMB_PACKED_RTR) {
         word0 |= 0x2;
         word2 |= 0x0200;
     }
 
+    // The last payload byte holds the length unless all 8 bytes are valid, so
+    // it's only put into the message buffer when they are.
+    if (header & CMB_PACKED_FULL) {
+        word2 |= 8;
+        word6 |= (uint16_t) message->payload[7] << 8;
+    } else {
+        word2 |= message->payload[7];
+    }
+
     ecan_msg_buf_ptr[0] = word0;
     ecan_msg_buf_ptr[1] = word1;
-    ecan_msg_buf_ptr[2] = ((word2 & 0xFFF0) + message->validBytes);
+    ecan_msg_buf_ptr[2] = word2;
     ecan_msg_buf_ptr[3] = ((uint16_t) message->payload[1] << 8 | ((uint16_t) message->payload[0]));
     ecan_msg_buf_ptr[4] = ((uint16_t) message->payload[3] << 8 | ((uint16_t) message->payload[2]));
     ecan_msg_buf_ptr[5] = ((uint16_t) message->payload[5] << 8 | ((uint16_t) message->payload[4]));
-    ecan_msg_buf_ptr[6] = ((uint16_t) message->payload[7] << 8 | ((uint16_t) message->payload[6]));
+    ecan_msg_buf_ptr[6] = word6;
+}
 
-    // Set the correct transfer intialization bit (TXREQ) based on message buffer.
-    offset = message->buffer >> 1;
-    bufferCtrlRegAddr = (uint16_t *) (&C1TR01CON + offset);
-    bit_to_set = 1 << (3 | ((message->buffer & 1) << 3));
-    *bufferCtrlRegAddr |= bit_to_set;
+/**
+ * Returns the control byte of a TX buffer within C1TR01CON..C1TR67CON. Each
+ * buffer's byte is written on its own so the other buffer's TXREQ bit in the
+ * same register is never written back after the module has cleared it.
+ */
+static volatile uint8_t *ecan1_tx_control(uint8_t buffer)
+{
+    return ((volatile uint8_t *) &C1TR01CON) + buffer;
+}
 
-    // Keep track of whether we're in a transmission train or not.
+int ecan1_transmit(const tCanMessage *message)
+{
+    tCanPackedMessage packed;
+    uint8_t buffer = message->buffer;
+    uint16_t interruptEnabled = IEC2bits.C1IE;
+
+    if (buffer >= 8) {
+        return STANDARD_ERROR;
+    }
+
+    // Refuse a buffer still holding a frame, whether the transmission engine
+    // loaded it or an earlier call did. Otherwise mark it as busy so that the
+    // engine doesn't load it, and keep the interrupt handler tracking it until
+    // the frame has left. The interrupt handler also updates all of these, so
+    // it's held off meanwhile.
+    IEC2bits.C1IE = 0;
+    if ((txLoaded | txDirect) & (1 << buffer)) {
+        IEC2bits.C1IE = interruptEnabled;
+        return STANDARD_ERROR;
+    }
+    txDirect |= 1 << buffer;
     currentlyTransmitting = 1;
+    IEC2bits.C1IE = interruptEnabled;
+
+    CMB_Pack(&packed, message);
+    ecan1_write_buffer(buffer, &packed);
+
+    // Make sure the message is in DMA RAM before the module can start sending it.
+    MEMORY_BARRIER();
+
+    // Request the transmission with the buffer's own TXnPRI from ecan1_init().
+    *ecan1_tx_control(buffer) = txControl[buffer] | 0x08;
+    return SUCCESS;
+}
+
+/**
+ * Returns the highest arbitration key below `below` that uses one of the
+ * `free` buffers, or ECAN1_TX_KEYS if there is none. Only the priority of
+ * `below` and the one under it need to be checked, as any free buffer gives a
+ * lower key at the next priority down.
+ */
+static uint8_t ecan1_tx_next_key(uint8_t free, uint8_t below)
+{
+    // The index of the highest set bit of each nibble.
+    static const uint8_t highestBit[16] = {0, 0, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3};
+    uint8_t priority, buffers, n;
+
+    if (!free || !below) {
+        return ECAN1_TX_KEYS;
+    }
+    --below;
+    priority = below >> 3;
+    buffers = free & (0xFF >> (7 - (below & 7)));
+    if (!buffers) {
+        if (!priority) {
+            return ECAN1_TX_KEYS;
+        }
+        --priority;
+        buffers = free;
+    }
+    n = (buffers & 0xF0) ? 4 + highestBit[buffers >> 4] : highestBit[buffers];
+    return (priority << 3) | n;
+}
+
+/**
+ * Returns the next queued message to be sent, or NULL if there is none.
+ */
+static const tCanPackedMessage *ecan1_tx_peek(void)
+{
+#ifdef ECAN1_TX_PRIORITY
+    return CMH_Peek(&ecan1_tx_heap);
+#else
+    return CMB_PeekContiguous(&ecan1_tx_buffer, NULL);
+#endif
+}
+
+/**
+ * Moves the message returned by ecan1_tx_peek() into the TX buffer given by
+ * `key` and requests its transmission. All bookkeeping is done before TXREQ is set, as
+ * the completion interrupt may run straight afterwards.
+ */
+static inline void ecan1_tx_load(uint8_t key, const tCanPackedMessage *message)
+{
+    uint8_t buffer = key & 7;
+
+    ecan1_write_buffer(buffer, message);
+#ifdef ECAN1_TX_PRIORITY
+    CMH_Remove(&ecan1_tx_heap);
+#else
+    CMB_Consume(&ecan1_tx_buffer, 1);
+#endif
+    txLoaded |= 1 << buffer;
+    txLastKey = key;
+
+    // Make sure the message is in DMA RAM before the module can start sending it.
+    MEMORY_BARRIER();
+
+    *ecan1_tx_control(buffer) = (txControl[buffer] & 0x84) | 0x08 | (key >> 3);
+}
+
+/**
+ * Starts transmitting the transmission queue if it isn't already being sent.
+ * Only the first message is loaded from here, the interrupt handler loads the
+ * rest as it goes.
+ */
+static void ecan1_tx_start(void)
+{
+    const tCanPackedMessage *message;
+    uint8_t key;
+
+    if (currentlyTransmitting) {
+        return;
+    }
+
+    // Nothing is in flight, so the interrupt handler won't touch the
+    // transmission engine until this message has been sent.
+    message = ecan1_tx_peek();
+    key = ecan1_tx_next_key(txBuffers & ~txDirect, ECAN1_TX_KEYS);
+    if (message && key < ECAN1_TX_KEYS) {
+        // Keep track of whether we're in a transmission train or not. This
+        // must be set before TXREQ, as the completion interrupt may clear it
+        // again before this function returns.
+        currentlyTransmitting = 1;
+        txLoaded = 0;
+        ecan1_tx_load(key, message);
+    }
+}
+
+/**
+ * Called by the interrupt handler whenever a transmission completes. Refills
+ * every free TX buffer from the transmission queue.
+ */
+static void ecan1_tx_refill(void)
+{
+    const tCanPackedMessage *message;
+    uint8_t loaded = txLoaded | txDirect;
+    uint8_t pending = 0;
+    uint8_t key;
+    uint8_t n;
+
+    // Forget about the buffers the module has finished with, whether they
+    // were loaded from the queue or by ecan1_transmit().
+    for (n = 0; loaded; ++n, loaded >>= 1) {
+        if ((loaded & 1) && (*ecan1_tx_control(n) & 0x08)) {
+            pending |= 1 << n;
+        }
+    }
+#ifdef ECAN1_STATS
+    stats.txCompleted += ecan1_count_bits(txLoaded & ~pending);
+#endif
+#if defined(ECAN1_BUS_LOAD) || defined(ECAN1_TRACE)
+    // The sent frames are still in their buffers until they're refilled.
+    for (n = 0, loaded = (txLoaded | txDirect) & ~pending; loaded; ++n, loaded >>= 1) {
+        if (loaded & 1) {
+#ifdef ECAN1_BUS_LOAD
+            ecan1_bus_count(ecan1msgBuf[n]);
+#endif
+#ifdef ECAN1_TRACE
+            ecan1_trace_record(ecan1msgBuf[n], ECAN1_TRACE_TX);
+#endif
+        }
+    }
+#endif
+    txDirect &= pending;
+    txLoaded &= pending;
+
+    // With nothing pending any arbitration key can be used again.
+    if (!txLoaded) {
+        txLastKey = ECAN1_TX_KEYS;
+    }
+
+    while ((key = ecan1_tx_next_key(txBuffers & ~txLoaded & ~txDirect, txLastKey)) < ECAN1_TX_KEYS &&
+           (message = ecan1_tx_peek())) {
+        ecan1_tx_load(key, message);
+    }
+
+    // Once nothing is in flight any completion flagged during the refill
+    // has already been accounted for, so clear it before handing control
+    // back to the main loop. Otherwise this handler could run again in the
+    // middle of ecan1_tx_start().
+    if (!txLoaded && !txDirect) {
+        C1INTFbits.TBIF = 0;
+    }
+    currentlyTransmitting = (txLoaded || txDirect);
 }
 
 /**
@@ -275,59 +980,132 @@ void ecan1_transmit(const tCanMessage *message)
  */
 void ecan1_buffered_transmit(const tCanMessage *msg)
 {
+#ifdef ECAN1_TX_PRIORITY
+    ecan1_buffered_transmit_many(msg, 1);
+#else
     // Append the message to the queue.
     // Message are only removed upon successful transmission.
     // They will be overwritten by newer message overflowing
     // the circular buffer however.
-    CB_WriteMany(&ecan1_tx_buffer, msg, sizeof(tCanMessage), true);
+#ifdef ECAN1_STATS
+    if (!CMB_Write(&ecan1_tx_buffer, msg)) {
+        ++stats.txDropped;
+    }
+    ecan1_stats_tx_queued();
+#else
+    CMB_Write(&ecan1_tx_buffer, msg);
+#endif
 
     // If this is the only message in the queue, attempt to
     // transmit it.
-    if (!currentlyTransmitting) {
-        ecan1_transmit(msg);
-    }
+    ecan1_tx_start();
+#endif
 }
 
 /**
- * Merely preprocesses data from the MATLAB array format
- * into a tCanMessage to be passed to ecan1_buffered_transmit()
+ * Unpacks a message from the MATLAB array format used by the transmission
+ * functions. Consecutive words are `stride` elements apart so that rows of a
+ * column-major matrix can be read.
  */
-void ecan1_buffered_transmit_matlab(const uint16_t *data)
+static void ecan1_unpack_matlab(const uint16_t *data, uint16_t stride, tCanMessage *message)
 {
-    tCanMessage message;
-
-    message.id = ((uint32_t) data[1]) | (((uint32_t) data[2]) << 16);
-    message.buffer = (uint8_t) data[0];
+    message->id = ((uint32_t) data[stride]) | (((uint32_t) data[2 * stride]) << 16);
+    message->buffer = (uint8_t) data[0];
 
     // Set remote transmit bits
-    if ((data[3] & 0xFF00) == 0) {
-        message.message_type = CAN_MSG_DATA;
+    if ((data[3 * stride] & 0xFF00) == 0) {
+        message->message_type = CAN_MSG_DATA;
     } else {
-        message.message_type = CAN_MSG_RTR;
+        message->message_type = CAN_MSG_RTR;
     }
 
     // Set extended frame bits
-    if ((data[3] & 0xFF) == 0) {
-        message.frame_type = CAN_FRAME_STD;
+    if ((data[3 * stride] & 0xFF) == 0) {
+        message->frame_type = CAN_FRAME_STD;
     } else {
-        message.frame_type = CAN_FRAME_EXT;
+        message->frame_type = CAN_FRAME_EXT;
     }
 
     // Set data and data length bits
-    message.payload[0] = (uint8_t) data[4];
-    message.payload[1] = (uint8_t) ((data[4] & 0xFF00) >> 8);
-    message.payload[2] = (uint8_t) data[5];
-    message.payload[3] = (uint8_t) ((data[5] & 0xFF00) >> 8);
-    message.payload[4] = (uint8_t) data[6];
-    message.payload[5] = (uint8_t) ((data[6] & 0xFF00) >> 8);
-    message.payload[6] = (uint8_t) data[7];
-    message.payload[7] = (uint8_t) ((data[7] & 0xFF00) >> 8);
-    message.validBytes = (data[0] & 0xFF00) >> 8;
-
-    // Transmit the message via the circular buffer
+    message->payload[0] = (uint8_t) data[4 * stride];
+    message->payload[1] = (uint8_t) ((data[4 * stride] & 0xFF00) >> 8);
+    message->payload[2] = (uint8_t) data[5 * stride];
+    message->payload[3] = (uint8_t) ((data[5 * stride] & 0xFF00) >> 8);
+    message->payload[4] = (uint8_t) data[6 * stride];
+    message->payload[5] = (uint8_t) ((data[6 * stride] & 0xFF00) >> 8);
+    message->payload[6] = (uint8_t) data[7 * stride];
+    message->payload[7] = (uint8_t) ((data[7 * stride] & 0xFF00) >> 8);
+    message->validBytes = (data[0] & 0xFF00) >> 8;
+}
+
+/**
+ * Merely preprocesses data from the MATLAB array format
+ * into a tCanMessage queued like ecan1_buffered_transmit() would.
+ */
+void ecan1_buffered_transmit_matlab(const uint16_t *data)
+{
+    tCanMessage message;
+
+    // The message is packed on its way into the queue. If the queue is full
+    // the message is dropped.
+    ecan1_unpack_matlab(data, 1, &message);
     ecan1_buffered_transmit(&message);
 }
 
+uint8_t ecan1_buffered_transmit_many(const tCanMessage *msgs, uint8_t count)
+{
+#ifdef ECAN1_TX_PRIORITY
+    // The heap is shared with the interrupt handler, so hold it off while the
+    // messages are sorted in. Messages that don't fit are counted as overflows.
+    uint16_t interruptEnabled = IEC2bits.C1IE;
+    uint8_t queued = 0;
+    uint8_t i;
+
+    IEC2bits.C1IE = 0;
+    for (i = 0; i < count; ++i) {
+        if (CMH_Push(&ecan1_tx_heap, &msgs[i])) {
+            ++queued;
+        }
+    }
+#ifdef ECAN1_STATS
+    stats.txDropped += count - queued;
+    ecan1_stats_tx_queued();
+#endif
+    ecan1_tx_start();
+    IEC2bits.C1IE = interruptEnabled;
+#else
+    // Append all the messages to the queue at once.
+    uint8_t queued = (uint8_t) CMB_WriteMany(&ecan1_tx_buffer, msgs, count);
+#ifdef ECAN1_STATS
+    stats.txDropped += count - queued;
+    ecan1_stats_tx_queued();
+#endif
+
+    // If these are the only messages in the queue, start transmitting the
+    // first. The interrupt handler takes care of the rest.
+    ecan1_tx_start();
+#endif
+
+    return queued;
+}
+
+void ecan1_buffered_transmit_many_matlab(const uint16_t *data)
+{
+    tCanMessage msgs[ECAN1_TRANSMIT_MANY_SIZE];
+    uint16_t count = data[8 * ECAN1_TRANSMIT_MANY_SIZE];
+    uint8_t i;
+
+    if (count > ECAN1_TRANSMIT_MANY_SIZE) {
+        count = ECAN1_TRANSMIT_MANY_SIZE;
+    }
+
+    for (i = 0; i < count; ++i) {
+        ecan1_unpack_matlab(&data[i], ECAN1_TRANSMIT_MANY_SIZE, &msgs[i]);
+    }
+
+    ecan1_buffered_transmit_many(msgs, (uint8_t) count);
+}
+
 void ecan1_error_status_matlab(uint8_t *errors)
 {
     // Set transmission errors in first array element.
@@ -367,121 +1145,600 @@ void dma_init(const uint16_t *parameters)
     *secAddrOffsetRegAddr = (uint16_t) parameters[5]; // Set secondary DPSRAM start address bits
 
     // Setup the configuration register & enable DMA
-    *chanCtrlRegAddr = (uint16_t) (0x8000 | ((parameters[0] & 0x00F0) << 7) | ((parameters[0] & 0x000C) << 2));
+    *chanCtrlRegAddr = (uint16_t) (0x8000 | ((parameters[0] & 0x00F0) << 7) | ((parameters[0] & 0x000C) << 2) |
+                                   (parameters[0] & 0x0003));
+}
+
+uint16_t ecan1_rx_coalesced(void)
+{
+    return rxCoalesced;
+}
+
+int ecan1_stats_get(tEcan1Stats *out)
+{
+#ifdef ECAN1_STATS
+    uint16_t interruptEnabled = IEC2bits.C1IE;
+    uint64_t total;
+
+    IEC2bits.C1IE = 0;
+    *out = stats;
+    total = isrTotalCycles;
+    IEC2bits.C1IE = interruptEnabled;
+
+    if (out->isrCount) {
+        out->isrAverageCycles = (uint16_t) (total / out->isrCount);
+    } else {
+        out->isrMinCycles = 0;
+    }
+    return SUCCESS;
+#else
+    (void) out;
+    return STANDARD_ERROR;
+#endif
+}
+
+void ecan1_stats_reset(void)
+{
+#ifdef ECAN1_STATS
+    uint16_t interruptEnabled = IEC2bits.C1IE;
+
+    IEC2bits.C1IE = 0;
+    memset(&stats, 0, sizeof(stats));
+    stats.isrMinCycles = 0xFFFF;
+    isrTotalCycles = 0;
+    IEC2bits.C1IE = interruptEnabled;
+#endif
+}
+
+void ecan1_stats_matlab(uint32_t *output)
+{
+    tEcan1Stats s;
+
+    if (!ecan1_stats_get(&s)) {
+        memset(output, 0, ECAN1_STATS_MATLAB_SIZE * sizeof(uint32_t));
+        return;
+    }
+    output[0] = s.isrCount;
+    output[1] = s.isrMinCycles;
+    output[2] = s.isrMaxCycles;
+    output[3] = s.isrAverageCycles;
+    output[4] = s.rxHighWatermark;
+    output[5] = s.txHighWatermark;
+    output[6] = s.rxDropped;
+    output[7] = s.rxOverflowed;
+    output[8] = s.txDropped;
+    output[9] = s.txCompleted;
+}
+
+void ecan1_bus_load_update(void)
+{
+#ifdef ECAN1_BUS_LOAD
+    uint16_t interruptEnabled = IEC2bits.C1IE;
+    uint32_t bits;
+
+    // busBits is 32 bits wide, so it's read with the interrupt held off.
+    IEC2bits.C1IE = 0;
+    bits = busBits;
+    IEC2bits.C1IE = interruptEnabled;
+
+    // Replace the oldest period in the window with this one.
+    busWindowBits -= busWindow[busWindowNext];
+    busWindow[busWindowNext] = bits - busBitsUpdated;
+    busWindowBits += busWindow[busWindowNext];
+    busBitsUpdated = bits;
+    if (++busWindowNext == ECAN1_BUS_LOAD_WINDOW) {
+        busWindowNext = 0;
+    }
+    if (busWindowFilled < ECAN1_BUS_LOAD_WINDOW) {
+        ++busWindowFilled;
+    }
+#endif
+}
+
+uint16_t ecan1_bus_load(void)
+{
+#ifdef ECAN1_BUS_LOAD
+    uint64_t capacity = (uint64_t) busPeriodBits * busWindowFilled;
+    uint64_t load;
+
+    if (!capacity) {
+        return 0;
+    }
+    load = (uint64_t) busWindowBits * 10000 / capacity;
+    return load > 10000 ? 10000 : (uint16_t) load;
+#else
+    return 0;
+#endif
+}
+
+void ecan1_bus_load_matlab(uint16_t *load)
+{
+    ecan1_bus_load_update();
+    *load = ecan1_bus_load();
+}
+
+void ecan1_trace_start(void)
+{
+#ifdef ECAN1_TRACE
+    uint16_t interruptEnabled = IEC2bits.C1IE;
+
+    IEC2bits.C1IE = 0;
+    traceRead = traceWritten;
+    traceState = ECAN1_TRACE_RUNNING;
+    IEC2bits.C1IE = interruptEnabled;
+#endif
+}
+
+void ecan1_trace_trigger(uint32_t id, uint32_t mask, uint16_t after)
+{
+#ifdef ECAN1_TRACE
+    uint16_t interruptEnabled = IEC2bits.C1IE;
+
+    IEC2bits.C1IE = 0;
+    traceRead = traceWritten;
+    traceTriggerId = id & mask;
+    traceTriggerMask = mask;
+    traceAfter = after;
+    traceState = ECAN1_TRACE_ARMED;
+    IEC2bits.C1IE = interruptEnabled;
+#else
+    (void) id;
+    (void) mask;
+    (void) after;
+#endif
+}
+
+void ecan1_trace_freeze(void)
+{
+#ifdef ECAN1_TRACE
+    traceState = ECAN1_TRACE_FROZEN;
+#endif
+}
+
+uint8_t ecan1_trace_state(void)
+{
+#ifdef ECAN1_TRACE
+    return traceState;
+#else
+    return ECAN1_TRACE_OFF;
+#endif
+}
+
+uint16_t ecan1_trace_read(tEcan1TraceRecord *records, uint16_t max)
+{
+#ifdef ECAN1_TRACE
+    uint16_t interruptEnabled = IEC2bits.C1IE;
+    uint16_t count = 0;
+
+    // While the trace is recording the interrupt handler may be about to
+    // overwrite the oldest record, so it's held off while each is copied.
+    while (count < max) {
+        IEC2bits.C1IE = 0;
+        if ((uint16_t) (traceWritten - traceRead) > ECAN1_TRACE) {
+            traceRead = traceWritten - ECAN1_TRACE;
+        }
+        if (traceRead == traceWritten) {
+            IEC2bits.C1IE = interruptEnabled;
+            break;
+        }
+        records[count++] = trace[traceRead++ & (ECAN1_TRACE - 1)];
+        IEC2bits.C1IE = interruptEnabled;
+    }
+    return count;
+#else
+    (void) records;
+    (void) max;
+    return 0;
+#endif
 }
 
 /**
- * This is an interrupt handler for the ECAN1 peripheral.
- * It clears interrupt bits and pushes received message into
- * the circular buffer.
+ * Returns whether the given receive buffer holds a message.
  */
-void __attribute__((interrupt, no_auto_psv))_C1Interrupt(void)
+static inline bool ecan1_rx_full(uint8_t buffer)
 {
-    // Give us a CAN message struct to populate and use
-    tCanMessage message;
-    uint8_t ide = 0;
-    uint8_t srr = 0;
-    uint32_t id = 0;
-    uint16_t *ecan_msg_buf_ptr;
-
-    // If the interrupt was set because of a transmit, check to
-    // see if more messages are in the circular buffer and start
-    // transmitting them.
-    if (C1INTFbits.TBIF) {
+    if (buffer < 16) {
+        return (C1RXFUL1 & (1 << buffer)) != 0;
+    }
+    return (C1RXFUL2 & (1 << (buffer - 16))) != 0;
+}
 
-        // After a successfully sent message, there should be at least
-        // one message in the queue, so pop it off.
-        CB_ReadMany(&ecan1_tx_buffer, &message, sizeof(tCanMessage));
+int ecan1_rx_filter_set(const uint32_t *ids, uint16_t count)
+{
+#ifdef ECAN1_RX_FILTER
+    uint16_t interruptEnabled;
+    uint16_t i;
 
-        // Check for a buffer overflow. Then clear the entire buffer if there was.
-        if (ecan1_tx_buffer.overflowCount) {
-            CB_Init(&ecan1_tx_buffer, tx_data_array, ECAN1_BUFFERSIZE);
+    if (!ids) {
+        count = 0;
+    }
+    for (i = 1; i < count; ++i) {
+        if (ids[i] < ids[i - 1]) {
+            return STANDARD_ERROR;
         }
+    }
+
+    // Hold off the interrupt handler so it never sees a table with the
+    // wrong count.
+    interruptEnabled = IEC2bits.C1IE;
+    IEC2bits.C1IE = 0;
+    rxFilterIds = ids;
+    rxFilterCount = count;
+    IEC2bits.C1IE = interruptEnabled;
+    return SUCCESS;
+#else
+    (void) ids;
+    (void) count;
+    return STANDARD_ERROR;
+#endif
+}
+
+uint16_t ecan1_rx_filtered(void)
+{
+    return rxFiltered;
+}
+
+#ifdef ECAN1_RX_FILTER
+/**
+ * Returns whether a frame with the given identifier, as returned by
+ * ecan1_decode_id(), passes the software filter.
+ */
+static inline bool ecan1_rx_accept(uint32_t id)
+{
+    const uint32_t *ids = rxFilterIds;
+    uint16_t low = 0;
+    uint16_t high = rxFilterCount;
+    uint16_t middle;
 
-        // Now if there's still a message left in the buffer,
-        // try to transmit it.
-        if (ecan1_tx_buffer.dataSize >= sizeof(tCanMessage)) {
-            tCanMessage msg;
-            CB_PeekMany(&ecan1_tx_buffer, &msg, sizeof(tCanMessage));
-            ecan1_transmit(&msg);
+    if (!ids) {
+        return true;
+    }
+
+    // Find the first entry that isn't below the identifier.
+    while (low < high) {
+        middle = (low + high) >> 1;
+        if (ids[middle] < id) {
+            low = middle + 1;
         } else {
-            currentlyTransmitting = 0;
+            high = middle;
         }
+    }
+    return low < rxFilterCount && ids[low] == id;
+}
+#endif
 
-        C1INTFbits.TBIF = 0;
+#ifdef ECAN1_MAILBOXES
+/**
+ * Returns the first mailbox hash table slot to look at for an identifier.
+ */
+static inline uint8_t ecan1_mailbox_hash(uint32_t id)
+{
+    return (uint8_t) (id ^ (id >> 7) ^ (id >> 18)) & (ECAN1_MAILBOX_SLOTS - 1);
+}
+
+/**
+ * Returns the mailbox for an identifier, as returned by ecan1_decode_id(), or
+ * NULL if it has none.
+ */
+static inline tEcan1Mailbox *ecan1_mailbox_find(uint32_t id)
+{
+    uint8_t slot = ecan1_mailbox_hash(id);
+    uint8_t index;
+
+    while ((index = mailboxSlots[slot])) {
+        if (mailboxes[index - 1].id == id) {
+            return &mailboxes[index - 1];
+        }
+        slot = (slot + 1) & (ECAN1_MAILBOX_SLOTS - 1);
     }
+    return NULL;
+}
+#endif
 
-    // If the interrupt was fired because of a received message
-    // package it all up and store in the circular buffer.
-    if (C1INTFbits.RBIF) {
+int ecan1_mailbox_set(const uint32_t *ids, uint16_t count)
+{
+#ifdef ECAN1_MAILBOXES
+    uint16_t interruptEnabled;
+    uint16_t i, j;
+    uint8_t slot;
 
-        // Obtain the buffer the message was stored into, checking that the value is valid to refer to a buffer
-        if (C1VECbits.ICODE < 32) {
-            message.buffer = C1VECbits.ICODE;
+    if (!ids) {
+        count = 0;
+    }
+    if (count > ECAN1_MAILBOXES) {
+        return STANDARD_ERROR;
+    }
+    for (i = 1; i < count; ++i) {
+        for (j = 0; j < i; ++j) {
+            if (ids[i] == ids[j]) {
+                return STANDARD_ERROR;
+            }
         }
+    }
 
-        ecan_msg_buf_ptr = ecan1msgBuf[message.buffer];
+    // Hold off the interrupt handler while the table is rebuilt.
+    interruptEnabled = IEC2bits.C1IE;
+    IEC2bits.C1IE = 0;
+    for (slot = 0; slot < ECAN1_MAILBOX_SLOTS; ++slot) {
+        mailboxSlots[slot] = 0;
+    }
+    for (i = 0; i < count; ++i) {
+        mailboxes[i].id = ids[i];
+        mailboxes[i].sequence = 0;
+        mailboxes[i].readSequence = 0;
+        slot = ecan1_mailbox_hash(ids[i]);
+        while (mailboxSlots[slot]) {
+            slot = (slot + 1) & (ECAN1_MAILBOX_SLOTS - 1);
+        }
+        mailboxSlots[slot] = (uint8_t) (i + 1);
+    }
+    IEC2bits.C1IE = interruptEnabled;
+    return SUCCESS;
+#else
+    (void) ids;
+    (void) count;
+    return STANDARD_ERROR;
+#endif
+}
 
-        // Clear the buffer full status bit so more messages can be received.
-        if (C1RXFUL1 & (1 << message.buffer)) {
-            C1RXFUL1 &= ~(1 << message.buffer);
+#ifdef ECAN1_MAILBOXES
+/**
+ * Copies a mailbox out along with the number of updates since it was last
+ * read, and the receive buffer its frame came from unless `buffer` is NULL.
+ * Returns false if it hasn't received a frame.
+ */
+static bool ecan1_mailbox_copy(tEcan1Mailbox *box, tCanPackedMessage *packed, uint8_t *buffer,
+                               uint16_t *updates)
+{
+    uint16_t sequence;
+
+    // The interrupt handler bumps the sequence whenever it overwrites the
+    // message, so a copy is only consistent if the sequence didn't change.
+    do {
+        sequence = box->sequence;
+        MEMORY_BARRIER();
+        *packed = box->message;
+        if (buffer) {
+            *buffer = box->buffer;
         }
+        MEMORY_BARRIER();
+    } while (sequence != box->sequence);
 
-        //  Move the message from the DMA buffer to a data structure and then push it into our circular buffer.
+    if (!sequence) {
+        return false;
+    }
+    *updates = sequence - box->readSequence;
+    box->readSequence = sequence;
+    return true;
+}
+#endif
 
-        // Read the first word to see the message type
-        ide = ecan_msg_buf_ptr[0] & 0x0001;
-        srr = ecan_msg_buf_ptr[0] & 0x0002;
+int ecan1_mailbox_read(uint32_t id, tCanMessage *msg, uint16_t *updates)
+{
+#ifdef ECAN1_MAILBOXES
+    tEcan1Mailbox *box = ecan1_mailbox_find(id);
+    tCanPackedMessage packed;
+    uint8_t buffer;
+    uint16_t count;
+
+    if (!box || !ecan1_mailbox_copy(box, &packed, &buffer, &count)) {
+        return STANDARD_ERROR;
+    }
+    CMB_Unpack(msg, &packed);
+    msg->buffer = buffer;
+    if (updates) {
+        *updates = count;
+    }
+    return SUCCESS;
+#else
+    (void) id;
+    (void) msg;
+    (void) updates;
+    return STANDARD_ERROR;
+#endif
+}
 
-        /* Format the message properly according to whether it
-         * uses an extended identifier or not.
-         */
-        if (ide == 0) {
-            message.frame_type = CAN_FRAME_STD;
+int ecan1_mailbox_read_matlab(uint32_t id, uint32_t *output)
+{
+#ifdef ECAN1_MAILBOXES
+    tEcan1Mailbox *box = ecan1_mailbox_find(id);
+    tCanPackedMessage packed;
+    uint16_t count;
 
-            message.id = (uint32_t) ((ecan_msg_buf_ptr[0] & 0x1FFC) >> 2);
-        } else {
-            message.frame_type = CAN_FRAME_EXT;
-
-            id = ecan_msg_buf_ptr[0] & 0x1FFC;
-            message.id = id << 16;
-            id = ecan_msg_buf_ptr[1] & 0x0FFF;
-            message.id |= id << 6;
-            id = ecan_msg_buf_ptr[2] & 0xFC00;
-            message.id |= id >> 10;
-        }
+    if (!box || !ecan1_mailbox_copy(box, &packed, NULL, &count)) {
+        return STANDARD_ERROR;
+    }
+    ecan1_pack_matlab(&packed, count, output, 1);
+    return SUCCESS;
+#else
+    (void) id;
+    (void) output;
+    return STANDARD_ERROR;
+#endif
+}
 
-        /* If message is a remote transmit request, mark it as such.
-         * Otherwise it will be a regular transmission so fill its
-         * payload with the relevant data.
-         */
-        if (srr == 1) {
-            message.message_type = CAN_MSG_RTR;
-        } else {
-            message.message_type = CAN_MSG_DATA;
-
-            message.validBytes = (uint8_t) (ecan_msg_buf_ptr[2] & 0x000F);
-            message.payload[0] = (uint8_t) ecan_msg_buf_ptr[3];
-            message.payload[1] = (uint8_t) ((ecan_msg_buf_ptr[3] & 0xFF00) >> 8);
-            message.payload[2] = (uint8_t) ecan_msg_buf_ptr[4];
-            message.payload[3] = (uint8_t) ((ecan_msg_buf_ptr[4] & 0xFF00) >> 8);
-            message.payload[4] = (uint8_t) ecan_msg_buf_ptr[5];
-            message.payload[5] = (uint8_t) ((ecan_msg_buf_ptr[5] & 0xFF00) >> 8);
-            message.payload[6] = (uint8_t) ecan_msg_buf_ptr[6];
-            message.payload[7] = (uint8_t) ((ecan_msg_buf_ptr[6] & 0xFF00) >> 8);
+/**
+ * Copies a receive buffer into the next slot of the reception buffer. The
+ * message is decoded into its packed form here, or later by ecan1_rx_decode()
+ * with ECAN1_RX_RAW.
+ */
+static inline void ecan1_rx_store(uint8_t buffer)
+{
+    // If the reception buffer is full the message is dropped, which
+    // is recorded in its overflowCount.
+#ifdef ECAN1_RX_RAW
+    tCanRawMessage *message = CMB_ReserveRaw(&ecan1_rx_buffer);
+    if (message) {
+        memcpy(message->words, ecan1msgBuf[buffer], sizeof(message->words));
+        rx_source_array[message - rx_data_array] = buffer;
+        CMB_Commit(&ecan1_rx_buffer);
+    }
+#else
+    tCanPackedMessage *message = CMB_Reserve(&ecan1_rx_buffer);
+    if (message) {
+        ecan1_decode(ecan1msgBuf[buffer], message);
+        rx_source_array[message - rx_data_array] = buffer;
+        CMB_Commit(&ecan1_rx_buffer);
+    }
+#endif
+#ifdef ECAN1_STATS
+    if (!message) {
+        ++stats.rxDropped;
+    }
+#endif
+}
+
+/**
+ * Stores the message in a receive buffer into its mailbox, or else queues it
+ * unless the software filter rejects it, then hands the message buffer back to
+ * the module.
+ */
+static inline void ecan1_rx_read(uint8_t buffer)
+{
+    bool queue = true;
+#if defined(ECAN1_MAILBOXES) || defined(ECAN1_RX_FILTER)
+    uint32_t id = ecan1_decode_id(ecan1msgBuf[buffer]);
+#endif
+
+#ifdef ECAN1_BUS_LOAD
+    ecan1_bus_count(ecan1msgBuf[buffer]);
+#endif
+#ifdef ECAN1_TRACE
+    ecan1_trace_record(ecan1msgBuf[buffer], 0);
+#endif
+
+#ifdef ECAN1_MAILBOXES
+    tEcan1Mailbox *box = ecan1_mailbox_find(id);
+    if (box) {
+        ecan1_decode(ecan1msgBuf[buffer], &box->message);
+        box->buffer = buffer;
+        if (!++box->sequence) {
+            box->sequence = 1;
         }
+        queue = false;
+    }
+#endif
+#ifdef ECAN1_RX_FILTER
+    if (queue && !ecan1_rx_accept(id)) {
+        ++rxFiltered;
+        queue = false;
+    }
+#endif
+    if (queue) {
+        ecan1_rx_store(buffer);
+    }
 
-        // Store the message in the buffer
-        CB_WriteMany(&ecan1_rx_buffer, &message, sizeof(tCanMessage), true);
+    // Now that the message has been read out, clear the buffer full
+    // status bit so more messages can be received.
+    if (buffer < 16) {
+        C1RXFUL1 &= ~(1 << buffer);
+    } else {
+        C1RXFUL2 &= ~(1 << (buffer - 16));
+    }
+}
 
-        // Increase the number of messages stored in the buffer
-        ++receivedMessagesPending;
+/**
+ * This is an interrupt handler for the ECAN1 peripheral.
+ * It clears interrupt bits and pushes received message into
+ * the circular buffer.
+ */
+void __attribute__((interrupt, no_auto_psv))_C1Interrupt(void)
+{
+#ifdef ECAN1_STATS
+    uint16_t start = ECAN1_STATS_TIMER;
+    uint16_t cycles;
+#endif
+    uint8_t buffer;
+    uint8_t frames;
+    uint16_t full;
 
-        // Be sure to clear the interrupt flag.
+    // Clear the general ECAN1 interrupt flag first, so that any event
+    // flagged while this runs triggers the interrupt again.
+    IFS2bits.C1IF = 0;
+
+    // If the interrupt was set because of a transmit, refill the TX
+    // buffers that have been sent from the circular buffer. The flag is
+    // cleared first so that a buffer finishing during the refill isn't
+    // missed.
+    if (C1INTFbits.TBIF) {
+        C1INTFbits.TBIF = 0;
+        ecan1_tx_refill();
+    }
+
+    // If the interrupt was fired because of a received message decode
+    // every full receive buffer straight into the circular buffer, rather
+    // than only the one ICODE names. Again the flag is cleared first so no
+    // message goes unnoticed.
+    if (C1INTFbits.RBIF) {
         C1INTFbits.RBIF = 0;
+        frames = 0;
+
+        full = C1RXFUL1 & ECAN1_RXFUL1_MASK;
+        for (buffer = 0; full; ++buffer, full >>= 1) {
+            if (full & 1) {
+                ecan1_rx_read(buffer);
+                ++frames;
+            }
+        }
+#if ECAN1_RXFUL2_MASK
+        full = C1RXFUL2 & ECAN1_RXFUL2_MASK;
+        for (buffer = 16; full; ++buffer, full >>= 1) {
+            if (full & 1) {
+                ecan1_rx_read(buffer);
+                ++frames;
+            }
+        }
+#endif
+
+#ifdef ECAN1_FIFO_START
+        // Then empty the FIFO in order, starting from the next buffer to be
+        // read (FNRB). Each buffer emptied moves FNRB on to the next one, so
+        // this follows it in software rather than reading it again.
+        buffer = C1FIFObits.FNRB;
+        while (ecan1_rx_full(buffer)) {
+            ecan1_rx_read(buffer);
+            ++frames;
+            if (++buffer == ECAN1_DMA_BUFFERS) {
+                buffer = ECAN1_FIFO_START;
+            }
+        }
+#endif
+
+        if (frames > 1) {
+            rxCoalesced += frames - 1;
+        }
     }
 
-    // Clear the general ECAN1 interrupt flag.
-    IFS2bits.C1IF = 0;
+#ifdef ECAN1_STATS
+    // Count the frames the module couldn't store because their receive
+    // buffer was still full. Only the overflow bits that were counted are
+    // cleared, in case another is set meanwhile.
+    full = C1RXOVF1;
+    if (full) {
+        C1RXOVF1 &= ~full;
+        stats.rxOverflowed += ecan1_count_bits(full);
+        C1INTFbits.RBOVIF = 0;
+    }
+    full = C1RXOVF2;
+    if (full) {
+        C1RXOVF2 &= ~full;
+        stats.rxOverflowed += ecan1_count_bits(full);
+        C1INTFbits.RBOVIF = 0;
+    }
+
+    full = CMB_GetLength(&ecan1_rx_buffer);
+    if (full > stats.rxHighWatermark) {
+        stats.rxHighWatermark = full;
+    }
 
+    cycles = ECAN1_STATS_TIMER - start;
+    ++stats.isrCount;
+    isrTotalCycles += cycles;
+    if (cycles < stats.isrMinCycles) {
+        stats.isrMinCycles = cycles;
+    }
+    if (cycles > stats.isrMaxCycles) {
+        stats.isrMaxCycles = cycles;
+    }
+#endif
 }
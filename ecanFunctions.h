@@ -16,7 +16,166 @@
 //If simulating, remove the include p33Fxxxx.h  Otherwise, leave it.
 #include <p33fxxxx.h>
 #include "ecanDefinitions.h"
-#include "CircularBuffer.h"
+#include "CanMessageBuffer.h"
+#include "CanMessageHeap.h"
+
+// Specify the number of messages returned by each call to
+// ecan1_receive_many_matlab(). This can be overridden by user code, but the
+// output size of the Receive ECAN1 Messages block must then be changed to match.
+#ifndef ECAN1_RECEIVE_MANY_SIZE
+#define ECAN1_RECEIVE_MANY_SIZE 8
+#endif
+
+// Specify the most messages passed to each call of
+// ecan1_buffered_transmit_many_matlab(). This can be overridden by user code,
+// but the input size of the Send ECAN1 Messages block must then be changed to
+// match.
+#ifndef ECAN1_TRANSMIT_MANY_SIZE
+#define ECAN1_TRANSMIT_MANY_SIZE 8
+#endif
+
+// Define ECAN1_TX_PRIORITY to send queued messages in CAN arbitration order,
+// lowest identifier first, instead of in the order they were queued. Messages
+// with the same identifier are still sent in order. The transmission buffer is
+// then replaced by a heap of ECAN1_TX_PRIORITY_SIZE messages (at most 255),
+// and queueing briefly masks the ECAN1 interrupt.
+#if defined(ECAN1_TX_PRIORITY) && !defined(ECAN1_TX_PRIORITY_SIZE)
+#define ECAN1_TX_PRIORITY_SIZE 16
+#endif
+
+// Specify the number of message buffers in DMA RAM, which sets DMABS. This
+// can be overridden by user code with 4, 6, 8, 12, 16, 24 or 32.
+#ifndef ECAN1_DMA_BUFFERS
+#define ECAN1_DMA_BUFFERS 4
+#endif
+#if ECAN1_DMA_BUFFERS != 4 && ECAN1_DMA_BUFFERS != 6 && ECAN1_DMA_BUFFERS != 8 && \
+    ECAN1_DMA_BUFFERS != 12 && ECAN1_DMA_BUFFERS != 16 && ECAN1_DMA_BUFFERS != 24 && \
+    ECAN1_DMA_BUFFERS != 32
+#error "ECAN1_DMA_BUFFERS must be 4, 6, 8, 12, 16, 24 or 32."
+#endif
+
+// Define ECAN1_FIFO_START to use buffers ECAN1_FIFO_START through
+// ECAN1_DMA_BUFFERS - 1 as a receive FIFO (sets FSA). Filters are pointed at
+// the FIFO with a buffer pointer of 15. Bursts of frames are then spread over
+// the whole FIFO instead of overrunning a single buffer before the interrupt
+// handler can empty it. The TX buffers must all be below ECAN1_FIFO_START.
+#ifdef ECAN1_FIFO_START
+#if ECAN1_FIFO_START >= ECAN1_DMA_BUFFERS
+#error "ECAN1_FIFO_START must be below ECAN1_DMA_BUFFERS."
+#endif
+#endif
+
+// Define ECAN1_RX_RAW to have the interrupt handler queue received message
+// buffers exactly as they are in DMA RAM, with a single block copy, and leave
+// decoding them to the reception functions in the main loop. This shortens the
+// time spent in the interrupt handler. Raw messages take 16 bytes each rather
+// than 12, so the reception buffer holds fewer of them for the same
+// ECAN1_BUFFERSIZE.
+
+// Define ECAN1_RX_FILTER to check every received frame against a table of
+// wanted identifiers, set with ecan1_rx_filter_set(), before it's queued. This
+// is a second stage behind the hardware filters for when there are more
+// wanted identifiers than they can match exactly.
+
+// Marks an identifier in an ecan1_rx_filter_set() table as extended.
+#define ECAN1_FILTER_EXT(id) ((uint32_t) (id) | CMB_PACKED_EXT)
+
+// Define ECAN1_MAILBOXES to keep only the latest frame for up to that many
+// identifiers (at most 64), chosen with ecan1_mailbox_set(). Frames with a
+// mailbox overwrite it in the interrupt handler instead of being queued, so
+// high-rate periodic frames don't crowd others out of the reception buffer.
+// Mailboxes are read with ecan1_mailbox_read().
+#ifdef ECAN1_MAILBOXES
+#if ECAN1_MAILBOXES < 1 || ECAN1_MAILBOXES > 64
+#error "ECAN1_MAILBOXES must be between 1 and 64."
+#endif
+#endif
+
+// Define ECAN1_STATS to have the driver keep the statistics returned by
+// ecan1_stats_get(): how long the interrupt handler takes, how full the queues
+// get, and how many frames are lost. Interrupt handler durations are read from
+// ECAN1_STATS_TIMER, TMR1 by default, which user code must leave running with
+// a period of 0xFFFF. With a 1:1 prescaler they're in instruction cycles, and
+// they don't include the handler's context save and restore.
+#if defined(ECAN1_STATS) && !defined(ECAN1_STATS_TIMER)
+#define ECAN1_STATS_TIMER TMR1
+#endif
+
+/**
+ * The statistics kept with ECAN1_STATS since ecan1_init() or
+ * ecan1_stats_reset(). The counts wrap around at 2^32, which takes over a day
+ * even with the interrupt handler running for every frame of a saturated
+ * 1Mbit/s bus, so they should be reset at least that often.
+ */
+typedef struct {
+    uint32_t isrCount;           // Interrupt handler runs.
+    uint16_t isrMinCycles;       // Shortest interrupt handler run, or 0 if there's been none.
+    uint16_t isrMaxCycles;       // Longest interrupt handler run.
+    uint16_t isrAverageCycles;   // Mean interrupt handler run.
+    uint16_t rxHighWatermark;    // The most messages the reception buffer has held.
+    uint16_t txHighWatermark;    // The most messages the transmission queue has held.
+    uint32_t rxDropped;          // Received frames lost because the reception buffer was full.
+    uint32_t rxOverflowed;       // Received frames lost by the module because a receive buffer was still full (C1RXOVF1/2).
+    uint32_t txDropped;          // Messages not queued because the transmission queue was full.
+    uint32_t txCompleted;        // Messages transmitted from the transmission queue.
+} tEcan1Stats;
+
+// The number of elements output by ecan1_stats_matlab().
+#define ECAN1_STATS_MATLAB_SIZE 10
+
+// Define ECAN1_BUS_LOAD to estimate the bus load from the frames this node
+// receives and transmits, counting the bits each occupies on the bus with
+// worst-case bit stuffing. ecan1_bus_load_update() must be called every
+// ECAN1_BUS_LOAD_PERIOD_US microseconds, 10ms by default, and the load is
+// averaged over the last ECAN1_BUS_LOAD_WINDOW periods, 10 by default.
+#ifdef ECAN1_BUS_LOAD
+#ifndef ECAN1_BUS_LOAD_PERIOD_US
+#define ECAN1_BUS_LOAD_PERIOD_US 10000
+#endif
+#ifndef ECAN1_BUS_LOAD_WINDOW
+#define ECAN1_BUS_LOAD_WINDOW 10
+#endif
+#if ECAN1_BUS_LOAD_WINDOW < 1 || ECAN1_BUS_LOAD_WINDOW > 255
+#error "ECAN1_BUS_LOAD_WINDOW must be between 1 and 255."
+#endif
+#endif
+
+// Define ECAN1_TRACE to record every frame received, and every frame sent from
+// the transmission queue, into a ring of that many tEcan1TraceRecords (a power
+// of two, at most 1024). The interrupt handler only copies each frame into its
+// packed form with a timestamp, so the trace can be left running in the field
+// and read out later with ecan1_trace_read(), for example over a serial port to
+// be decoded on a PC by HostEmulator/ecanTraceDecode.c. Timestamps are read
+// with ECAN1_TRACE_TIME(), which must return a free-running uint32_t counter.
+// By default it reads Timer2 and Timer3, which user code must run as one 32-bit
+// timer with a period of 0xFFFFFFFF.
+#ifdef ECAN1_TRACE
+#if ECAN1_TRACE < 2 || ECAN1_TRACE > 1024 || (ECAN1_TRACE & (ECAN1_TRACE - 1))
+#error "ECAN1_TRACE must be a power of two between 2 and 1024."
+#endif
+#endif
+
+// The fields of tEcan1TraceRecord.stamp.
+#define ECAN1_TRACE_TIME_MASK 0x7FFFFFFFUL // The low 31 bits of ECAN1_TRACE_TIME().
+#define ECAN1_TRACE_TX        0x80000000UL // Set for transmitted frames.
+
+/**
+ * A frame recorded with ECAN1_TRACE. On the dsPIC each record is 16 bytes,
+ * little-endian, and is written out as it is in memory.
+ */
+typedef struct {
+    uint32_t stamp;          // The timestamp along with ECAN1_TRACE_TX.
+    tCanPackedMessage frame; // The frame, with its ID and CMB_PACKED_* flags in frame.header.
+} tEcan1TraceRecord;
+
+// The states of the trace, as returned by ecan1_trace_state().
+enum ecan1_trace_state {
+    ECAN1_TRACE_OFF = 0,   // ECAN1_TRACE isn't defined.
+    ECAN1_TRACE_RUNNING,   // Recording, overwriting the oldest records.
+    ECAN1_TRACE_ARMED,     // Recording while waiting for the trigger frame.
+    ECAN1_TRACE_TRIGGERED, // Recording the frames that follow the trigger frame.
+    ECAN1_TRACE_FROZEN     // Stopped, keeping the records until the trace is started again.
+};
 
 /**
  * This function initializes the first ECAN module. It takes a parameters array
@@ -88,6 +247,8 @@ void ecan1_init(const uint16_t *parameters);
 
 /**
  * Pops the top message from the ECAN1 reception buffer.
+ * `buffer` is the receive buffer the message was read from, and any payload
+ * bytes past `validBytes` are zero.
  * @return A tCanMessage struct with the older message data.
  */
 int ecan1_receive(tCanMessage *msg, uint8_t *messagesLeft);
@@ -106,16 +267,215 @@ int ecan1_receive(tCanMessage *msg, uint8_t *messagesLeft);
  */
 int ecan1_receive_matlab(uint32_t *output);
 
+/**
+ * Pops up to `max` messages from the ECAN1 reception buffer at once.
+ * They are unpacked out of the buffer together, which is much cheaper than
+ * calling ecan1_receive() for each.
+ * @param msgs An array of at least `max` messages to fill.
+ * @param max The most messages to return.
+ * @return The number of messages returned, oldest first.
+ */
+uint8_t ecan1_receive_many(tCanMessage *msgs, uint8_t max);
+
+/**
+ * Pop up to ECAN1_RECEIVE_MANY_SIZE messages from the ECAN1 reception buffer.
+ * Parameters designed to interface with MATLAB C-function block.
+ * @param output A pointer to a (4 * ECAN1_RECEIVE_MANY_SIZE + 1)-element uint32 array.
+ * The first 4 * ECAN1_RECEIVE_MANY_SIZE elements are an ECAN1_RECEIVE_MANY_SIZE x 4
+ * matrix stored column-major, with one message per row in the same format as
+ * ecan1_receive_matlab(). Rows without a message are zeroed.
+ * output[4 * ECAN1_RECEIVE_MANY_SIZE] = the number of messages returned
+ */
+void ecan1_receive_many_matlab(uint32_t *output);
+
+/**
+ * Returns how many received messages have been read out by an interrupt that
+ * had already read another, and so didn't need an interrupt of their own.
+ * Every interrupt empties all of the full receive buffers, so this grows when
+ * messages arrive faster than the interrupt handler can respond. The count
+ * wraps around at 65536.
+ */
+uint16_t ecan1_rx_coalesced(void);
+
+/**
+ * Sets the table of identifiers accepted by the software filter enabled with
+ * ECAN1_RX_FILTER. Frames passed by the hardware filters are only queued if
+ * their identifier is in the table, which is looked up with a binary search
+ * in the interrupt handler. Standard identifiers are listed as they are and
+ * extended ones through ECAN1_FILTER_EXT(), so standard frames sort first.
+ * The table is used in place, so it should be a const array, and must stay
+ * valid while in use. This can be called before or after ecan1_init().
+ * @param ids The accepted identifiers in ascending order, or NULL to accept
+ *            every frame again.
+ * @param count The number of identifiers in `ids`.
+ * @return STANDARD_ERROR, leaving the filter unchanged, if `ids` isn't in
+ *         ascending order or ECAN1_RX_FILTER isn't defined. SUCCESS otherwise.
+ */
+int ecan1_rx_filter_set(const uint32_t *ids, uint16_t count);
+
+/**
+ * Returns how many received frames the software filter has discarded since
+ * ecan1_init(). The count wraps around at 65536.
+ */
+uint16_t ecan1_rx_filtered(void);
+
+/**
+ * Gives each of the listed identifiers a mailbox, enabled with
+ * ECAN1_MAILBOXES, replacing any set before. Standard identifiers are listed
+ * as they are and extended ones through ECAN1_FILTER_EXT(), in any order.
+ * Frames with these identifiers still have to pass the hardware filters, but
+ * skip the software filter. Every mailbox starts out empty. This can be
+ * called before or after ecan1_init().
+ * @param ids The identifiers, or NULL to remove every mailbox.
+ * @param count The number of identifiers in `ids`.
+ * @return STANDARD_ERROR, leaving the mailboxes unchanged, if there are more
+ *         than ECAN1_MAILBOXES identifiers, any is listed twice, or
+ *         ECAN1_MAILBOXES isn't defined. SUCCESS otherwise.
+ */
+int ecan1_mailbox_set(const uint32_t *ids, uint16_t count);
+
+/**
+ * Reads the latest frame received into a mailbox. The mailbox is found with a
+ * hash lookup and copied out without masking interrupts, trying again if the
+ * interrupt handler overwrote it meanwhile.
+ * @param id The mailbox's identifier, as given to ecan1_mailbox_set().
+ * @param msg Where the frame is stored. Like ecan1_receive(), buffer is the
+ *            receive buffer it was read from and the payload bytes past
+ *            validBytes are zero.
+ * @param updates Where the number of frames received into the mailbox since
+ *                it was last read is stored, so 0 means the frame is stale.
+ *                May be NULL.
+ * @return STANDARD_ERROR, leaving `msg` and `updates` unchanged, if there's no
+ *         mailbox for `id` or it hasn't received a frame since ecan1_init().
+ *         SUCCESS otherwise.
+ */
+int ecan1_mailbox_read(uint32_t id, tCanMessage *msg, uint16_t *updates);
+
+/**
+ * Reads a mailbox like ecan1_mailbox_read() into the same 4 uint32s as
+ * ecan1_receive_matlab(), except that the upper 16 bits of output[3] hold the
+ * number of updates since the last read rather than the messages left.
+ * @return SUCCESS if the mailbox has received a frame, otherwise
+ *         STANDARD_ERROR and `output` is left unchanged.
+ */
+int ecan1_mailbox_read_matlab(uint32_t id, uint32_t *output);
+
+/**
+ * Copies the statistics kept with ECAN1_STATS. The ECAN1 interrupt is held
+ * off while they're copied so that they're consistent with each other.
+ * @return STANDARD_ERROR, leaving `stats` unchanged, if ECAN1_STATS isn't
+ *         defined. SUCCESS otherwise.
+ */
+int ecan1_stats_get(tEcan1Stats *stats);
+
+/**
+ * Starts the statistics kept with ECAN1_STATS over, as ecan1_init() does.
+ */
+void ecan1_stats_reset(void);
+
+/**
+ * Outputs the statistics kept with ECAN1_STATS for the ECAN1 Statistics block.
+ * Parameters designed to interface with MATLAB C-function block.
+ * @param output An ECAN1_STATS_MATLAB_SIZE-element uint32 array, holding the
+ * fields of tEcan1Stats in order from isrCount to txCompleted. It's zeroed if
+ * ECAN1_STATS isn't defined.
+ */
+void ecan1_stats_matlab(uint32_t *output);
+
+/**
+ * Ends a period of the bus load estimate enabled with ECAN1_BUS_LOAD, adding
+ * the frames counted since the last call to the sliding window. Must be
+ * called every ECAN1_BUS_LOAD_PERIOD_US microseconds.
+ */
+void ecan1_bus_load_update(void);
+
+/**
+ * Returns the bus load over the sliding window, or over the periods so far if
+ * the window hasn't filled yet, as a percentage of the bit rate given to
+ * ecan1_init().
+ * The estimate only covers frames that pass the acceptance filters and those
+ * sent through the transmission queue, so the filters must accept every frame
+ * to see the whole bus. Bit stuffing is assumed to be worst case, while error
+ * frames and retransmissions aren't counted.
+ * @return The load in hundredths of a percent, from 0 to 10000, or 0 if
+ *         ECAN1_BUS_LOAD isn't defined.
+ */
+uint16_t ecan1_bus_load(void);
+
+/**
+ * Calls ecan1_bus_load_update() and outputs ecan1_bus_load(), for the ECAN1
+ * Bus Load block, whose sample time must be ECAN1_BUS_LOAD_PERIOD_US.
+ * Parameters designed to interface with MATLAB C-function block.
+ * @param load A pointer to a uint16 for the load in hundredths of a percent.
+ */
+void ecan1_bus_load_matlab(uint16_t *load);
+
+/**
+ * Empties the trace enabled with ECAN1_TRACE and starts recording
+ * continuously, as ecan1_init() does. Once the ring is full each new frame
+ * overwrites the oldest record.
+ */
+void ecan1_trace_start(void);
+
+/**
+ * Empties the trace and arms it to freeze around a trigger frame. Frames are
+ * recorded as usual until one whose frame.header, ANDed with `mask`, equals
+ * `id`. That frame and the next `after` frames are recorded, and then the
+ * trace freezes, so the ring ends up holding what led up to the trigger and
+ * what followed it.
+ * @param id The trigger identifier, with CMB_PACKED_EXT set for extended
+ *           frames as by ECAN1_FILTER_EXT().
+ * @param mask The header bits compared, usually CMB_PACKED_ID | CMB_PACKED_EXT.
+ * @param after How many frames to record after the trigger frame. It should be
+ *              below ECAN1_TRACE, or the trigger frame itself is overwritten.
+ */
+void ecan1_trace_trigger(uint32_t id, uint32_t mask, uint16_t after);
+
+/**
+ * Stops recording straight away, keeping the records until the trace is
+ * started or armed again.
+ */
+void ecan1_trace_freeze(void);
+
+/**
+ * Returns the state of the trace as one of the ecan1_trace_state values.
+ */
+uint8_t ecan1_trace_state(void);
+
+/**
+ * Moves the oldest records out of the trace. This works while the trace is
+ * still recording, in which case records that were overwritten before they
+ * could be read are skipped. The ECAN1 interrupt is held off while each
+ * record is copied.
+ * @param records Where the records are copied, oldest first.
+ * @param max The most records to copy.
+ * @return The number of records copied, which is 0 once the trace is empty or
+ *         if ECAN1_TRACE isn't defined.
+ */
+uint16_t ecan1_trace_read(tEcan1TraceRecord *records, uint16_t max);
+
 /**
  * This function transmits a CAN message on the ECAN1 CAN bus.
- * This function shouldn't be used directly, use buffered_transmit
- * instead.
+ * The message is sent from TX buffer message->buffer with the TXnPRI given
+ * to ecan1_init(). The buffer is kept away from ecan1_buffered_transmit()
+ * until the frame has been sent, so both may be used together. As that
+ * function loads queued frames into every enabled TX buffer, the buffer may
+ * be holding one of them, in which case nothing is sent.
+ * @return SUCCESS, or STANDARD_ERROR if message->buffer isn't 0-7 or is still
+ *         holding a frame that hasn't been sent.
  */
-void ecan1_transmit(const tCanMessage *message);
+int ecan1_transmit(const tCanMessage *message);
 
 /**
- * Transmits a CAN message via a circular buffer interface
+ * Transmits a CAN message via a message buffer interface
  * similar to that used by CAN message reception.
+ * Queued messages are sent in order, or by priority with ECAN1_TX_PRIORITY,
+ * using every TX buffer that was enabled (TXEN) at initialization and isn't
+ * busy with a frame from ecan1_transmit(). message->buffer is therefore
+ * ignored, and so are the TXnPRI settings: queued frames are loaded with
+ * decreasing priorities of their own to keep them in order. Messages already
+ * loaded into TX buffers aren't reordered, so with ECAN1_TX_PRIORITY fewer TX
+ * buffers give a shorter wait for urgent messages.
  */
 void ecan1_buffered_transmit(const tCanMessage *message);
 
@@ -126,7 +486,7 @@ void ecan1_buffered_transmit(const tCanMessage *message);
  * ecan1_transmit.
  * Parameters designed to interface with MATLAB C-function block.
  * @param data An array of uint16_ts with configuration options documented below.
- * data[0] = bits 0-7: ECAN buffer number
+ * data[0] = bits 0-7: ECAN buffer number (ignored, see ecan1_buffered_transmit())
  *                 bits 8-15: data length (in bytes)
  * data[1] = CAN identifier bits 0-15
  * data[2] = CAN identifier bits 16-29
@@ -139,6 +499,29 @@ void ecan1_buffered_transmit(const tCanMessage *message);
  */
 void ecan1_buffered_transmit_matlab(const uint16_t *data);
 
+/**
+ * Queues several CAN messages for transmission at once.
+ * The messages are copied into the transmission buffer in bulk and the
+ * hardware is started at most once, which is much cheaper than calling
+ * ecan1_buffered_transmit() for each.
+ * @param msgs The messages to transmit, in order.
+ * @param count The number of messages in `msgs`.
+ * @return The number of messages queued. Any others didn't fit in the buffer.
+ */
+uint8_t ecan1_buffered_transmit_many(const tCanMessage *msgs, uint8_t count);
+
+/**
+ * Queues up to ECAN1_TRANSMIT_MANY_SIZE messages for transmission at once
+ * by calling ecan1_buffered_transmit_many().
+ * Parameters designed to interface with MATLAB C-function block.
+ * @param data A (8 * ECAN1_TRANSMIT_MANY_SIZE + 1)-element uint16 array.
+ * The first 8 * ECAN1_TRANSMIT_MANY_SIZE elements are an
+ * ECAN1_TRANSMIT_MANY_SIZE x 8 matrix stored column-major, with one message
+ * per row in the same format as ecan1_buffered_transmit_matlab().
+ * data[8 * ECAN1_TRANSMIT_MANY_SIZE] = the number of rows to transmit, starting from the first
+ */
+void ecan1_buffered_transmit_many_matlab(const uint16_t *data);
+
 /**
  * Returns the error status of the ECAN1 peripheral.
  * Returns a tuple with element 0->transmission error state,
@@ -154,6 +537,7 @@ void ecan1_error_status_matlab(uint8_t *errors);
  * This function provides a general way to initialize the DMA peripheral.
  *
  * parameters[0] = IRQ address & squeezed version of DMAxCON minus CHEN bit
+ *                 (bits 7-4 = SIZE/DIR/HALF/NULLW, bits 3-2 = AMODE, bits 1-0 = MODE)
  * parameters[1] = address of peripheral (DMAxPAD)
  * parameters[2] = Number of memory units per DMA packet, starting at 1(DMAxCNT)
  * parameters[3] = Primary DPSRAM start address offset bits (DMAxSTA)
@@ -162,6 +546,6 @@ void ecan1_error_status_matlab(uint8_t *errors);
  */
 void dma_init(const uint16_t *parameters);
 
-extern unsigned int ecan1msgBuf[4][8] __attribute__((space(dma)));
+extern uint16_t ecan1msgBuf[ECAN1_DMA_BUFFERS][8] __attribute__((space(dma)));
 
 #endif /* _ECANFUNCTIONS_H_ */